@@ -25,6 +25,9 @@ export MIC_OMP_NUM_THREADS=240
 echo "Running Reduction";
 export MIC_OMP_NUM_THREADS=120
 ./Reduction -s 4&>reduction.log
+echo "Running Histogram";
+export MIC_OMP_NUM_THREADS=240
+./Histogram -s 4&>histogram.log
 echo "Running S3D";
 export MIC_OMP_NUM_THREADS=240
 ./S3D -s 4&>s3d.log
@@ -33,6 +36,8 @@ echo "Running Sort";
 echo "Running Spmv";
 export MIC_OMP_NUM_THREADS=236
 ./Spmv -s 4 &>spmv.log
+echo "Running CG";
+./CG -s 4 &>cg.log
 echo "Running Triad";
 export MIC_OMP_NUM_THREADS=240
 ./Triad -s 4 &>triad.log
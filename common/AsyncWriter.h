@@ -0,0 +1,132 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: AsyncWriter.h
+//
+// Purpose:
+//   Host side asynchronous file output, shared by the out-of-core modes of
+//   the benchmarks.
+//
+// ****************************************************************************
+
+#ifndef ASYNC_WRITER_H_
+#define ASYNC_WRITER_H_
+
+#include <aio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include "Timer.h"
+
+// ****************************************************************************
+// Class: AsyncWriter
+//
+// Purpose:
+//   Appends buffers to a file with POSIX asynchronous I/O.  At most one
+//   write is in flight; the caller must not touch the buffer of a started
+//   write until wait() returns.
+//
+// ****************************************************************************
+class AsyncWriter
+{
+  public:
+    AsyncWriter(int fd) : waitTime(0), fd(fd), offset(0), pending(false) {}
+
+    bool start(const void *buf, size_t bytes)
+    {
+        if (!wait())
+        {
+            return false;
+        }
+        memset(&cb, 0, sizeof(cb));
+        cb.aio_fildes = fd;
+        cb.aio_buf    = (volatile void*)buf;
+        cb.aio_nbytes = bytes;
+        cb.aio_offset = offset;
+        if (aio_write(&cb) != 0)
+        {
+            return false;
+        }
+        offset += bytes;
+        pending = true;
+        return true;
+    }
+
+    // Waits for the write in flight, finishing short writes synchronously
+    bool wait()
+    {
+        if (!pending)
+        {
+            return true;
+        }
+        double start = curr_second();
+        pending = false;
+        const struct aiocb *list[1] = { &cb };
+        while (aio_error(&cb) == EINPROGRESS)
+        {
+            aio_suspend(list, 1, NULL);
+        }
+        ssize_t done = aio_return(&cb);
+        if (done < 0)
+        {
+            return false;
+        }
+        const char *p = (const char*)cb.aio_buf;
+        while ((size_t)done < cb.aio_nbytes)
+        {
+            ssize_t n = pwrite(fd, p + done, cb.aio_nbytes - done,
+                               cb.aio_offset + done);
+            if (n <= 0)
+            {
+                return false;
+            }
+            done += n;
+        }
+        waitTime += curr_second() - start;
+        return true;
+    }
+
+    off_t bytes() const { return offset; }
+
+    // Seconds spent waiting for writes to complete
+    double waitTime;
+
+  private:
+    int fd;
+    off_t offset;
+    bool pending;
+    struct aiocb cb;
+};
+
+#endif // ASYNC_WRITER_H_
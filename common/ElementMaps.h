@@ -0,0 +1,126 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: ElementMaps.h
+//
+// Purpose:
+//   Element-wise maps and transforms that the reduction and scan kernels
+//   apply as they load their input, so that a chain of element-wise steps
+//   followed by a reduction or scan reads memory once.  Maps are functors
+//   of one element, transforms of an element of each of two arrays;
+//   MapCompose chains two maps.  mapArray applies a map as a pass of its
+//   own, for comparing the fused kernels with the unfused chain.
+//
+// ****************************************************************************
+
+#ifndef ELEMENT_MAPS_H_
+#define ELEMENT_MAPS_H_
+
+#pragma offload_attribute(push,target(mic))
+
+// (x - shift) * scale, e.g. normalizing by a mean and inverse deviation
+template <class T>
+struct MapAffine
+{
+    T shift, scale;
+    MapAffine(T shift_ = 0, T scale_ = 1) : shift(shift_), scale(scale_) {}
+    T operator()(T x) const { return (x - shift) * scale; }
+};
+
+template <class T>
+struct MapSquare
+{
+    T operator()(T x) const { return x * x; }
+};
+
+// g(f(x))
+template <class T, class F, class G>
+struct MapCompose
+{
+    F f;
+    G g;
+    MapCompose(const F &f_ = F(), const G &g_ = G()) : f(f_), g(g_) {}
+    T operator()(T x) const { return g(f(x)); }
+};
+
+// (a - b)^2, the terms of the distance between two vectors
+template <class T>
+struct TransformSqDiff
+{
+    T operator()(T a, T b) const { T d = a - b; return d * d; }
+};
+
+// ****************************************************************************
+// Function: mapArray
+//
+// Purpose:
+//   out[i] = map(in[i]) for n elements with nThreads threads; in and out
+//   may be the same array.  transformArray is the same for transforms.
+//
+// ****************************************************************************
+template <class T, class Map>
+void mapArray(const T *in, T *out, long n, const Map &map, int nThreads)
+{
+    #pragma omp parallel for num_threads(nThreads)
+    for (long i = 0; i < n; i += 1024)
+    {
+        long m = n - i < 1024 ? n - i : 1024;
+        const T *x = in + i;
+        T       *y = out + i;
+        #pragma simd
+        for (long j = 0; j < m; j++)
+            y[j] = map(x[j]);
+    }
+}
+
+template <class T, class Transform>
+void transformArray(const T *x, const T *y, T *out, long n,
+                    const Transform &transform, int nThreads)
+{
+    #pragma omp parallel for num_threads(nThreads)
+    for (long i = 0; i < n; i += 1024)
+    {
+        long m = n - i < 1024 ? n - i : 1024;
+        const T *xs = x + i;
+        const T *ys = y + i;
+        T       *zs = out + i;
+        #pragma simd
+        for (long j = 0; j < m; j++)
+            zs[j] = transform(xs[j], ys[j]);
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // ELEMENT_MAPS_H_
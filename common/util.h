@@ -34,12 +34,15 @@
 #ifndef SPMV_UTIL_H_
 #define SPMV_UTIL_H_
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <fstream>
 #include "OptionParser.h"
 #include "ResultDatabase.h"
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Constants
 #define ALIGN 4096
@@ -84,6 +87,14 @@ template <typename floatType>
 void fill(floatType *A, const int n, const float maxi);
 void initRandomMatrix(int *cols, int *rowDelimiters, const int n, const int dim);
 template <typename floatType>
+void genMatrix(OptionParser &op, int nRows, floatType **val_ptr,
+               int **cols_ptr, int **rowDelimiters_ptr, int *nItems,
+               int *numRows);
+template <typename floatType>
+void initMatrix(OptionParser &op, int nRows, floatType **val_ptr,
+                int **cols_ptr, int **rowDelimiters_ptr, int *nItems,
+                int *numRows);
+template <typename floatType>
 void printSparse(floatType *A, int n, int dim, int *cols, int *rowDelimiters);
 template <typename floatType>
 void convertToColMajor(floatType *A, int *cols, int dim, int *rowDelimiters, 
@@ -349,6 +360,525 @@ void initRandomMatrix(int *cols, int *rowDelimiters, const int n, const int dim)
     assert(nnzAssigned == n);
 }
 
+// ****************************************************************************
+// Matrix generators
+//
+// Parallel generators for matrices with realistic structure, selected with
+// --matrix_type.  They run in O(nnz) time, so unlike the uniform 1% random
+// matrix they scale to hundreds of millions of rows.  Every random choice is
+// a hash of the element's position, so the matrix does not depend on the
+// number of threads.
+// ****************************************************************************
+
+// splitmix64 finalizer, used as a counter based random number generator
+inline unsigned long long genHash(unsigned long long x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// uniform double in [0, 1) from the 53 high bits of a hash
+inline double genUniform(unsigned long long x)
+{
+    return (genHash(x) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// ****************************************************************************
+// Function: genFill
+//
+// Purpose:
+//   Parallel counterpart of fill: values in [0, maxi) hashed from their
+//   index
+// ****************************************************************************
+template <typename floatType>
+void genFill(floatType *A, const int n, const float maxi)
+{
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < n; j++)
+    {
+        A[j] = (floatType)(maxi * genUniform(j ^ 0x5851F42D4C957F2DULL));
+    }
+}
+
+// ****************************************************************************
+// Function: genRowOffsets
+//
+// Purpose:
+//   Turns the row lengths in rowDelimiters[0..dim-1] into row offsets and
+//   returns the number of non-zero elements
+// ****************************************************************************
+inline int genRowOffsets(int *rowDelimiters, const int dim)
+{
+    int n = 0;
+    for (int i = 0; i < dim; i++)
+    {
+        int len = rowDelimiters[i];
+        rowDelimiters[i] = n;
+        n += len;
+    }
+    rowDelimiters[dim] = n;
+    return n;
+}
+
+// ****************************************************************************
+// Function: genRmat
+//
+// Purpose:
+//   Generates the adjacency matrix of an R-MAT (recursive Kronecker) graph
+//   with dim*nnzPerRow edges.  Each edge picks a quadrant of the matrix
+//   log2(dim) times with probabilities a, b, c, d; a = skew and b = c.  From
+//   skew 0.57 up, b, c, d keep the 0.19:0.19:0.05 ratio of Graph500, so
+//   0.57 gives the Graph500 degree distribution; below it the share of d
+//   moves linearly to an equal one, so 0.25 gives a = b = c = d, a uniform
+//   random matrix.  Duplicate edges are merged, so rows hold at most
+//   nnzPerRow elements on average.
+//
+// Arguments:
+//   dim: number of rows/columns in the matrix
+//   nnzPerRow: average number of edges per row before merging
+//   skew: probability of the upper left quadrant, in [0.25, 1)
+//   cols_ptr: output - allocated array of column indices
+//   rowDelimiters: output - array of size dim+1 holding row offsets
+//
+// Returns:  number of non-zero elements
+//
+// ****************************************************************************
+inline int genRmat(const int dim, const int nnzPerRow, const double skew,
+                   int **cols_ptr, int *rowDelimiters)
+{
+    const int nEdges = dim * nnzPerRow;
+    // Share of 1 - a that goes to d
+    const double graph500D = 0.05 / 0.43;
+    const double t = (skew < 0.57) ? (skew - 0.25) / (0.57 - 0.25) : 1.0;
+    const double dShare = 1.0 / 3.0 + t * (graph500D - 1.0 / 3.0);
+    const double a = skew;
+    const double b = (1.0 - skew) * (1.0 - dShare) / 2;
+    const double c = b;
+    int scale = 0;
+    while ((1LL << scale) < dim)
+    {
+        scale++;
+    }
+
+    int *src = ALLOC(int, nEdges);
+    int *dst = ALLOC(int, nEdges);
+    #pragma omp parallel for schedule(static)
+    for (int e = 0; e < nEdges; e++)
+    {
+        // Edges that fall outside a non power of two matrix are redrawn
+        unsigned long long state = ((unsigned long long)e << 32) ^ 0x2545F491;
+        int r, s;
+        do
+        {
+            r = 0;
+            s = 0;
+            for (int l = 0; l < scale; l++)
+            {
+                double u = genUniform(state++);
+                r <<= 1;
+                s <<= 1;
+                if (u >= a + b + c)
+                {
+                    r |= 1;
+                    s |= 1;
+                }
+                else if (u >= a + b)
+                {
+                    r |= 1;
+                }
+                else if (u >= a)
+                {
+                    s |= 1;
+                }
+            }
+        } while (r >= dim || s >= dim);
+        src[e] = r;
+        dst[e] = s;
+    }
+
+    // Bucket the edges by row
+    int *pos = ALLOC(int, dim+1);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        rowDelimiters[i] = 0;
+    }
+    #pragma omp parallel for schedule(static)
+    for (int e = 0; e < nEdges; e++)
+    {
+        #pragma omp atomic
+        rowDelimiters[src[e]]++;
+    }
+    genRowOffsets(rowDelimiters, dim);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        pos[i] = rowDelimiters[i];
+    }
+
+    int *bucket = ALLOC(int, nEdges);
+    #pragma omp parallel for schedule(static)
+    for (int e = 0; e < nEdges; e++)
+    {
+        int p;
+        #pragma omp atomic capture
+        p = pos[src[e]]++;
+        bucket[p] = dst[e];
+    }
+    FREE(src);
+    FREE(dst);
+
+    // Sort each row and merge duplicate edges.  Rows are sorted, so the
+    // result does not depend on the order the edges were bucketed in.
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < dim; i++)
+    {
+        int *first = bucket + rowDelimiters[i];
+        int *last = bucket + rowDelimiters[i+1];
+        std::sort(first, last);
+        pos[i] = (int)(std::unique(first, last) - first);
+    }
+    int n = genRowOffsets(pos, dim);
+
+    int *cols = ALLOC(int, n);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        memcpy(cols + pos[i], bucket + rowDelimiters[i],
+               (pos[i+1] - pos[i]) * sizeof(int));
+    }
+    memcpy(rowDelimiters, pos, (dim+1) * sizeof(int));
+    FREE(bucket);
+    FREE(pos);
+
+    *cols_ptr = cols;
+    return n;
+}
+
+// ****************************************************************************
+// Function: genBanded
+//
+// Purpose:
+//   Generates a banded matrix with nnzPerRow contiguous elements per row
+//   centred on the diagonal (fewer in the first and last rows)
+//
+// Arguments:
+//   see genRmat
+//
+// Returns:  number of non-zero elements
+//
+// ****************************************************************************
+inline int genBanded(const int dim, const int nnzPerRow, int **cols_ptr,
+                     int *rowDelimiters)
+{
+    const int half = nnzPerRow / 2;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        int lo = std::max(0, i - half);
+        int hi = std::min(dim, i - half + nnzPerRow);
+        rowDelimiters[i] = hi - lo;
+    }
+    int n = genRowOffsets(rowDelimiters, dim);
+
+    int *cols = ALLOC(int, n);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        int lo = std::max(0, i - half);
+        for (int j = rowDelimiters[i]; j < rowDelimiters[i+1]; j++)
+        {
+            cols[j] = lo++;
+        }
+    }
+
+    *cols_ptr = cols;
+    return n;
+}
+
+// ****************************************************************************
+// Function: genPoisson
+//
+// Purpose:
+//   Generates the 5 point (2D) or 7 point (3D) finite difference Laplacian
+//   on a square or cubic grid with side round(dim^(1/dims)).  The matrix is
+//   symmetric positive definite with 2*dims on the diagonal and -1 for
+//   every neighbour.
+//
+// Arguments:
+//   dims: 2 or 3
+//   dim: input - requested number of rows
+//        output - actual number of rows, the number of grid points
+//   val_ptr: output - allocated array of values
+//   cols_ptr, rowDelimiters_ptr: output - allocated CSR structure
+//
+// Returns:  number of non-zero elements
+//
+// ****************************************************************************
+template <typename floatType>
+int genPoisson(const int dims, int *dim, floatType **val_ptr, int **cols_ptr,
+               int **rowDelimiters_ptr)
+{
+    const int g = std::max(1, (int)floor(pow((double)*dim, 1.0 / dims) + 0.5));
+    const int gz = (dims == 3) ? g : 1;
+    const int rows = g * g * gz;
+    int *rowDelimiters = ALLOC(int, rows+1);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++)
+    {
+        int x = i % g, y = (i / g) % g, z = i / (g * g);
+        rowDelimiters[i] = 1 + (x > 0) + (x < g-1) + (y > 0) + (y < g-1) +
+                           (z > 0) + (z < gz-1);
+    }
+    int n = genRowOffsets(rowDelimiters, rows);
+
+    floatType *val = ALLOC(floatType, n);
+    int *cols = ALLOC(int, n);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++)
+    {
+        int x = i % g, y = (i / g) % g, z = i / (g * g);
+        int j = rowDelimiters[i];
+        // neighbours in increasing column order
+        if (z > 0)    { cols[j] = i - g * g; val[j++] = -1; }
+        if (y > 0)    { cols[j] = i - g;     val[j++] = -1; }
+        if (x > 0)    { cols[j] = i - 1;     val[j++] = -1; }
+        cols[j] = i;
+        val[j++] = 2 * dims;
+        if (x < g-1)  { cols[j] = i + 1;     val[j++] = -1; }
+        if (y < g-1)  { cols[j] = i + g;     val[j++] = -1; }
+        if (z < gz-1) { cols[j] = i + g * g; val[j++] = -1; }
+    }
+
+    *dim = rows;
+    *val_ptr = val;
+    *cols_ptr = cols;
+    *rowDelimiters_ptr = rowDelimiters;
+    return n;
+}
+
+// ****************************************************************************
+// Function: genBlockDiagonal
+//
+// Purpose:
+//   Generates a block diagonal matrix of dense nnzPerRow x nnzPerRow blocks
+//   (the last one may be smaller), coupled to the neighbouring blocks by
+//   one element per row at distance nnzPerRow from the diagonal, as in
+//   multi-component or multi-physics problems
+//
+// Arguments:
+//   see genRmat
+//
+// Returns:  number of non-zero elements
+//
+// ****************************************************************************
+inline int genBlockDiagonal(const int dim, const int nnzPerRow,
+                            int **cols_ptr, int *rowDelimiters)
+{
+    const int bs = nnzPerRow;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        int start = (i / bs) * bs;
+        int end = std::min(dim, start + bs);
+        rowDelimiters[i] = (end - start) + (i - bs >= 0) + (i + bs < dim);
+    }
+    int n = genRowOffsets(rowDelimiters, dim);
+
+    int *cols = ALLOC(int, n);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < dim; i++)
+    {
+        int start = (i / bs) * bs;
+        int end = std::min(dim, start + bs);
+        int j = rowDelimiters[i];
+        if (i - bs >= 0)
+        {
+            cols[j++] = i - bs;
+        }
+        for (int k = start; k < end; k++)
+        {
+            cols[j++] = k;
+        }
+        if (i + bs < dim)
+        {
+            cols[j++] = i + bs;
+        }
+    }
+
+    *cols_ptr = cols;
+    return n;
+}
+
+// ****************************************************************************
+// Function: genMatrix
+//
+// Purpose:
+//   Builds the matrix selected by --matrix_type.  Unless --rows is given,
+//   the number of rows is chosen so the matrix has about as many non-zero
+//   elements as the 1% uniform random matrix with nRows rows.
+//
+// Arguments:
+//   op: the options parser / parameter database
+//   nRows: number of rows of the equivalent uniform random matrix
+//   val_ptr, cols_ptr, rowDelimiters_ptr: output - CSR arrays
+//   nItems: output - number of non-zero elements in the matrix
+//   numRows: output - number of rows in the matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void genMatrix(OptionParser &op, int nRows, floatType **val_ptr,
+               int **cols_ptr, int **rowDelimiters_ptr, int *nItems,
+               int *numRows)
+{
+    std::string type = op.getOptionString("matrix_type");
+    int nnzPerRow = op.getOptionInt("nnz_per_row");
+    double skew = op.getOptionFloat("skew");
+    float maxval = op.getOptionFloat("maxval");
+
+    int dims = (type == "poisson2d") ? 2 : (type == "poisson3d") ? 3 : 0;
+    if (dims)
+    {
+        nnzPerRow = 2 * dims + 1;
+    }
+    if (nnzPerRow < 1 || (type == "rmat" && (skew < 0.25 || skew >= 1)))
+    {
+        std::cerr << "Error: invalid nnz_per_row or skew" << std::endl;
+        exit(1);
+    }
+
+    long long rows = op.getOptionInt("rows");
+    if (rows <= 0)
+    {
+        rows = std::max(1LL, (long long)nRows * nRows / 100 / nnzPerRow);
+    }
+    if (rows * nnzPerRow > 0x7fffffffLL)
+    {
+        std::cerr << "Error: matrix with " << rows << " rows and "
+                  << nnzPerRow << " elements per row does not fit in int "
+                  << "indices" << std::endl;
+        exit(1);
+    }
+    *numRows = (int)rows;
+
+    if (dims)
+    {
+        *nItems = genPoisson(dims, numRows, val_ptr, cols_ptr,
+                             rowDelimiters_ptr);
+        return;
+    }
+
+    *rowDelimiters_ptr = ALLOC(int, *numRows+1);
+    if (type == "rmat")
+    {
+        *nItems = genRmat(*numRows, nnzPerRow, skew, cols_ptr,
+                          *rowDelimiters_ptr);
+    }
+    else if (type == "banded")
+    {
+        *nItems = genBanded(*numRows, nnzPerRow, cols_ptr,
+                            *rowDelimiters_ptr);
+    }
+    else if (type == "blockdiag")
+    {
+        *nItems = genBlockDiagonal(*numRows, nnzPerRow, cols_ptr,
+                                   *rowDelimiters_ptr);
+    }
+    else
+    {
+        std::cerr << "Error: unknown matrix_type " << type << std::endl;
+        exit(1);
+    }
+    *val_ptr = ALLOC(floatType, *nItems);
+    genFill(*val_ptr, *nItems, maxval);
+}
+
+// ****************************************************************************
+// Function: addMatrixOptions
+//
+// Purpose:
+//   Adds the options read by genMatrix, shared by the benchmarks that call
+//   initMatrix
+//
+// Arguments:
+//   op: the options parser / parameter database
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+inline void addMatrixOptions(OptionParser &op)
+{
+    op.addOption("matrix_type", OPT_STRING, "uniform", "Generated matrix: "
+                 "uniform (1% random), rmat, banded, poisson2d, poisson3d "
+                 "or blockdiag");
+    op.addOption("nnz_per_row", OPT_INT, "16", "Elements per row for the "
+                 "rmat, banded and blockdiag matrices");
+    op.addOption("skew", OPT_FLOAT, "0.57", "R-MAT probability of the upper "
+                 "left quadrant (0.25 = uniform)");
+    op.addOption("rows", OPT_INT, "0", "Rows of a generated matrix (0 = "
+                 "same element count as the uniform matrix)");
+}
+
+// ****************************************************************************
+// Function: initMatrix
+//
+// Purpose:
+//   Builds the CSR input matrix, either by reading the Matrix Market file
+//   given by --mm_filename or by generating a random matrix (see
+//   genMatrix for --matrix_type)
+//
+// Arguments:
+//   op: the options parser / parameter database
+//   nRows: number of rows in a generated matrix
+//   val_ptr, cols_ptr, rowDelimiters_ptr: output - CSR arrays
+//   nItems: output - number of non-zero elements in the matrix
+//   numRows: output - number of rows in the matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void initMatrix(OptionParser &op, int nRows, floatType **val_ptr,
+                int **cols_ptr, int **rowDelimiters_ptr, int *nItems,
+                int *numRows)
+{
+    // This benchmark either reads in a matrix market input file or
+    // generates a random matrix
+    std::string inFileName = op.getOptionString("mm_filename");
+    if (inFileName == "random" &&
+        op.getOptionString("matrix_type") != "uniform")
+    {
+        genMatrix(op, nRows, val_ptr, cols_ptr, rowDelimiters_ptr, nItems,
+                  numRows);
+    }
+    else if (inFileName == "random")
+    {
+        // If we're not opening a file, the dimension of the matrix
+        // has been passed in as an argument
+        *numRows = nRows; 
+        *nItems = nRows * nRows / 100; // 1% of entries will be non-zero
+        float maxval = op.getOptionFloat("maxval"); 
+        *val_ptr = ALLOC(floatType, *nItems);
+        *cols_ptr = ALLOC(int, *nItems);
+        *rowDelimiters_ptr = ALLOC(int, (nRows+1)); 
+        fill(*val_ptr, *nItems, maxval); 
+        initRandomMatrix(*cols_ptr, *rowDelimiters_ptr, *nItems, nRows); 
+    }
+    else 
+    {   char filename[FIELD_LENGTH];
+        strcpy(filename, inFileName.c_str());
+        readMatrix(filename, val_ptr, cols_ptr, rowDelimiters_ptr,
+                nItems, numRows);
+    }
+}
+
 // ****************************************************************************
 // Function printSparse
 //
@@ -521,6 +1051,8 @@ void convertToPadded(floatType *A, int *cols, int dim, int *rowDelimiters,
     int *newcols = *newcols_ptr; 
 
     memset(newA, 0, paddedSize * sizeof(floatType)); 
+    // padding entries point at column 0 so kernels may run over them
+    memset(newcols, 0, paddedSize * sizeof(int)); 
 
     // fill newA and newcols
     for (int i=0; i<dim; i++) 
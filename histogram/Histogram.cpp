@@ -0,0 +1,308 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <string>
+
+#include "omp.h"
+#include "offload.h"
+
+#include "OptionParser.h"
+#include "ResultDatabase.h"
+#include "Timer.h"
+#include "Histogram_Kernel.h"
+
+using namespace std;
+
+// Forward Declaration
+template <class Map>
+void RunTest(string, ResultDatabase &, OptionParser &,
+             typename Map::Key, typename Map::Key);
+
+// ****************************************************************************
+// Function: histKey
+//
+// Purpose:
+//   The key at fraction u of [lo, hi)
+//
+// ****************************************************************************
+int histKey(double u, int lo, int hi)
+{
+    return lo + (int)(u * ((double)hi - lo));
+}
+
+float histKey(double u, float lo, float hi)
+{
+    return lo + (float)(u * (hi - lo));
+}
+
+// ****************************************************************************
+// Function: histKeys
+//
+// Purpose:
+//   Fills keys with "Uniform" keys over [lo, hi) or "Skewed" ones crowded
+//   towards lo, u^8 of the range.  One key in a thousand lies outside the
+//   range, half below and half above.
+//
+// ****************************************************************************
+template <class K>
+void histKeys(K *keys, long n, const string &dist, K lo, K hi)
+{
+    srand48(n);
+    for (long i = 0; i < n; i++)
+    {
+        double u = drand48();
+        if (dist == "Skewed")
+            u = pow(u, 8);
+        if (i % 1000 == 999)
+            u = i % 2000 == 999 ? -0.5 : 1.5;
+        keys[i] = histKey(u, lo, hi);
+    }
+}
+
+// ****************************************************************************
+// Function: addBenchmarkSpecOptions
+//
+// Purpose:
+//   Add benchmark specific options parsing
+//
+// Arguments:
+//   op: the options parser / parameter database
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+void addBenchmarkSpecOptions(OptionParser& op)
+{
+    op.addOption("iterations", OPT_INT, "16",
+            "specify histogram iterations");
+    op.addOption("bins", OPT_VECINT, "16,256,4096,65536,1048576",
+            "Bin counts of the histograms");
+}
+
+// ****************************************************************************
+// Function: RunBenchmark
+//
+// Purpose:
+//   Histograms integer and float keys with each counting strategy
+//
+// Arguments:
+//   op: the options parser / parameter database
+//   resultDB: results from the benchmark are stored in this db
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+/*
+ * Best performance with:
+ * setenv MIC_ENV_PREFIX MIC
+ * setenv MIC_OMP_NUM_THREADS 240
+ * setenv MIC_KMP_AFFINITY balanced,granularity=fine
+ */
+void RunBenchmark(OptionParser &op, ResultDatabase &resultDB)
+{
+    cout << "Running integer key test" << endl;
+    RunTest<HistIntMap>("Histogram-I32", resultDB, op,
+                        -(1 << 22), 3 << 22);
+
+    cout << "Running float key test" << endl;
+    RunTest<HistFloatMap>("Histogram-F32", resultDB, op, -1.0f, 3.0f);
+}
+
+// ****************************************************************************
+// Function: RunTest
+//
+// Purpose:
+//   Times the private, atomic and lanes histograms of uniform and skewed
+//   keys in [lo, hi) for each bin count, and checks them against a serial
+//   histogram.  The private and lanes results include the merge, which is
+//   also reported on its own.
+//
+// Arguments:
+//   testName: name of the test for the key type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   lo, hi: the range mapped to the bins
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class Map>
+void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op,
+             typename Map::Key lo, typename Map::Key hi)
+{
+    typedef typename Map::Key K;
+    __attribute__ ((target(mic))) K *keys = NULL;
+
+    const int micdev     = op.getOptionInt("target");
+    const int passes     = op.getOptionInt("passes");
+    const int iterations = op.getOptionInt("iterations");
+    vector<long long> binCounts = op.getOptionVecInt("bins");
+    const char *dists[2]      = { "Uniform", "Skewed" };
+    const char *strategies[3] = { "Private", "Atomic", "Lanes" };
+
+    // Get Problem Size
+    int probSizes[4] = { 4, 8, 32, 64 };
+    long N = probSizes[op.getOptionInt("size")-1];
+    N = (N * 1024 * 1024) / sizeof(K);
+
+    int maxBins = 1;
+    for (size_t b = 0; b < binCounts.size(); b++)
+    {
+        maxBins = binCounts[b] > maxBins ? binCounts[b] : maxBins;
+    }
+
+    keys = (K*) _mm_malloc(N * sizeof(K), (2*1024*1024));
+    unsigned int *hist = (unsigned int*)
+        _mm_malloc(maxBins * sizeof(unsigned int), HIST_LINE);
+    unsigned int *ref = (unsigned int*)
+        _mm_malloc(maxBins * sizeof(unsigned int), HIST_LINE);
+    if (!keys || !hist || !ref) return;
+
+    cout << "Running Benchmark\n";
+    for (int k = 0; k < passes; k++)
+    {
+        for (int d = 0; d < 2; d++)
+        {
+            histKeys(keys, N, dists[d], lo, hi);
+            #pragma offload target(mic:micdev) \
+                    in(keys:length(N) alloc_if(1) free_if(0))
+            {
+            }
+
+            for (size_t b = 0; b < binCounts.size(); b++)
+            {
+                int bins = binCounts[b] > 0 ? binCounts[b] : 1;
+                Map map(lo, hi, bins);
+                memset(ref, 0, bins * sizeof(unsigned int));
+                for (long i = 0; i < N; i++)
+                {
+                    ref[map(keys[i])]++;
+                }
+
+                char atts[1024];
+                sprintf(atts, "%d_bins", bins);
+
+                for (int mode = 0; mode < 3; mode++)
+                {
+                    // The lane sub-histograms of many bins miss the cache
+                    if (mode == 2 && bins > HIST_LANE_BINS)
+                        continue;
+
+                    double countTime = 0, mergeTime = 0;
+                    #pragma offload target(mic:micdev) \
+                            nocopy(keys:length(N) alloc_if(0) free_if(0)) \
+                            out(hist:length(bins)) \
+                            out(countTime, mergeTime)
+                    {
+                        int nThreads = omp_get_max_threads();
+                        Map map(lo, hi, bins);
+                        unsigned int *priv = NULL, *sub = NULL;
+                        if (mode != 1)
+                        {
+                            priv = (unsigned int*) _mm_malloc(nThreads *
+                                histStride(bins) * sizeof(unsigned int),
+                                HIST_LINE);
+                        }
+                        if (mode == 2)
+                        {
+                            sub = (unsigned int*) _mm_malloc((long)nThreads *
+                                bins * HIST_LANES * sizeof(unsigned int),
+                                HIST_LINE);
+                        }
+
+                        for (int j = 0; j < iterations; j++)
+                        {
+                            double c = 0, m = 0;
+                            if (mode == 0)
+                            {
+                                histPrivate(keys, N, map, bins, priv, hist,
+                                            nThreads, c, m);
+                            }
+                            else if (mode == 1)
+                            {
+                                double start = omp_get_wtime();
+                                histAtomic(keys, N, map, bins, hist,
+                                           nThreads);
+                                c = omp_get_wtime() - start;
+                            }
+                            else
+                            {
+                                histLanes(keys, N, map, bins, sub, priv,
+                                          hist, nThreads, c, m);
+                            }
+                            countTime += c;
+                            mergeTime += m;
+                        }
+                        _mm_free(priv);
+                        _mm_free(sub);
+                    }
+                    countTime /= iterations;
+                    mergeTime /= iterations;
+
+                    string name = testName + "_" + strategies[mode] + "_" +
+                                  dists[d];
+                    cout << name << " (" << bins << " bins): ";
+                    if (memcmp(hist, ref, bins * sizeof(unsigned int)) != 0)
+                    {
+                        cout << "Test: Failed\n";
+                        continue;
+                    }
+                    cout << "Passed\n";
+
+                    resultDB.AddResult(name, atts, "MElements/s",
+                            N / (countTime + mergeTime) / 1.e6);
+                    if (mode != 1)
+                    {
+                        resultDB.AddResult(name + "_Merge", atts, "ms",
+                                mergeTime * 1.e3);
+                    }
+                }
+            }
+
+            #pragma offload target(mic:micdev) \
+                    nocopy(keys:length(N) alloc_if(0) free_if(1))
+            {
+            }
+        }
+    }
+    _mm_free(keys);
+    _mm_free(hist);
+    _mm_free(ref);
+}
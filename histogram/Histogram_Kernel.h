@@ -0,0 +1,284 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File:  Histogram_Kernel.h
+//
+// Purpose:
+//   Parallel histograms of keys mapped to bins by a range map.  Three ways
+//   of counting:
+//
+//   private - each thread counts its range of keys into its own histogram
+//             and the histograms are added bin by bin afterwards
+//   atomic  - all threads count into one histogram with atomic increments
+//   lanes   - like private, but each vector lane of a thread counts into
+//             its own sub-histogram, so the lanes of a vector never update
+//             the same counter and the counting loop vectorizes.  Only for
+//             bin counts whose sub-histograms fit in the cache.
+//
+//   The counting and the merge of the private histograms are timed apart.
+//
+// ****************************************************************************
+
+#ifndef HISTOGRAM_KERNEL_H_
+#define HISTOGRAM_KERNEL_H_
+
+#pragma offload_attribute(push,target(mic))
+
+#define HIST_LINE  64
+#define HIST_LANES 16
+
+// Largest bin count of the lanes kernel: HIST_LANES sub-histograms of
+// this many bins fill half of a core's L2
+#define HIST_LANE_BINS 4096
+
+// ****************************************************************************
+// Range maps
+//
+//   Map keys in [lo, hi) to bins 0 to bins-1 of equal width.  Keys outside
+//   the range go to the first or last bin.
+//
+// ****************************************************************************
+struct HistIntMap
+{
+    typedef int Key;
+    int lo, hi;
+    unsigned long long scale;   // bins / (hi - lo) in 32.32 fixed point
+
+    HistIntMap(int lo_, int hi_, int bins)
+        : lo(lo_), hi(hi_),
+          scale(((unsigned long long)bins << 32) /
+                (unsigned int)(hi_ - lo_)) {}
+
+    unsigned int operator()(int k) const
+    {
+        k = k < lo ? lo : k;
+        k = k < hi ? k : hi - 1;
+        return (unsigned int)(((unsigned long long)(unsigned int)(k - lo) *
+                               scale) >> 32);
+    }
+};
+
+struct HistFloatMap
+{
+    typedef float Key;
+    float lo, scale;
+    int   last;
+
+    HistFloatMap(float lo_, float hi_, int bins)
+        : lo(lo_), scale(bins / (hi_ - lo_)), last(bins - 1) {}
+
+    unsigned int operator()(float k) const
+    {
+        int b = (int)((k - lo) * scale);
+        b = b < 0 ? 0 : b;
+        return b < last ? b : last;
+    }
+};
+
+// ****************************************************************************
+// Function: histRange
+//
+// Purpose:
+//   The keys of thread i of nThreads, in balanced ranges
+//
+// ****************************************************************************
+inline void histRange(long n, int i, int nThreads, long &first, long &count)
+{
+    long nPerThread = n / nThreads;
+    long nRemainder = n % nThreads;
+    first = i * nPerThread + (i < nRemainder ? i : nRemainder);
+    count = nPerThread + (i < nRemainder ? 1 : 0);
+}
+
+// ****************************************************************************
+// Function: histMerge
+//
+// Purpose:
+//   Adds the nThreads private histograms, stride apart, into hist
+//
+// ****************************************************************************
+inline void histMerge(const unsigned int *priv, long stride, int bins,
+                      unsigned int *hist, int nThreads)
+{
+    #pragma omp parallel for num_threads(nThreads)
+    for (int b = 0; b < bins; b += HIST_LINE / sizeof(unsigned int))
+    {
+        const int n = HIST_LINE / sizeof(unsigned int);
+        unsigned int sum[HIST_LINE / sizeof(unsigned int)];
+        for (int j = 0; j < n; j++)
+            sum[j] = 0;
+        for (int t = 0; t < nThreads; t++)
+        {
+            const unsigned int *p = priv + t * stride + b;
+            #pragma simd
+            for (int j = 0; j < n; j++)
+                sum[j] += b + j < bins ? p[j] : 0;
+        }
+        for (int j = 0; j < n && b + j < bins; j++)
+            hist[b + j] = sum[j];
+    }
+}
+
+// Bins of a private histogram rounded up to whole cache lines
+inline long histStride(int bins)
+{
+    const long n = HIST_LINE / sizeof(unsigned int);
+    return (bins + n - 1) / n * n;
+}
+
+// ****************************************************************************
+// Function: histPrivate
+//
+// Purpose:
+//   Counts n keys into nThreads private histograms, nThreads *
+//   histStride(bins) counters at priv, and merges them into hist
+//
+// Returns:  the seconds spent counting and merging in countTime and
+//           mergeTime
+//
+// ****************************************************************************
+template <class Map>
+void histPrivate(const typename Map::Key *keys, long n, const Map &map,
+                 int bins, unsigned int *priv, unsigned int *hist,
+                 int nThreads, double &countTime, double &mergeTime)
+{
+    const long stride = histStride(bins);
+    double start = omp_get_wtime();
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int i = omp_get_thread_num();
+        long first, count;
+        histRange(n, i, nThreads, first, count);
+
+        unsigned int *h = priv + i * stride;
+        memset(h, 0, stride * sizeof(unsigned int));
+        const typename Map::Key *x = keys + first;
+        #pragma unroll (8)
+        for (long j = 0; j < count; j++)
+            h[map(x[j])]++;
+    }
+    double mid = omp_get_wtime();
+    histMerge(priv, stride, bins, hist, nThreads);
+    countTime = mid - start;
+    mergeTime = omp_get_wtime() - mid;
+}
+
+// ****************************************************************************
+// Function: histAtomic
+//
+// Purpose:
+//   Counts n keys into hist with atomic increments
+//
+// ****************************************************************************
+template <class Map>
+void histAtomic(const typename Map::Key *keys, long n, const Map &map,
+                int bins, unsigned int *hist, int nThreads)
+{
+    #pragma omp parallel num_threads(nThreads)
+    {
+        #pragma omp for
+        for (int b = 0; b < bins; b++)
+            hist[b] = 0;
+
+        // The implicit barrier above orders the zeroing and the counting
+        #pragma omp for
+        for (long j = 0; j < n; j++)
+        {
+            unsigned int b = map(keys[j]);
+            #pragma omp atomic
+            hist[b]++;
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: histLanes
+//
+// Purpose:
+//   Counts n keys into HIST_LANES sub-histograms per thread, lane l's
+//   counter of bin b at sub[b*HIST_LANES + l], folds each thread's lanes
+//   into its private histogram and merges those into hist.  sub holds
+//   nThreads * bins * HIST_LANES counters.
+//
+// Returns:  the seconds spent counting and merging in countTime and
+//           mergeTime
+//
+// ****************************************************************************
+template <class Map>
+void histLanes(const typename Map::Key *keys, long n, const Map &map,
+               int bins, unsigned int *sub, unsigned int *priv,
+               unsigned int *hist, int nThreads, double &countTime,
+               double &mergeTime)
+{
+    const long stride = histStride(bins);
+    double start = omp_get_wtime();
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int i = omp_get_thread_num();
+        long first, count;
+        histRange(n, i, nThreads, first, count);
+
+        unsigned int *s = sub + (long)i * bins * HIST_LANES;
+        memset(s, 0, (long)bins * HIST_LANES * sizeof(unsigned int));
+        const typename Map::Key *x = keys + first;
+        long full = count - count % HIST_LANES;
+        for (long j = 0; j < full; j += HIST_LANES)
+        {
+            #pragma simd
+            for (int l = 0; l < HIST_LANES; l++)
+                s[map(x[j + l]) * HIST_LANES + l]++;
+        }
+        for (long j = full; j < count; j++)
+            s[map(x[j]) * HIST_LANES]++;
+
+        unsigned int *h = priv + i * stride;
+        for (int b = 0; b < bins; b++)
+        {
+            unsigned int c = 0;
+            #pragma simd reduction(+:c)
+            for (int l = 0; l < HIST_LANES; l++)
+                c += s[b * HIST_LANES + l];
+            h[b] = c;
+        }
+    }
+    double mid = omp_get_wtime();
+    histMerge(priv, stride, bins, hist, nThreads);
+    countTime = mid - start;
+    mergeTime = omp_get_wtime() - mid;
+}
+
+#pragma offload_attribute(pop)
+
+#endif // HISTOGRAM_KERNEL_H_
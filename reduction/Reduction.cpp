@@ -36,6 +36,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -45,6 +47,10 @@
 #include "OptionParser.h"
 #include "ResultDatabase.h"
 #include "Timer.h"
+#include "ElementMaps.h"
+#include "Reduction_Kernel.h"
+#include "Reduction_Repro.h"
+#include "Reduction_Segmented.h"
 
 #ifdef __MIC2__
 #include <pthread.h>
@@ -56,96 +62,596 @@ using namespace std;
 template <class T>
 void RunTest(string, ResultDatabase &, OptionParser &);
 
+// Reference values of every reducer, computed in double precision
+struct ReduceGold
+{
+    double sum, min, max, argmin, argmax, l2, mean, var;
+    double fields[REDUCE_MAX_ARRAYS];
+};
+
 // ****************************************************************************
 // Function: reduceGold
 //
 // Purpose:
-//   Simple cpu reduce routine to verify device results.  This could be
-//   replaced with Kahan summation for better accuracy.
+//   Simple cpu reduce routine to verify device results, in double
+//   precision for all reducers.
 //
 // Arguments:
-//   data : the input data
-//   size : size of the input data
+//   data : the input arrays
+//   size : size of each input array
+//   gold : output - the reference values
 //
-// Returns:  sum of the data
+// Returns:  nothing
 //
 // ****************************************************************************
 template <class T>
-T reduceGold(const T *data, int size)
+void reduceGold(T * const *data, int size, ReduceGold &gold)
 {
-    T sum = 0;
+    const T *x = data[0];
+    double sum = 0, sumsq = 0;
+    int imin = 0, imax = 0;
+    for (int i = 0; i < size; i++)
+    {
+        sum += x[i];
+        sumsq += (double)x[i] * x[i];
+        if (x[i] < x[imin]) imin = i;
+        if (x[imax] < x[i]) imax = i;
+    }
+    gold.sum    = sum;
+    gold.min    = x[imin];
+    gold.max    = x[imax];
+    gold.argmin = imin;
+    gold.argmax = imax;
+    gold.l2     = sqrt(sumsq);
+    gold.mean   = sum / size;
+
+    double m2 = 0;
     for (int i = 0; i < size; i++)
     {
-        sum += data[i];
+        m2 += (x[i] - gold.mean) * (x[i] - gold.mean);
+    }
+    gold.var = m2 / size;
+
+    for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+    {
+        double s = 0;
+        for (int i = 0; i < size; i++)
+        {
+            s += data[f][i];
+        }
+        gold.fields[f] = s;
     }
-    return sum;
 }
 
+// ****************************************************************************
+// Function: check
+//
+// Purpose:
+//   Compares device results against the reference, within 1% of the
+//   reference or of 1 for small references
+//
+// Returns:  true if all values match
+//
+// ****************************************************************************
+bool check(const double *result, const double *ref, int n)
+{
+    float threshold = 1e-2;
+    for (int i = 0; i < n; i++)
+    {
+        double diff = fabs(result[i] - ref[i]);
+        if (diff >= threshold * max(fabs(ref[i]), 1.0))
+        {
+            cout << "Test: Failed\n";
+            cout << "Diff: " << diff << "\n";
+            return false;
+        }
+    }
+    cout<< "Passed\n";
+    return true;
+}
 
-template <typename T>
-__declspec(target(mic)) T reductionKernel(T *data, size_t size)
+void addBenchmarkSpecOptions(OptionParser& op)
 {
-    T ret = 0.0;
-    T intermed[512];
+    op.addOption("iterations", OPT_INT, "256",
+            "specify reduction iterations");
+    op.addOption("reduce_op", OPT_STRING, "all", "Reduction to run (sum, "
+            "min, max, argmin, argmax, l2, meanvar, multi, repro, segmented, fused, or all)");
+    op.addOption("repro_threads", OPT_VECINT, "0", "Thread counts the "
+            "reproducible sum is compared across (0 for 1, half and all "
+            "of the card's threads)");
+    op.addOption("seg_len", OPT_VECINT, "4,32,256", "Mean segment "
+            "lengths of the segmented reduction");
+}
 
-    int nThreads = omp_get_max_threads();
-    int nPerThread = size / nThreads;
+// ****************************************************************************
+// Function: RunReducer
+//
+// Purpose:
+//   Times one reducer over the arrays already on the card and checks its
+//   result.  Bandwidth counts every array the reducer reads.
+//
+// Arguments:
+//   testName: name of the result
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   in0 - in3: the input arrays, on the card
+//   N: elements in each array
+//   expect: the reference values of R::results
+//
+// Returns:  the average time of one reduction, 0 if it failed
+//
+// ****************************************************************************
+template <class T, class R>
+double RunReducer(string testName, ResultDatabase &resultDB,
+                  OptionParser &op, T *in0, T *in1, T *in2, T *in3, int N,
+                  const double *expect)
+{
+    const int micdev     = op.getOptionInt("target");
+    const int iterations = op.getOptionInt("iterations");
+    typename R::Acc result;
+
+    cout << testName << ": ";
+    double start = curr_second();
+    #pragma offload target(mic:micdev) out(result) \
+            nocopy(in0:length(N) alloc_if(0) free_if(0)) \
+            nocopy(in1:length(N) alloc_if(0) free_if(0)) \
+            nocopy(in2:length(N) alloc_if(0) free_if(0)) \
+            nocopy(in3:length(N) alloc_if(0) free_if(0))
+    {
+        const T *arrays[REDUCE_MAX_ARRAYS] = { in0, in1, in2, in3 };
+        R r(arrays);
+        int nThreads = omp_get_max_threads();
+        for (int j=0; j<iterations; j++)
+        {
+            result = reduceKernel(r, N, nThreads);
+        }
+    }
+    double avgTime = (curr_second() - start) / (double)iterations;
+
+    double values[REDUCE_MAX_ARRAYS];
+    int nValues = R::results(result, values);
+    if (!check(values, expect, nValues))
+    {
+        return 0;
+    }
+
+    char atts[1024];
+    sprintf(atts, "%d_items",N);
+    double gbytes = (double)N * sizeof(T) * R::arrays() /
+                    (1000.*1000.*1000.);
+    resultDB.AddResult(testName, atts, "GB/s", gbytes / avgTime);
+    return avgTime;
+}
 
-    #pragma omp parallel for
-    for (int i = 0; i < nThreads; i++)
+// ****************************************************************************
+// Function: RunFusedTest
+//
+// Purpose:
+//   Times two chains of element-wise steps ending in a sum, fused into one
+//   reduction and run as separate passes through a temporary array:
+//   normalizing, squaring and summing one array (_NormSq), and the squared
+//   distance between two arrays (_SqDiff).  Bandwidth counts the input
+//   arrays only, so fused and unfused rates compare directly.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   in0, in1: the input arrays, on the card
+//   N: elements in each array
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunFusedTest(string testName, ResultDatabase &resultDB,
+                  OptionParser &op, T *in0, T *in1, int N)
+{
+    typedef MapCompose<T, MapAffine<T>, MapSquare<T> > NormSq;
+    __attribute__ ((target(mic))) T *tmp = NULL;
+    const int micdev     = op.getOptionInt("target");
+    const int iterations = op.getOptionInt("iterations");
+    const T shift = 1, scale = 0.5;
+
+    // The unfused chains' temporary is allocated and first touched on the
+    // card here, so its page faults are not charged to the unfused times
+    tmp = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    if (!tmp) return;
+    #pragma offload target(mic:micdev) \
+            nocopy(in0:length(N) alloc_if(0) free_if(0)) \
+            nocopy(tmp:length(N) alloc_if(1) free_if(0))
     {
-        T loopres = 0.0;
-        for (int j = i*nPerThread; j < i*nPerThread+nPerThread; j++)
-            loopres += data[j];
+        mapArray(in0, tmp, N, MapAffine<T>(), omp_get_max_threads());
+    }
 
-        intermed[i] = loopres;
+    // cpu solution
+    double gold[2] = { 0, 0 };
+    NormSq normSq(MapAffine<T>(shift, scale));
+    TransformSqDiff<T> sqDiff;
+    for (int i = 0; i < N; i++)
+    {
+        gold[0] += normSq(in0[i]);
+        gold[1] += sqDiff(in0[i], in1[i]);
     }
 
-    for (int i = 0; i < nThreads; i++)
+    char atts[1024];
+    sprintf(atts, "%d_items",N);
+    const char *chainName[2] = { "_NormSq", "_SqDiff" };
+
+    for (int chain = 0; chain < 2; chain++)
     {
-        ret += intermed[i];
+        double chainTime[2] = { 0, 0 };
+        for (int fused = 1; fused >= 0; fused--)
+        {
+            string name = testName + chainName[chain] +
+                          (fused ? "" : "_Unfused");
+            T result = 0;
+
+            cout << name << ": ";
+            double start = curr_second();
+            #pragma offload target(mic:micdev) out(result) \
+                    nocopy(in0:length(N) alloc_if(0) free_if(0)) \
+                    nocopy(in1:length(N) alloc_if(0) free_if(0)) \
+                    nocopy(tmp:length(N) alloc_if(0) free_if(0))
+            {
+                const T *arrays[2] = { in0, in1 };
+                NormSq normSq(MapAffine<T>(shift, scale));
+                int nThreads = omp_get_max_threads();
+                const T *tmps[1] = { tmp };
+
+                for (int j=0; j<iterations; j++)
+                {
+                    if (chain == 0 && fused)
+                    {
+                        result = reduceKernel(
+                            ReduceMapSum<T, NormSq>(arrays, normSq), N,
+                            nThreads);
+                    }
+                    else if (chain == 0)
+                    {
+                        mapArray(in0, tmp, N, normSq.f, nThreads);
+                        mapArray(tmp, tmp, N, normSq.g, nThreads);
+                        result = reduceKernel(ReduceSum<T>(tmps), N,
+                                              nThreads);
+                    }
+                    else if (fused)
+                    {
+                        result = reduceKernel(ReduceTransformSum<T,
+                            TransformSqDiff<T> >(arrays), N, nThreads);
+                    }
+                    else
+                    {
+                        transformArray(in0, in1, tmp, N,
+                                       TransformSqDiff<T>(), nThreads);
+                        result = reduceKernel(ReduceSum<T>(tmps), N,
+                                              nThreads);
+                    }
+                }
+            }
+            chainTime[fused] = (curr_second() - start) / (double)iterations;
+
+            double value = result;
+            if (!check(&value, gold + chain, 1))
+            {
+                chainTime[fused] = 0;
+                continue;
+            }
+            double gbytes = (double)N * sizeof(T) * (chain + 1) /
+                            (1000.*1000.*1000.);
+            resultDB.AddResult(name, atts, "GB/s", gbytes / chainTime[fused]);
+        }
+
+        if (chainTime[0] > 0 && chainTime[1] > 0)
+        {
+            resultDB.AddResult(testName + chainName[chain] + "_Speedup",
+                    atts, "x", chainTime[0] / chainTime[1]);
+        }
     }
 
-    // Rest of the array
-    for(int i = nThreads * nPerThread; i < size; i++)
+    #pragma offload target(mic:micdev) \
+            nocopy(tmp:length(N) alloc_if(0) free_if(1))
     {
-        ret += data[i];
     }
-    return ret;
+    _mm_free(tmp);
 }
 
-template <typename T>
-bool check(T result, T ref) {
+// ****************************************************************************
+// Function: RunReproTest
+//
+// Purpose:
+//   Runs the fast sum and the reproducible sums, plain and compensated,
+//   with several thread counts over data whose sum rounds, and checks
+//   that the reproducible sums are bitwise identical for all of them.
+//   Reports the bandwidth of the reproducible sums with all threads and
+//   their cost relative to the fast sum.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   N: number of elements
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunReproTest(string testName, ResultDatabase &resultDB,
+                  OptionParser &op, int N)
+{
+    __attribute__ ((target(mic))) T *rdata = NULL;
+    const int micdev     = op.getOptionInt("target");
+    const int iterations = op.getOptionInt("iterations");
+
+    rdata = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    if (!rdata) return;
+
+    // Values spread over several magnitudes, so the order of additions
+    // changes the rounding
+    srand48(N);
+    double gold = 0;
+    for (int i = 0; i < N; i++)
+    {
+        rdata[i] = (drand48() + 0.5) * pow(10.0, (int)(lrand48() % 7) - 3);
+        gold += rdata[i];
+    }
 
-    float diff = fabs(result - ref);
+    int maxThreads = 1;
+    #pragma offload target(mic:micdev) inout(maxThreads) \
+            in(rdata:length(N) alloc_if(1) free_if(0))
+    {
+        maxThreads = omp_get_max_threads();
+    }
 
-    float threshold = 1e-2;
-    if (diff >= threshold * ref)            
+    vector<long long> threads = op.getOptionVecInt("repro_threads");
+    if (threads.size() == 0 || threads[0] <= 0)
+    {
+        threads.clear();
+        threads.push_back(1);
+        if (maxThreads / 2 > 1)
+            threads.push_back(maxThreads / 2);
+        if (maxThreads > 1)
+            threads.push_back(maxThreads);
+    }
+
+    char atts[1024];
+    sprintf(atts, "%d_items",N);
+    double gbytes = (double)N * sizeof(T) / (1000.*1000.*1000.);
+
+    // mode 0 is the fast sum, 1 the reproducible one, 2 compensated
+    const char *modeName[3] = { "Fast", "Repro", "Repro_Kahan" };
+    double modeTime[3] = { 0, 0, 0 };
+    bool identical[3] = { true, true, true };
+    bool accurate[3] = { true, true, true };
+    for (int mode = 0; mode < 3; mode++)
+    {
+        T first = 0;
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            int nThreads = threads[t];
+            T result = 0;
+            double start = curr_second();
+            #pragma offload target(mic:micdev) out(result) \
+                    nocopy(rdata:length(N) alloc_if(0) free_if(0))
+            {
+                const T *arrays[1] = { rdata };
+                for (int j=0; j<iterations; j++)
+                {
+                    if (mode == 0)
+                        result = reduceKernel(ReduceSum<T>(arrays), N,
+                                              nThreads);
+                    else
+                        result = reproReduce(rdata, N, nThreads, mode == 2);
+                }
+            }
+            modeTime[mode] = (curr_second() - start) / (double)iterations;
+
+            if (t == 0)
+                first = result;
+            identical[mode] = identical[mode] &&
+                              memcmp(&result, &first, sizeof(T)) == 0;
+            accurate[mode] = accurate[mode] &&
+                             fabs(result - gold) < 1e-2 * fabs(gold);
+        }
+        cout << testName << "_" << modeName[mode] << ": "
+             << (identical[mode] ? "bitwise identical" : "differs")
+             << " across " << threads.size() << " thread counts" << endl;
+    }
+
+    // The fast sum only has to be accurate
+    if (!accurate[0] || !accurate[1] || !accurate[2] ||
+        !identical[1] || !identical[2])
     {
         cout << "Test: Failed\n";
-        cout << "Diff: " << diff;
-        exit(-1);
     }
     else
     {
-        cout<< "Passed\n";
+        cout << "Passed\n";
+        for (int mode = 1; mode < 3; mode++)
+        {
+            string name = testName + "_" + modeName[mode];
+            resultDB.AddResult(name, atts, "GB/s", gbytes / modeTime[mode]);
+            resultDB.AddResult(name + "_Cost", atts, "x",
+                               modeTime[mode] / modeTime[0]);
+        }
     }
-    return true;
+
+    #pragma offload target(mic:micdev) \
+            nocopy(rdata:length(N) alloc_if(0) free_if(1))
+    {
+    }
+    _mm_free(rdata);
 }
 
-void addBenchmarkSpecOptions(OptionParser& op)
+// ****************************************************************************
+// Function: segmentOffsets
+//
+// Purpose:
+//   Builds the offsets of segments covering N elements with the given mean
+//   length.  "Fixed" segments all have the mean length, "Uniform" ones are
+//   1 to 2*mean-1 long, and "Skewed" ones are mostly a quarter of the mean
+//   with one in a hundred about 75 times longer.
+//
+// Returns:  the number of segments
+//
+// ****************************************************************************
+int segmentOffsets(const string &dist, int meanLen, int N,
+                   vector<int> &offsets)
 {
-    op.addOption("iterations", OPT_INT, "256",
-            "specify reduction iterations");
+    srand48(meanLen);
+    offsets.clear();
+    offsets.push_back(0);
+    int pos = 0;
+    while (pos < N)
+    {
+        int len = meanLen;
+        if (dist == "Uniform")
+        {
+            len = 1 + lrand48() % (2 * meanLen - 1);
+        }
+        else if (dist == "Skewed")
+        {
+            len = lrand48() % 100 == 0 ? 75 * meanLen + meanLen / 4
+                                       : (meanLen + 3) / 4;
+        }
+        pos = min(pos + len, N);
+        offsets.push_back(pos);
+    }
+    return offsets.size() - 1;
+}
+
+// ****************************************************************************
+// Function: RunSegmentedTest
+//
+// Purpose:
+//   Times the load balanced segmented sum and the naive one, a segment per
+//   loop iteration, over segment length distributions and mean lengths.
+//   Bandwidth counts the data, the offsets and the sums.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   N: number of elements
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunSegmentedTest(string testName, ResultDatabase &resultDB,
+                      OptionParser &op, int N)
+{
+    __attribute__ ((target(mic))) T   *sdata = NULL;
+    __attribute__ ((target(mic))) T   *sums = NULL;
+    __attribute__ ((target(mic))) int *offs = NULL;
+    const int micdev     = op.getOptionInt("target");
+    const int iterations = op.getOptionInt("iterations");
+    vector<long long> lengths = op.getOptionVecInt("seg_len");
+    const char *dists[3] = { "Fixed", "Uniform", "Skewed" };
+
+    sdata = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    sums  = (T*) _mm_malloc((N + 1) * sizeof(T), (2*1024*1024));
+    offs  = (int*) _mm_malloc((N + 1) * sizeof(int), (2*1024*1024));
+    if (!sdata || !sums || !offs) return;
+
+    for (int i = 0; i < N; i++)
+    {
+        sdata[i] = i % 3;
+    }
+
+    #pragma offload target(mic:micdev) \
+            in(sdata:length(N) alloc_if(1) free_if(0)) \
+            nocopy(sums:length(N + 1) alloc_if(1) free_if(0)) \
+            nocopy(offs:length(N + 1) alloc_if(1) free_if(0))
+    {
+    }
+
+    vector<int> offsets;
+    for (size_t l = 0; l < lengths.size(); l++)
+    {
+        int meanLen = lengths[l] > 0 ? lengths[l] : 1;
+        for (int d = 0; d < 3; d++)
+        {
+            int nSegments = segmentOffsets(dists[d], meanLen, N, offsets);
+            std::copy(offsets.begin(), offsets.end(), offs);
+
+            // mode 0 is the balanced sum, 1 the naive one
+            double segTime[2];
+            bool passed = true;
+            for (int mode = 0; mode < 2; mode++)
+            {
+                double start = curr_second();
+                #pragma offload target(mic:micdev) \
+                        in(offs:length(nSegments + 1) alloc_if(0) free_if(0)) \
+                        out(sums:length(nSegments) alloc_if(0) free_if(0)) \
+                        nocopy(sdata:length(N) alloc_if(0) free_if(0))
+                {
+                    int nThreads = omp_get_max_threads();
+                    for (int j=0; j<iterations; j++)
+                    {
+                        if (mode == 0)
+                            segmentedReduce(sdata, offs, nSegments, sums,
+                                            nThreads);
+                        else
+                            segmentedReduceNaive(sdata, offs, nSegments,
+                                                 sums, nThreads);
+                    }
+                }
+                segTime[mode] = (curr_second() - start) / (double)iterations;
+
+                for (int s = 0; s < nSegments && passed; s++)
+                {
+                    double ref = 0;
+                    for (int i = offs[s]; i < offs[s + 1]; i++)
+                        ref += sdata[i];
+                    passed = fabs(sums[s] - ref) <= 1e-5 * ref;
+                }
+            }
+
+            string name = testName + "_SegSum_" + dists[d];
+            cout << name << " (mean length " << meanLen << "): ";
+            if (!passed)
+            {
+                cout << "Test: Failed\n";
+                continue;
+            }
+            cout << "Passed\n";
+
+            char atts[1024];
+            sprintf(atts, "%d_items_%d_mean_len", N, meanLen);
+            double gbytes = ((double)N * sizeof(T) +
+                             (double)(nSegments + 1) * sizeof(int) +
+                             (double)nSegments * sizeof(T)) /
+                            (1000.*1000.*1000.);
+            resultDB.AddResult(name, atts, "MSegments/s",
+                    nSegments / segTime[0] / 1.e6);
+            resultDB.AddResult(name + "_BW", atts, "GB/s",
+                    gbytes / segTime[0]);
+            resultDB.AddResult(name + "_Naive", atts, "MSegments/s",
+                    nSegments / segTime[1] / 1.e6);
+            resultDB.AddResult(name + "_Speedup", atts, "x",
+                    segTime[1] / segTime[0]);
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+            nocopy(sdata:length(N) alloc_if(0) free_if(1)) \
+            nocopy(sums:length(N + 1) alloc_if(0) free_if(1)) \
+            nocopy(offs:length(N + 1) alloc_if(0) free_if(1))
+    {
+    }
+    _mm_free(sdata);
+    _mm_free(sums);
+    _mm_free(offs);
 }
 
 template <typename T>
 void RunTest(string testName, ResultDatabase& resultDB, OptionParser& op) 
 {
     __attribute__ ((target(mic))) T *indata  = NULL;
-    __attribute__ ((target(mic))) T *outdata = NULL;
+    __attribute__ ((target(mic))) T *in1 = NULL, *in2 = NULL, *in3 = NULL;
 
     const int micdev = op.getOptionInt("target");
+    const string reduceOp = op.getOptionString("reduce_op");
 
     // Get Problem Size
     int probSizes[4] = { 4, 8, 32, 64 };
@@ -155,17 +661,28 @@ void RunTest(string testName, ResultDatabase& resultDB, OptionParser& op)
     indata = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
     if (!indata) return;
 
-    outdata = (T*)_mm_malloc(64 * sizeof(T), (2*1024*1024));
-    if (!outdata) return;
+    // Further arrays for the multi-array reduction
+    in1 = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    in2 = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    in3 = (T*) _mm_malloc(N * sizeof(T), (2*1024*1024));
+    if (!in1 || !in2 || !in3) return;
 
     // Initialize Host Memory
     cout << "Initializing memory." << endl;
     for(int i = 0; i < N; i++)
     {
         indata[i] = i % 3; // Fill with some pattern
+        in1[i] = i % 5;
+        in2[i] = i % 7;
+        in3[i] = i % 11;
     }
+    // A unique minimum and maximum
+    indata[N / 3] = -1;
+    indata[2 * N / 3 + 1] = 3;
 
-    T ref = reduceGold(indata, N);
+    ReduceGold gold;
+    T *arrays[REDUCE_MAX_ARRAYS] = { indata, in1, in2, in3 };
+    reduceGold(arrays, N, gold);
     const int passes     = op.getOptionInt("passes");
     const int iterations = op.getOptionInt("iterations");;
 
@@ -177,18 +694,15 @@ void RunTest(string testName, ResultDatabase& resultDB, OptionParser& op)
 
     for (int k = 0; k < passes; k++)
     {
-        T result;
         double start, stop;
-        double avgTime;
         double transferTime=0;
 
-        #pragma offload target(mic:micdev) \
-        in(outdata:length(64)  align(4*1024*1024) alloc_if(1) free_if(0))
-        {
-        }
         // Warm up
         #pragma offload target(mic:micdev) \
-        in(indata:length(N)  align(4*1024*1024) alloc_if(1) free_if(0))
+        in(indata:length(N)  align(4*1024*1024) alloc_if(1) free_if(0)) \
+        in(in1:length(N)  align(4*1024*1024) alloc_if(1) free_if(0)) \
+        in(in2:length(N)  align(4*1024*1024) alloc_if(1) free_if(0)) \
+        in(in3:length(N)  align(4*1024*1024) alloc_if(1) free_if(0))
         {
         }
 
@@ -201,45 +715,127 @@ void RunTest(string testName, ResultDatabase& resultDB, OptionParser& op)
         stop = curr_second();
         transferTime = stop - start;
 
-        start = curr_second();
-        #pragma offload target(mic:micdev) nocopy(indata:length(N) \
-                align(4*1024) alloc_if(0) free_if(0))
+        if (reduceOp == "sum" || reduceOp == "all")
         {
-            for (int j=0; j<iterations; j++) 
+            double avgTime = RunReducer<T, ReduceSum<T> >(testName,
+                    resultDB, op, indata, in1, in2, in3, N, &gold.sum);
+            if (avgTime > 0)
             {
-                result = (T)reductionKernel(indata, N);
+                double gbytes = (double)(N*sizeof(T))/(1000.*1000.*1000.);
+                resultDB.AddResult(testName+"_PCIe", atts, "GB/s", gbytes /
+                        (avgTime + transferTime));
+                resultDB.AddResult(testName+"_Parity", atts, "N",
+                        transferTime / avgTime);
             }
         }
+        if (reduceOp == "min" || reduceOp == "all")
+        {
+            RunReducer<T, ReduceMin<T> >(testName+"_Min", resultDB, op,
+                    indata, in1, in2, in3, N, &gold.min);
+        }
+        if (reduceOp == "max" || reduceOp == "all")
+        {
+            RunReducer<T, ReduceMax<T> >(testName+"_Max", resultDB, op,
+                    indata, in1, in2, in3, N, &gold.max);
+        }
+        if (reduceOp == "argmin" || reduceOp == "all")
+        {
+            double expect[2] = { gold.min, gold.argmin };
+            RunReducer<T, ReduceArgExtreme<T, false> >(testName+"_ArgMin",
+                    resultDB, op, indata, in1, in2, in3, N, expect);
+        }
+        if (reduceOp == "argmax" || reduceOp == "all")
+        {
+            double expect[2] = { gold.max, gold.argmax };
+            RunReducer<T, ReduceArgExtreme<T, true> >(testName+"_ArgMax",
+                    resultDB, op, indata, in1, in2, in3, N, expect);
+        }
+        if (reduceOp == "l2" || reduceOp == "all")
+        {
+            RunReducer<T, ReduceL2<T> >(testName+"_L2", resultDB, op,
+                    indata, in1, in2, in3, N, &gold.l2);
+        }
+        if (reduceOp == "meanvar" || reduceOp == "all")
+        {
+            double expect[2] = { gold.mean, gold.var };
+            RunReducer<T, ReduceMeanVar<T> >(testName+"_MeanVar", resultDB,
+                    op, indata, in1, in2, in3, N, expect);
+        }
+        if (reduceOp == "multi" || reduceOp == "all")
+        {
+            double fusedTime = RunReducer<T, ReduceMulti<T> >(
+                    testName+"_Multi", resultDB, op, indata, in1, in2, in3,
+                    N, gold.fields);
+
+            // The same sums, one array at a time
+            ReduceFields<T> sums;
+            start = curr_second();
+            #pragma offload target(mic:micdev) out(sums) \
+                    nocopy(indata:length(N) alloc_if(0) free_if(0)) \
+                    nocopy(in1:length(N) alloc_if(0) free_if(0)) \
+                    nocopy(in2:length(N) alloc_if(0) free_if(0)) \
+                    nocopy(in3:length(N) alloc_if(0) free_if(0))
+            {
+                const T *arrays[REDUCE_MAX_ARRAYS] =
+                    { indata, in1, in2, in3 };
+                int nThreads = omp_get_max_threads();
+                for (int j=0; j<iterations; j++)
+                {
+                    for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+                    {
+                        sums.sum[f] = reduceKernel(
+                            ReduceSum<T>(arrays + f), N, nThreads);
+                    }
+                }
+            }
+            double unfusedTime = (curr_second() - start) /
+                                 (double)iterations;
 
-        stop = curr_second();
-
-        avgTime = (stop - start) / (double)iterations;
+            double values[REDUCE_MAX_ARRAYS];
+            ReduceMulti<T>::results(sums, values);
+            cout << testName << "_Multi_Unfused: ";
+            if (check(values, gold.fields, REDUCE_MAX_ARRAYS))
+            {
+                double gbytes = (double)N * sizeof(T) * REDUCE_MAX_ARRAYS /
+                                (1000.*1000.*1000.);
+                resultDB.AddResult(testName+"_Multi_Unfused", atts, "GB/s",
+                        gbytes / unfusedTime);
+                if (fusedTime > 0)
+                {
+                    resultDB.AddResult(testName+"_Multi_Speedup", atts, "x",
+                            unfusedTime / fusedTime);
+                }
+            }
+        }
 
-        start = curr_second();
-        #pragma offload target(mic:micdev) \
-                out(outdata:length(64) alloc_if(0) free_if(1) )
+        if (reduceOp == "fused" || reduceOp == "all")
         {
+            RunFusedTest<T>(testName, resultDB, op, indata, in1, N);
         }
-        stop = curr_second();
-        transferTime += (stop - start);
 
-        check(result, ref);
+        if (reduceOp == "repro" || reduceOp == "all")
+        {
+            RunReproTest<T>(testName, resultDB, op, N);
+        }
 
-        // Free buffer on card
-        #pragma offload target(mic:micdev) nocopy(indata:length(N) \
-                align(4*1024*1024) alloc_if(0) free_if(1))
+        if (reduceOp == "segmented" || reduceOp == "all")
         {
+            RunSegmentedTest<T>(testName, resultDB, op, N);
         }
 
-        double gbytes = (double)(N*sizeof(T))/(1000.*1000.*1000.);
-        resultDB.AddResult(testName, atts, "GB/s", gbytes / avgTime);
-        resultDB.AddResult(testName+"_PCIe", atts, "GB/s", gbytes /
-                (avgTime + transferTime));
-        resultDB.AddResult(testName+"_Parity", atts, "N",
-                transferTime / avgTime);
+        // Free buffers on card
+        #pragma offload target(mic:micdev) \
+        nocopy(indata:length(N) alloc_if(0) free_if(1)) \
+        nocopy(in1:length(N) alloc_if(0) free_if(1)) \
+        nocopy(in2:length(N) alloc_if(0) free_if(1)) \
+        nocopy(in3:length(N) alloc_if(0) free_if(1))
+        {
+        }
     }
     _mm_free( indata);
-    _mm_free( outdata);
+    _mm_free( in1);
+    _mm_free( in2);
+    _mm_free( in3);
 }
 
 /*
@@ -256,4 +852,3 @@ void RunBenchmark(OptionParser &op, ResultDatabase &resultDB)
     cout << "Running double precision test" << endl;
     RunTest<double>("Reduction-DP", resultDB, op);
 }
-
@@ -0,0 +1,549 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File:  Reduction_Kernel.h
+//
+// Purpose:
+//   Templated parallel reductions.  reduceKernel splits the input into one
+//   balanced range per thread, has each thread reduce its range into its
+//   own cache line, and combines the partials in thread order.  What is
+//   reduced is up to the reducer: it supplies a vectorized reduceRange over
+//   a range of elements, the identity of its accumulator and an
+//   associative combine.  Reducers read up to REDUCE_MAX_ARRAYS arrays.
+//
+// ****************************************************************************
+
+#ifndef REDUCTION_KERNEL_H_
+#define REDUCTION_KERNEL_H_
+
+#include <limits>
+
+#pragma offload_attribute(push,target(mic))
+
+#define REDUCE_LINE       64
+#define REDUCE_LANES      16
+#define REDUCE_MAX_ARRAYS 4
+
+// Elements per block of the one pass mean and variance
+#define REDUCE_VAR_BLOCK  1024
+
+// A thread's partial, alone on its cache lines
+template <class A>
+struct ReducePartial
+{
+    A    value;
+    char pad[REDUCE_LINE - sizeof(A) % REDUCE_LINE];
+};
+
+// ****************************************************************************
+// Function: reduceKernel
+//
+// Purpose:
+//   Runs a reducer over size elements with nThreads threads
+//
+// Returns:  the reduction of all elements, combined in order
+//
+// ****************************************************************************
+template <class R>
+typename R::Acc reduceKernel(const R &r, size_t size, int nThreads)
+{
+    typedef typename R::Acc Acc;
+    ReducePartial<Acc>* partial = (ReducePartial<Acc>*)
+        _mm_malloc(nThreads * sizeof(ReducePartial<Acc>), REDUCE_LINE);
+
+    size_t nPerThread = size / nThreads;
+    size_t nRemainder = size % nThreads;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        size_t i     = omp_get_thread_num();
+        size_t first = i * nPerThread + (i < nRemainder ? i : nRemainder);
+        size_t n     = nPerThread + (i < nRemainder ? 1 : 0);
+        partial[i].value = r.reduceRange(first, n);
+    }
+
+    Acc ret = r.identity();
+    for (int i = 0; i < nThreads; i++)
+    {
+        ret = r.combine(ret, partial[i].value);
+    }
+    _mm_free(partial);
+    return ret;
+}
+
+// ****************************************************************************
+// Reducers
+//
+//   Each is built from the arrays it reads.  results() converts its
+//   accumulator to the values the benchmark reports and checks.
+//
+// ****************************************************************************
+template <class T>
+struct ReduceSum
+{
+    typedef T Acc;
+    static const char *name() { return "Sum"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceSum(const T* const* a) : data(a[0]) {}
+
+    Acc identity() const { return 0; }
+    Acc combine(Acc a, Acc b) const { return a + b; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        T sum = 0;
+        #pragma simd reduction(+:sum)
+        for (size_t j = 0; j < n; j++)
+            sum += x[j];
+        return sum;
+    }
+
+    static int results(Acc a, double *v) { v[0] = a; return 1; }
+};
+
+template <class T>
+struct ReduceMin
+{
+    typedef T Acc;
+    static const char *name() { return "Min"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceMin(const T* const* a) : data(a[0]) {}
+
+    Acc identity() const { return std::numeric_limits<T>::max(); }
+    Acc combine(Acc a, Acc b) const { return b < a ? b : a; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        T m = identity();
+        #pragma vector always
+        for (size_t j = 0; j < n; j++)
+            m = x[j] < m ? x[j] : m;
+        return m;
+    }
+
+    static int results(Acc a, double *v) { v[0] = a; return 1; }
+};
+
+template <class T>
+struct ReduceMax
+{
+    typedef T Acc;
+    static const char *name() { return "Max"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceMax(const T* const* a) : data(a[0]) {}
+
+    Acc identity() const { return -std::numeric_limits<T>::max(); }
+    Acc combine(Acc a, Acc b) const { return a < b ? b : a; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        T m = identity();
+        #pragma vector always
+        for (size_t j = 0; j < n; j++)
+            m = m < x[j] ? x[j] : m;
+        return m;
+    }
+
+    static int results(Acc a, double *v) { v[0] = a; return 1; }
+};
+
+// Value and index of an extreme element; ties go to the lowest index
+template <class T>
+struct ReduceIndexed
+{
+    T    value;
+    long index;
+};
+
+// ****************************************************************************
+// Struct: ReduceArgExtreme
+//
+// Purpose:
+//   Argmin (Less) or argmax (Greater).  Each of REDUCE_LANES vector lanes
+//   keeps its own best value and index over the elements it sees, and the
+//   lanes are combined at the end of the range.
+//
+// ****************************************************************************
+template <class T, bool Greater>
+struct ReduceArgExtreme
+{
+    typedef ReduceIndexed<T> Acc;
+    static const char *name() { return Greater ? "ArgMax" : "ArgMin"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceArgExtreme(const T* const* a) : data(a[0]) {}
+
+    static bool better(T a, T b) { return Greater ? b < a : a < b; }
+
+    Acc identity() const
+    {
+        Acc r;
+        r.value = Greater ? -std::numeric_limits<T>::max() :
+                             std::numeric_limits<T>::max();
+        r.index = -1;
+        return r;
+    }
+
+    Acc combine(Acc a, Acc b) const
+    {
+        if (better(b.value, a.value) ||
+            (b.value == a.value && b.index >= 0 &&
+             (a.index < 0 || b.index < a.index)))
+            return b;
+        return a;
+    }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        Acc init = identity();
+        __declspec(align(64)) T    laneValue[REDUCE_LANES];
+        __declspec(align(64)) long laneIndex[REDUCE_LANES];
+        for (int k = 0; k < REDUCE_LANES; k++)
+        {
+            laneValue[k] = init.value;
+            laneIndex[k] = -1;
+        }
+
+        size_t j = 0;
+        for (; j + REDUCE_LANES <= n; j += REDUCE_LANES)
+        {
+            #pragma simd
+            for (int k = 0; k < REDUCE_LANES; k++)
+            {
+                if (better(x[j + k], laneValue[k]))
+                {
+                    laneValue[k] = x[j + k];
+                    laneIndex[k] = first + j + k;
+                }
+            }
+        }
+
+        Acc r = init;
+        for (int k = 0; k < REDUCE_LANES; k++)
+        {
+            Acc lane;
+            lane.value = laneValue[k];
+            lane.index = laneIndex[k];
+            r = combine(r, lane);
+        }
+        for (; j < n; j++)
+        {
+            Acc e;
+            e.value = x[j];
+            e.index = first + j;
+            r = combine(r, e);
+        }
+        return r;
+    }
+
+    static int results(Acc a, double *v)
+    {
+        v[0] = a.value;
+        v[1] = a.index;
+        return 2;
+    }
+};
+
+// Euclidean norm, reduced as a sum of squares
+template <class T>
+struct ReduceL2
+{
+    typedef T Acc;
+    static const char *name() { return "L2"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceL2(const T* const* a) : data(a[0]) {}
+
+    Acc identity() const { return 0; }
+    Acc combine(Acc a, Acc b) const { return a + b; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        T sum = 0;
+        #pragma simd reduction(+:sum)
+        for (size_t j = 0; j < n; j++)
+            sum += x[j] * x[j];
+        return sum;
+    }
+
+    static int results(Acc a, double *v) { v[0] = sqrt((double)a); return 1; }
+};
+
+// Count, mean and sum of squared deviations of a set of elements
+template <class T>
+struct ReduceMoments
+{
+    double count;
+    T      mean;
+    T      m2;
+};
+
+// ****************************************************************************
+// Struct: ReduceMeanVar
+//
+// Purpose:
+//   Mean and variance in one pass over memory.  Each block of
+//   REDUCE_VAR_BLOCK elements is summed, then its squared deviations from
+//   its own mean are summed while it is still in cache; blocks and
+//   threads are merged with the pairwise update of Chan et al., which
+//   avoids the cancellation of the sum of squares formula.
+//
+// ****************************************************************************
+template <class T>
+struct ReduceMeanVar
+{
+    typedef ReduceMoments<T> Acc;
+    static const char *name() { return "MeanVar"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    ReduceMeanVar(const T* const* a) : data(a[0]) {}
+
+    Acc identity() const
+    {
+        Acc r;
+        r.count = 0;
+        r.mean  = 0;
+        r.m2    = 0;
+        return r;
+    }
+
+    Acc combine(Acc a, Acc b) const
+    {
+        if (a.count == 0)
+            return b;
+        if (b.count == 0)
+            return a;
+        Acc r;
+        r.count = a.count + b.count;
+        T delta = b.mean - a.mean;
+        r.mean  = a.mean + delta * (T)(b.count / r.count);
+        r.m2    = a.m2 + b.m2 +
+                  delta * delta * (T)(a.count * b.count / r.count);
+        return r;
+    }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        Acc r = identity();
+        for (size_t b = 0; b < n; b += REDUCE_VAR_BLOCK)
+        {
+            const T* x  = data + first + b;
+            size_t   nb = n - b < REDUCE_VAR_BLOCK ? n - b : REDUCE_VAR_BLOCK;
+
+            T sum = 0;
+            #pragma simd reduction(+:sum)
+            for (size_t j = 0; j < nb; j++)
+                sum += x[j];
+            T mean = sum / (T)nb;
+
+            T m2 = 0;
+            #pragma simd reduction(+:m2)
+            for (size_t j = 0; j < nb; j++)
+                m2 += (x[j] - mean) * (x[j] - mean);
+
+            Acc block;
+            block.count = nb;
+            block.mean  = mean;
+            block.m2    = m2;
+            r = combine(r, block);
+        }
+        return r;
+    }
+
+    // Population variance
+    static int results(Acc a, double *v)
+    {
+        v[0] = a.mean;
+        v[1] = a.count > 0 ? a.m2 / a.count : 0;
+        return 2;
+    }
+};
+
+// Sums of several arrays
+template <class T>
+struct ReduceFields
+{
+    T sum[REDUCE_MAX_ARRAYS];
+};
+
+// ****************************************************************************
+// Struct: ReduceMulti
+//
+// Purpose:
+//   Sums REDUCE_MAX_ARRAYS arrays in one pass.  The arrays are walked in
+//   blocks so that the streams advance together.
+//
+// ****************************************************************************
+template <class T>
+struct ReduceMulti
+{
+    typedef ReduceFields<T> Acc;
+    static const char *name() { return "Multi"; }
+    static int arrays() { return REDUCE_MAX_ARRAYS; }
+
+    const T* data[REDUCE_MAX_ARRAYS];
+    ReduceMulti(const T* const* a)
+    {
+        for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+            data[f] = a[f];
+    }
+
+    Acc identity() const
+    {
+        Acc r;
+        for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+            r.sum[f] = 0;
+        return r;
+    }
+
+    Acc combine(Acc a, Acc b) const
+    {
+        for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+            a.sum[f] += b.sum[f];
+        return a;
+    }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        Acc r = identity();
+        for (size_t b = 0; b < n; b += REDUCE_VAR_BLOCK)
+        {
+            size_t nb = n - b < REDUCE_VAR_BLOCK ? n - b : REDUCE_VAR_BLOCK;
+            for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+            {
+                const T* x = data[f] + first + b;
+                T sum = 0;
+                #pragma simd reduction(+:sum)
+                for (size_t j = 0; j < nb; j++)
+                    sum += x[j];
+                r.sum[f] += sum;
+            }
+        }
+        return r;
+    }
+
+    static int results(Acc a, double *v)
+    {
+        for (int f = 0; f < REDUCE_MAX_ARRAYS; f++)
+            v[f] = a.sum[f];
+        return REDUCE_MAX_ARRAYS;
+    }
+};
+
+// ****************************************************************************
+// Struct: ReduceMapSum, ReduceTransformSum
+//
+// Purpose:
+//   Fused reductions: the sum of map(x[i]) over one array, and of
+//   transform(x[i], y[i]) over two, with the map or transform applied as
+//   the elements are loaded.  Maps and transforms are the functors of
+//   ElementMaps.h; a default constructed one is used unless one is given.
+//
+// ****************************************************************************
+template <class T, class Map>
+struct ReduceMapSum
+{
+    typedef T Acc;
+    static const char *name() { return "MapSum"; }
+    static int arrays() { return 1; }
+
+    const T* data;
+    Map map;
+    ReduceMapSum(const T* const* a, const Map &m = Map())
+        : data(a[0]), map(m) {}
+
+    Acc identity() const { return 0; }
+    Acc combine(Acc a, Acc b) const { return a + b; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* x = data + first;
+        T sum = 0;
+        #pragma simd reduction(+:sum)
+        for (size_t j = 0; j < n; j++)
+            sum += map(x[j]);
+        return sum;
+    }
+
+    static int results(Acc a, double *v) { v[0] = a; return 1; }
+};
+
+template <class T, class Transform>
+struct ReduceTransformSum
+{
+    typedef T Acc;
+    static const char *name() { return "TransformSum"; }
+    static int arrays() { return 2; }
+
+    const T* x;
+    const T* y;
+    Transform transform;
+    ReduceTransformSum(const T* const* a, const Transform &t = Transform())
+        : x(a[0]), y(a[1]), transform(t) {}
+
+    Acc identity() const { return 0; }
+    Acc combine(Acc a, Acc b) const { return a + b; }
+
+    Acc reduceRange(size_t first, size_t n) const
+    {
+        const T* xs = x + first;
+        const T* ys = y + first;
+        T sum = 0;
+        #pragma simd reduction(+:sum)
+        for (size_t j = 0; j < n; j++)
+            sum += transform(xs[j], ys[j]);
+        return sum;
+    }
+
+    static int results(Acc a, double *v) { v[0] = a; return 1; }
+};
+
+#pragma offload_attribute(pop)
+
+#endif // REDUCTION_KERNEL_H_
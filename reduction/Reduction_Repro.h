@@ -0,0 +1,213 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File:  Reduction_Repro.h
+//
+// Purpose:
+//   Sums that are bitwise identical for any number of threads.  The input
+//   is cut into blocks of REPRO_BLOCK elements at fixed positions; each
+//   block is summed into REDUCE_LANES lanes, element i going to lane
+//   i % REDUCE_LANES, and the lanes are added as a fixed tree.  The block
+//   sums are then added as a fixed pairwise tree.  Threads only choose
+//   which blocks and tree nodes they compute, never the order of the
+//   additions.
+//
+//   The compensated mode carries a Kahan correction through the lanes and
+//   adds pairs of (sum, correction) exactly with TwoSum in the trees.
+//
+// ****************************************************************************
+
+#ifndef REDUCTION_REPRO_H_
+#define REDUCTION_REPRO_H_
+
+#pragma offload_attribute(push,target(mic))
+
+// Elements per block, a multiple of REDUCE_LANES
+#define REPRO_BLOCK 4096
+
+// A sum and the rounding error it has lost
+template <class T>
+struct ReproSum
+{
+    T sum;
+    T comp;
+};
+
+// The corrections must not be simplified away
+#pragma float_control(precise, on, push)
+
+// ****************************************************************************
+// Function: reproAdd
+//
+// Purpose:
+//   Adds two compensated sums, folding the rounding error of the addition
+//   (Knuth's TwoSum) into the correction
+//
+// ****************************************************************************
+template <class T>
+inline ReproSum<T> reproAdd(ReproSum<T> a, ReproSum<T> b)
+{
+    ReproSum<T> r;
+    r.sum  = a.sum + b.sum;
+    T bv   = r.sum - a.sum;
+    T err  = (a.sum - (r.sum - bv)) + (b.sum - bv);
+    r.comp = a.comp + b.comp + err;
+    return r;
+}
+
+// ****************************************************************************
+// Function: reproBlock
+//
+// Purpose:
+//   Sums up to REPRO_BLOCK elements in lanes and a fixed tree of lanes
+//
+// ****************************************************************************
+template <class T>
+inline ReproSum<T> reproBlock(const T* x, size_t n, bool compensated)
+{
+    __declspec(align(64)) T lane[REDUCE_LANES];
+    __declspec(align(64)) T comp[REDUCE_LANES];
+    for (int k = 0; k < REDUCE_LANES; k++)
+    {
+        lane[k] = 0;
+        comp[k] = 0;
+    }
+
+    size_t j = 0;
+    if (compensated)
+    {
+        for (; j + REDUCE_LANES <= n; j += REDUCE_LANES)
+        {
+            #pragma simd
+            for (int k = 0; k < REDUCE_LANES; k++)
+            {
+                T y = x[j + k] - comp[k];
+                T t = lane[k] + y;
+                comp[k] = (t - lane[k]) - y;
+                lane[k] = t;
+            }
+        }
+    }
+    else
+    {
+        for (; j + REDUCE_LANES <= n; j += REDUCE_LANES)
+        {
+            #pragma simd
+            for (int k = 0; k < REDUCE_LANES; k++)
+                lane[k] += x[j + k];
+        }
+    }
+    // The tail goes to the lanes its positions map to
+    for (int k = 0; j + k < n; k++)
+        lane[k] += x[j + k];
+
+    // Kahan's correction is subtracted, TwoSum's is added
+    ReproSum<T> s[REDUCE_LANES];
+    for (int k = 0; k < REDUCE_LANES; k++)
+    {
+        s[k].sum  = lane[k];
+        s[k].comp = -comp[k];
+    }
+    for (int w = REDUCE_LANES / 2; w > 0; w /= 2)
+    {
+        for (int k = 0; k < w; k++)
+        {
+            if (compensated)
+                s[k] = reproAdd(s[k], s[k + w]);
+            else
+                s[k].sum = s[k].sum + s[k + w].sum;
+        }
+    }
+    return s[0];
+}
+
+#pragma float_control(pop)
+
+// ****************************************************************************
+// Function: reproReduce
+//
+// Purpose:
+//   Reproducible sum of size elements with nThreads threads
+//
+// Arguments:
+//   data: the input
+//   size: number of elements
+//   nThreads: threads to run; the result does not depend on it
+//   compensated: carry Kahan / TwoSum corrections
+//
+// Returns:  the sum
+//
+// ****************************************************************************
+template <class T>
+T reproReduce(const T* data, size_t size, int nThreads, bool compensated)
+{
+    long nBlocks = (size + REPRO_BLOCK - 1) / REPRO_BLOCK;
+    if (nBlocks == 0)
+        return 0;
+    ReproSum<T>* block = (ReproSum<T>*)
+        _mm_malloc(nBlocks * sizeof(ReproSum<T>), REDUCE_LINE);
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        #pragma omp for schedule(static)
+        for (long b = 0; b < nBlocks; b++)
+        {
+            size_t first = b * REPRO_BLOCK;
+            size_t n = size - first < REPRO_BLOCK ? size - first : REPRO_BLOCK;
+            block[b] = reproBlock(data + first, n, compensated);
+        }
+
+        // Pairwise tree over the blocks, one level per loop
+        for (long stride = 1; stride < nBlocks; stride *= 2)
+        {
+            #pragma omp for schedule(static)
+            for (long b = 0; b < nBlocks - stride; b += 2 * stride)
+            {
+                if (compensated)
+                    block[b] = reproAdd(block[b], block[b + stride]);
+                else
+                    block[b].sum = block[b].sum + block[b + stride].sum;
+            }
+        }
+    }
+
+    T sum = compensated ? block[0].sum + block[0].comp : block[0].sum;
+    _mm_free(block);
+    return sum;
+}
+
+#pragma offload_attribute(pop)
+
+#endif // REDUCTION_REPRO_H_
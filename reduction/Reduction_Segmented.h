@@ -0,0 +1,226 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File:  Reduction_Segmented.h
+//
+// Purpose:
+//   Sums of many variable length segments of one array, given as an
+//   offsets array: segment s is [offsets[s], offsets[s+1]).  Threads get
+//   equal numbers of elements rather than equal numbers of segments, so a
+//   few long segments do not leave the other threads idle.  A thread owns
+//   the segments that start in its range; the part of a segment that runs
+//   into the ranges of later threads is summed by those threads as a
+//   carry, and the carries are added in thread order at the end.
+//
+//   Runs of short segments are summed REDUCE_LANES at a time, one segment
+//   per vector lane, instead of one mostly empty vector per segment.
+//
+// ****************************************************************************
+
+#ifndef REDUCTION_SEGMENTED_H_
+#define REDUCTION_SEGMENTED_H_
+
+#include <algorithm>
+
+#pragma offload_attribute(push,target(mic))
+
+// Segments at most this long are summed across lanes
+#define SEG_SHORT 32
+
+// The part of a segment summed by a thread that does not own it
+template <class T>
+struct SegCarry
+{
+    int  segment;
+    T    value;
+    char pad[REDUCE_LINE - (sizeof(int) + sizeof(T)) % REDUCE_LINE];
+};
+
+// ****************************************************************************
+// Function: segSumLanes
+//
+// Purpose:
+//   Sums up to REDUCE_LANES short segments at once, lane j summing the
+//   elements [start[j], end[j]).  Lanes past nSeg are empty.
+//
+// ****************************************************************************
+template <class T>
+void segSumLanes(const T *data, const int *start, const int *end, int nSeg,
+                 T *out)
+{
+    int first[REDUCE_LANES], len[REDUCE_LANES];
+    T   sum[REDUCE_LANES];
+    int maxLen = 0;
+    for (int j = 0; j < REDUCE_LANES; j++)
+    {
+        first[j] = j < nSeg ? start[j] : 0;
+        len[j]   = j < nSeg ? end[j] - start[j] : 0;
+        sum[j]   = 0;
+        maxLen   = len[j] > maxLen ? len[j] : maxLen;
+    }
+
+    for (int k = 0; k < maxLen; k++)
+    {
+        #pragma simd
+        for (int j = 0; j < REDUCE_LANES; j++)
+        {
+            if (k < len[j])
+                sum[j] += data[first[j] + k];
+        }
+    }
+
+    for (int j = 0; j < nSeg; j++)
+        out[j] = sum[j];
+}
+
+// ****************************************************************************
+// Function: segSumRange
+//
+// Purpose:
+//   Sums the elements [first, last) of one segment
+//
+// ****************************************************************************
+template <class T>
+T segSumRange(const T *data, int first, int last)
+{
+    const T *x = data + first;
+    int n = last - first;
+    T sum = 0;
+    #pragma simd reduction(+:sum)
+    for (int j = 0; j < n; j++)
+        sum += x[j];
+    return sum;
+}
+
+// ****************************************************************************
+// Function: segmentedReduce
+//
+// Purpose:
+//   Writes the sum of each of nSegments segments of data to out, with
+//   nThreads threads balanced by elements.  Empty segments sum to 0.
+//
+// ****************************************************************************
+template <class T>
+void segmentedReduce(const T *data, const int *offsets, int nSegments,
+                     T *out, int nThreads)
+{
+    SegCarry<T>* carry = (SegCarry<T>*)
+        _mm_malloc(nThreads * sizeof(SegCarry<T>), REDUCE_LINE);
+
+    const int total = offsets[nSegments] - offsets[0];
+    const int base  = offsets[0];
+    const int nPerThread = total / nThreads;
+    const int nRemainder = total % nThreads;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int i  = omp_get_thread_num();
+        int e0 = base + i * nPerThread + (i < nRemainder ? i : nRemainder);
+        int e1 = e0 + nPerThread + (i < nRemainder ? 1 : 0);
+
+        // Owned segments are those starting in [e0, e1); the last thread
+        // also owns empty segments at the very end
+        int sFirst = i == 0 ? 0 :
+            std::lower_bound(offsets, offsets + nSegments, e0) - offsets;
+        int sEnd = i == nThreads - 1 ? nSegments :
+            std::lower_bound(offsets, offsets + nSegments, e1) - offsets;
+
+        // The tail of a segment started by an earlier thread
+        carry[i].segment = -1;
+        if (sFirst > 0 && offsets[sFirst - 1] < e0 && offsets[sFirst] > e0)
+        {
+            int last = std::min(offsets[sFirst], e1);
+            carry[i].segment = sFirst - 1;
+            carry[i].value   = segSumRange(data, e0, last);
+        }
+
+        int s = sFirst;
+        while (s < sEnd)
+        {
+            // Gather a run of short segments, one per lane
+            int start[REDUCE_LANES], end[REDUCE_LANES];
+            int nSeg = 0;
+            while (nSeg < REDUCE_LANES && s + nSeg < sEnd &&
+                   offsets[s + nSeg + 1] - offsets[s + nSeg] <= SEG_SHORT)
+            {
+                start[nSeg] = offsets[s + nSeg];
+                end[nSeg]   = std::min(offsets[s + nSeg + 1], e1);
+                nSeg++;
+            }
+
+            if (nSeg > 1)
+            {
+                segSumLanes(data, start, end, nSeg, out + s);
+                s += nSeg;
+            }
+            else
+            {
+                out[s] = segSumRange(data, offsets[s],
+                                     std::min(offsets[s + 1], e1));
+                s++;
+            }
+        }
+    }
+
+    for (int i = 0; i < nThreads; i++)
+    {
+        if (carry[i].segment >= 0)
+            out[carry[i].segment] += carry[i].value;
+    }
+    _mm_free(carry);
+}
+
+// ****************************************************************************
+// Function: segmentedReduceNaive
+//
+// Purpose:
+//   The straightforward version for comparison: segments split evenly
+//   between threads by count and each summed on its own
+//
+// ****************************************************************************
+template <class T>
+void segmentedReduceNaive(const T *data, const int *offsets, int nSegments,
+                          T *out, int nThreads)
+{
+    #pragma omp parallel for num_threads(nThreads) schedule(static)
+    for (int s = 0; s < nSegments; s++)
+    {
+        out[s] = segSumRange(data, offsets[s], offsets[s + 1]);
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // REDUCTION_SEGMENTED_H_
@@ -33,6 +33,7 @@
 // ==============================================================================
 
 #include <cassert>
+#include <climits>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -40,7 +41,13 @@
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "omp.h"
+#include "AsyncWriter.h"
+#include "ElementMaps.h"
 #include "OptionParser.h"
 #include "ResultDatabase.h"
 #include "Timer.h"
@@ -58,6 +65,8 @@ using namespace std;
 #define L1B     32768
 
 #include "Scan_Kernel.h"
+#include "Scan_Lookback.h"
+#include "Scan_Segmented.h"
 
 // ****************************************************************************
 // Function: addBenchmarkSpecOptions
@@ -79,6 +88,28 @@ using namespace std;
 void addBenchmarkSpecOptions(OptionParser &op)
 {
     op.addOption("iterations", OPT_INT, "256", "specify scan iterations");
+    op.addOption("threads", OPT_INT, "0", "MIC threads to scan with "
+                 "(0 for all but four of the card's processors)");
+    op.addOption("scan_op", OPT_STRING, "all", "Scan operator "
+                 "(sum, max, min, prod, or all)");
+    op.addOption("scan_mode", OPT_STRING, "both", "Scan variant "
+                 "(inclusive, exclusive, or both)");
+    op.addOption("scan_kernel", OPT_STRING, "both", "Scan kernel "
+                 "(twopass, lookback, or both)");
+    op.addOption("tile_kb", OPT_INT, "8", "Tile size in KB for the "
+                 "single pass look-back scans");
+    op.addOption("elements", OPT_VECINT, "0", "Problem sizes in elements "
+                 "to sweep instead of --size, any length (0 for none)");
+    op.addOption("stream_file", OPT_STRING, "", "File of 64 bit integers "
+                 "to scan in streamed chunks, written with stream_mb MB of "
+                 "random data only if it does not exist; runs only the "
+                 "streaming test");
+    op.addOption("stream_mb", OPT_INT, "1024", "Size in MB of the file "
+                 "written for the streaming test when it does not exist");
+    op.addOption("chunk_mb", OPT_INT, "64", "Chunk size in MB for the "
+                 "streaming test");
+    op.addOption("seg_len", OPT_INT, "1000", "Average segment length for "
+                 "the segmented scans");
 }
 
 // ****************************************************************************
@@ -102,37 +133,134 @@ void addBenchmarkSpecOptions(OptionParser &op)
 void
 RunBenchmark(OptionParser &op, ResultDatabase &resultDB)
 {
+    // A streamed file is scanned on its own
+    if (op.getOptionString("stream_file") != "")
+    {
+        RunStreamTest<long>("StreamScan-I64", resultDB, op);
+        return;
+    }
+
     cout << "Running single precision test" << endl;
     RunTest<float>("Scan", resultDB, op);
 
     // Test to see if this device supports double precision
     cout << "Running double precision test" << endl;
     RunTest<double>("Scan-DP", resultDB, op);
+
+    cout << "Running 32 bit integer test" << endl;
+    RunTest<int>("Scan-I32", resultDB, op);
+
+    cout << "Running 64 bit integer test" << endl;
+    RunTest<long>("Scan-I64", resultDB, op);
 }
 
-template <class T>
-void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
+// ****************************************************************************
+// Function: scanThreads
+//
+// Purpose:
+//   Number of MIC threads to scan with, from the threads option or all but
+//   four of the card's processors
+//
+// ****************************************************************************
+int scanThreads(OptionParser &op)
 {
-    int pbIndex = op.getOptionInt("size") - 1;
-    int passes  = op.getOptionInt("passes");
-    int iters   = op.getOptionInt("iterations");
-    int micdev  = op.getOptionInt("target");
+    int nThreads = op.getOptionInt("threads");
 
-    int nThreads = 240; // Default
-
-    #pragma offload target(mic) inout(nThreads)
+    if (nThreads <= 0)
     {
-        nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 4; // Leave something for the OS
+        nThreads = 240; // Default
+
+        #pragma offload target(mic) inout(nThreads)
+        {
+            nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 4; // Leave something for the OS
+        }
+        if (nThreads < 1)
+            nThreads = 1;
     }
 
     printf("Using %d available threads for MIC run.\n", nThreads);
+    return nThreads;
+}
+
+template <class T>
+void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
+{
+    int pbIndex = op.getOptionInt("size") - 1;
+
+    int nThreads = scanThreads(op);
 
     size_t szOptimum = L1B * nThreads;
 
+    // Sizes given with --elements are scanned in one chunk each.  The
+    // scans index with int, so larger sizes are refused rather than
+    // truncated.
+    vector<long long> elements = op.getOptionVecInt("elements");
+    for (size_t i = 0; i < elements.size(); i++)
+    {
+        if (elements[i] > INT_MAX - ALIGN)
+        {
+            cerr << "Error: --elements " << elements[i] << " is larger "
+                 << "than the largest scan of " << INT_MAX - ALIGN
+                 << " elements" << endl;
+            return;
+        }
+    }
+    bool sweep = false;
+    for (size_t i = 0; i < elements.size(); i++)
+    {
+        if (elements[i] > 0)
+        {
+            sweep = true;
+            RunSizeTest<T>(testName, resultDB, op, 1, elements[i], nThreads);
+        }
+    }
+    if (sweep)
+        return;
+
     int     pbSizesMB[]    = { 1, 8, 32, 64, 128, 256, 512, 768 };
     size_t  pbSizeBytes    = szOptimum * pbSizesMB[pbIndex] / 8;
     int     pbSizeElements = pbSizeBytes / sizeof(T);
 
+    // Larger problems are scanned in chunks of szOptimum bytes, each
+    // starting from the carry out of the one before
+    int nChunks       = 1;
+    int chunkElements = pbSizeElements;
+    if (pbIndex > 0)
+    {
+        nChunks       = pbSizesMB[pbIndex] / 8;
+        chunkElements = szOptimum / sizeof(T);
+    }
+
+    RunSizeTest<T>(testName, resultDB, op, nChunks, chunkElements, nThreads);
+}
+
+// ****************************************************************************
+// Function: RunSizeTest
+//
+// Purpose:
+//   Allocates a problem of nChunks chained chunks of chunkElements
+//   elements on the card and runs every scan test over it.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   nChunks, chunkElements: the problem size
+//   nThreads: MIC threads to scan with
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunSizeTest(string testName, ResultDatabase &resultDB, OptionParser &op,
+                 int nChunks, int chunkElements, int nThreads)
+{
+    int micdev  = op.getOptionInt("target");
+    string scanOp = op.getOptionString("scan_op");
+
+    int     pbSizeElements = nChunks * chunkElements;
+    size_t  pbSizeBytes    = (size_t)pbSizeElements * sizeof(T);
+
     // Allocate Host Memory
     __declspec(target(MIC)) static T* h_idata;
     __declspec(target(MIC)) static T* reference;
@@ -146,13 +274,12 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
     h_idata += ALIGN - 1;
     h_odata += ALIGN - 1;
 
-    srand(time(NULL));
     // Initialize host memory
     for (int i = 0; i < pbSizeElements; i++)
     {
-        h_idata[i]    = rand() % 21 - 10; // Fill with some pattern
-        h_odata[i]    = 0.0;
-        reference[i]  = 0.0;
+        h_idata[i]    = 0;
+        h_odata[i]    = 0;
+        reference[i]  = 0;
     }
 
     // Allocate data to mic
@@ -171,66 +298,758 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
     float transferTime = curr_second()-start;
 
     cout << "Running benchmark with size " << pbSizeElements << endl;
-    for (int k = 0; k < passes; k++)
+    if (scanOp == "sum" || scanOp == "all")
+        RunScanTest<T, ScanSum<T> >(testName, resultDB, op, h_idata,
+                                    h_odata, reference, nChunks,
+                                    chunkElements, nThreads, transferTime);
+    if (scanOp == "max" || scanOp == "all")
+        RunScanTest<T, ScanMax<T> >(testName, resultDB, op, h_idata,
+                                    h_odata, reference, nChunks,
+                                    chunkElements, nThreads, transferTime);
+    if (scanOp == "min" || scanOp == "all")
+        RunScanTest<T, ScanMin<T> >(testName, resultDB, op, h_idata,
+                                    h_odata, reference, nChunks,
+                                    chunkElements, nThreads, transferTime);
+    if (scanOp == "prod" || scanOp == "all")
+        RunScanTest<T, ScanProd<T> >(testName, resultDB, op, h_idata,
+                                     h_odata, reference, nChunks,
+                                     chunkElements, nThreads, transferTime);
+
+    RunSegmentedTest<T>(testName, resultDB, op, h_idata, h_odata, reference,
+                        pbSizeElements, nThreads);
+
+    RunMapScanTest<T>(testName, resultDB, op, h_idata, h_odata, reference,
+                      pbSizeElements, nThreads);
+
+    // Clean up
+    #pragma offload target(mic:micdev) in(h_idata:length(pbSizeElements + 1) alloc_if(0) ) \
+                                out(h_odata:length(pbSizeElements + 1) alloc_if(0))
     {
+    }
+    _mm_free(h_idata - ALIGN + 1);
+    _mm_free(h_odata - ALIGN + 1);
+    _mm_free(reference);
+}
 
-        double totalScanTime = 0.0f;
-        start = curr_second();
-        #pragma offload target(mic:micdev) nocopy(h_idata:length(pbSizeElements + 1) \
-                alloc_if(0) free_if(0)) nocopy(h_odata:length(pbSizeElements + 1)    \
-                alloc_if(0) free_if(0))
+// ****************************************************************************
+// Function: scanInput
+//
+// Purpose:
+//   Random input element for an operator.  Products are taken over +-1 so
+//   they neither overflow nor round.
+//
+// ****************************************************************************
+template <class T, class Op>
+T scanInput(Op)
+{
+    return rand() % 21 - 10;
+}
+
+template <class T>
+T scanInput(ScanProd<T>)
+{
+    return rand() % 2 ? 1 : -1;
+}
+
+// ****************************************************************************
+// Function: RunScanTest
+//
+// Purpose:
+//   Times the inclusive and exclusive scans with one operator over data
+//   already allocated on the card, with the two pass kernel and with the
+//   single pass look-back kernel.  The inclusive sum keeps the name of
+//   the original benchmark, other results are suffixed with the operator
+//   and _Excl for the exclusive scan.  Look-back results add _Lookback.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   h_idata, h_odata: input and output, allocated on the card
+//   reference: space for the cpu solution
+//   nChunks, chunkElements: the problem is nChunks chained chunks
+//   nThreads: MIC threads to scan with
+//   transferTime: time to move the input and output over PCIe
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T, class Op>
+void RunScanTest(string testName, ResultDatabase &resultDB, OptionParser &op,
+                 T* h_idata, T* h_odata, T* reference, int nChunks,
+                 int chunkElements, int nThreads, double transferTime)
+{
+    int passes  = op.getOptionInt("passes");
+    int iters   = op.getOptionInt("iterations");
+    int micdev  = op.getOptionInt("target");
+    string scanMode = op.getOptionString("scan_mode");
+    string scanKernel = op.getOptionString("scan_kernel");
+    int pbSizeElements = nChunks * chunkElements;
+
+    // Look-back tiles in whole blocks
+    size_t tileElements = op.getOptionInt("tile_kb") * 1024 / sizeof(T);
+    tileElements -= tileElements % SCAN_BLOCK;
+    if (tileElements < SCAN_BLOCK)
+        tileElements = SCAN_BLOCK;
+
+    srand(time(NULL));
+    for (int i = 0; i < pbSizeElements; i++)
+    {
+        h_idata[i] = scanInput<T>(Op());
+    }
+
+    #pragma offload target(mic:micdev) in(h_idata:length(pbSizeElements + 1) \
+            alloc_if(0) free_if(0))
+    {
+    }
+
+    for (int exclusive = 0; exclusive < 2; exclusive++)
+    {
+        if (scanMode == (exclusive ? "inclusive" : "exclusive"))
+            continue;
+
+        string name = testName;
+        if (string(Op::name()) != "Sum")
+            name += string("_") + Op::name();
+        if (exclusive)
+            name += "_Excl";
+        cout << name << " Test" << endl;
+
+        for (int k = 0; k < passes; k++)
         {
-            if (pbIndex > 0)
+            char atts[1024];
+            sprintf(atts, "%d items", pbSizeElements);
+            double gb = (double)(pbSizeElements * sizeof(T)) / (1000. * 1000. * 1000.);
+            double twoPassTime = 0.0;
+
+            if (scanKernel != "lookback")
             {
-                size_t elementsOptimum = szOptimum / sizeof(T);
-                int  nChunks = pbSizesMB[pbIndex] / 8;
-                T fOffset = 0;
+                double start = curr_second();
+                #pragma offload target(mic:micdev) nocopy(h_idata:length(pbSizeElements + 1) \
+                        alloc_if(0) free_if(0)) nocopy(h_odata:length(pbSizeElements + 1)    \
+                        alloc_if(0) free_if(0))
+                {
+                    T fOffset = Op::identity();
+
+                    for (int iChunk = 0; iChunk < nChunks; iChunk++)
+                    {
+                        fOffset = SCAN_KNC<T>(h_idata + iChunk * chunkElements,
+                                              h_odata + iChunk * chunkElements,
+                                              chunkElements,
+                                              nThreads,
+                                              iters,
+                                              fOffset,
+                                              exclusive,
+                                              Op());
+                    }
+                }
+
+                double totalScanTime = curr_second() - start;
+
+                #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
+                        alloc_if(0) free_if(0))
+                {
+                }
+
+                // If results aren't correct, don't report perf numbers
+                if (scanCPU<T>(h_idata, reference, h_odata, pbSizeElements,
+                               exclusive, Op()))
+                {
+                    double avgTime = (totalScanTime / (double) iters);
+                    resultDB.AddResult(name, atts, "GB/s", gb / avgTime);
+                    resultDB.AddResult(name+"_PCIe", atts, "GB/s", gb / (avgTime + transferTime));
+                    resultDB.AddResult(name+"_Parity", atts, "N", transferTime / avgTime);
+                    twoPassTime = avgTime;
+                }
+            }
+
+            if (scanKernel != "twopass")
+            {
+                // The whole array in one scan, no chunking needed
+                double start = curr_second();
+                #pragma offload target(mic:micdev) nocopy(h_idata:length(pbSizeElements + 1) \
+                        alloc_if(0) free_if(0)) nocopy(h_odata:length(pbSizeElements + 1)    \
+                        alloc_if(0) free_if(0))
+                {
+                    SCAN_LOOKBACK<T>(h_idata, h_odata, pbSizeElements, nThreads,
+                                     iters, tileElements, Op::identity(),
+                                     exclusive, Op());
+                }
+
+                double avgTime = (curr_second() - start) / (double) iters;
+
+                #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
+                        alloc_if(0) free_if(0))
+                {
+                }
+
+                if (! scanCPU<T>(h_idata, reference, h_odata, pbSizeElements,
+                                 exclusive, Op()))
+                {
+                    continue;
+                }
 
-                for (int iChunk = 0; iChunk < nChunks; iChunk++)
+                resultDB.AddResult(name+"_Lookback", atts, "GB/s", gb / avgTime);
+                if (twoPassTime > 0.0)
                 {
-                    SCAN_KNC<T>(h_idata + iChunk * elementsOptimum,
-                                h_odata + iChunk * elementsOptimum,
-                                elementsOptimum,
-                                iters,
-                                fOffset);
-                    fOffset = (h_odata + iChunk * elementsOptimum)[elementsOptimum - 1];
+                    resultDB.AddResult(name+"_Lookback_Speedup", atts, "x",
+                                       twoPassTime / avgTime);
                 }
             }
-            else
-                SCAN_KNC<T>(h_idata, h_odata, szOptimum / (8 * sizeof(T)), iters, 0.0);
         }
+    }
+}
 
-        double stop = curr_second();
-        totalScanTime = (stop-start);
+// ****************************************************************************
+// Function: RunSegmentedTest
+//
+// Purpose:
+//   Times the single pass segmented sum scans, with head flags and with
+//   segment offsets, and compaction and partitioning of the positive
+//   elements, over data already allocated on the card.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   h_idata, h_odata: input and output, allocated on the card
+//   reference: space for the cpu solution
+//   pbSizeElements: elements in the problem
+//   nThreads: MIC threads to scan with
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunSegmentedTest(string testName, ResultDatabase &resultDB,
+                      OptionParser &op, T* h_idata, T* h_odata, T* reference,
+                      int pbSizeElements, int nThreads)
+{
+    int passes  = op.getOptionInt("passes");
+    int iters   = op.getOptionInt("iterations");
+    int micdev  = op.getOptionInt("target");
+    int segLen  = op.getOptionInt("seg_len");
+    string scanMode = op.getOptionString("scan_mode");
+
+    size_t tileElements = op.getOptionInt("tile_kb") * 1024 / sizeof(T);
+    tileElements -= tileElements % SCAN_BLOCK;
+    if (tileElements < SCAN_BLOCK)
+        tileElements = SCAN_BLOCK;
+
+    __declspec(target(MIC)) static unsigned char* h_flags;
+    __declspec(target(MIC)) static int* h_offsets;
+
+    // Segments of random length, segLen on average
+    h_flags   = (unsigned char*)_mm_malloc(pbSizeElements, ALIGN);
+    h_offsets = (int*)_mm_malloc((pbSizeElements + 1) * sizeof(int), ALIGN);
+    srand(time(NULL));
+    int nSegments = 0;
+    for (int i = 0; i < pbSizeElements; )
+    {
+        h_offsets[nSegments++] = i;
+        i += 1 + rand() % (2 * segLen - 1);
+    }
+    memset(h_flags, 0, pbSizeElements);
+    for (int s = 0; s < nSegments; s++)
+        h_flags[h_offsets[s]] = 1;
+    for (int i = 0; i < pbSizeElements; i++)
+        h_idata[i] = scanInput<T>(ScanSum<T>());
+
+    #pragma offload target(mic:micdev) in(h_idata:length(pbSizeElements + 1) \
+            alloc_if(0) free_if(0)) in(h_flags:length(pbSizeElements) free_if(0)) \
+            in(h_offsets:length(nSegments) free_if(0))
+    {
+    }
 
-        #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
-                alloc_if(0) free_if(0))
+    char atts[1024];
+    sprintf(atts, "%d items %d segments", pbSizeElements, nSegments);
+    double melems = (double)pbSizeElements / 1e6;
+
+    // Segmented scans, with flags then with offsets
+    for (int exclusive = 0; exclusive < 2; exclusive++)
+    {
+        if (scanMode == (exclusive ? "inclusive" : "exclusive"))
+            continue;
+
+        // cpu solution, both forms of the heads give the same scan
+        T carry = 0;
+        for (int i = 0; i < pbSizeElements; i++)
         {
+            if (h_flags[i])
+                carry = 0;
+            T next = carry + h_idata[i];
+            reference[i] = exclusive ? carry : next;
+            carry = next;
         }
 
-        // If results aren't correct, don't report perf numbers
-        if (! scanCPU<T>(h_idata, reference, h_odata, pbSizeElements))
+        for (int offsets = 0; offsets < 2; offsets++)
         {
+            string name = testName + "_SegScan";
+            if (offsets)
+                name += "_Offsets";
+            if (exclusive)
+                name += "_Excl";
+            cout << name << " Test" << endl;
+
+            for (int k = 0; k < passes; k++)
+            {
+                double start = curr_second();
+                #pragma offload target(mic:micdev) \
+                    nocopy(h_idata:length(pbSizeElements + 1) alloc_if(0) free_if(0)) \
+                    nocopy(h_odata:length(pbSizeElements + 1) alloc_if(0) free_if(0)) \
+                    nocopy(h_flags:length(pbSizeElements)     alloc_if(0) free_if(0)) \
+                    nocopy(h_offsets:length(nSegments)        alloc_if(0) free_if(0))
+                {
+                    if (offsets)
+                        SEGSCAN_OFFSETS<T>(h_idata, h_offsets, nSegments,
+                                           h_odata, pbSizeElements, nThreads,
+                                           iters, tileElements, exclusive,
+                                           ScanSum<T>());
+                    else
+                        SEGSCAN_FLAGS<T>(h_idata, h_flags, h_odata,
+                                         pbSizeElements, nThreads, iters,
+                                         tileElements, exclusive,
+                                         ScanSum<T>());
+                }
+                double avgTime = (curr_second() - start) / (double) iters;
+
+                #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
+                        alloc_if(0) free_if(0))
+                {
+                }
+
+                bool passed = scanMatch(reference, h_odata, pbSizeElements);
+                cout << "Test " << (passed ? "Passed" : "Failed") << endl;
+                if (passed)
+                    resultDB.AddResult(name, atts, "MElements/s",
+                                       melems / avgTime);
+            }
+        }
+    }
+
+    // Compaction, then partition
+    for (int partition = 0; partition < 2; partition++)
+    {
+        string name = testName + (partition ? "_Partition" : "_Select");
+        cout << name << " Test" << endl;
+
+        // cpu solution
+        ScanPositive<T> pred;
+        long nSelected = 0;
+        long nRejected = 0;
+        for (int i = 0; i < pbSizeElements; i++)
+        {
+            if (pred(h_idata[i]))
+                reference[nSelected++] = h_idata[i];
+            else if (partition)
+                reference[pbSizeElements - 1 - nRejected++] = h_idata[i];
+        }
+        long nCompared = partition ? pbSizeElements : nSelected;
+
+        for (int k = 0; k < passes; k++)
+        {
+            long count = 0;
+            double start = curr_second();
+            #pragma offload target(mic:micdev) inout(count) \
+                nocopy(h_idata:length(pbSizeElements + 1) alloc_if(0) free_if(0)) \
+                nocopy(h_odata:length(pbSizeElements + 1) alloc_if(0) free_if(0))
+            {
+                count = SELECT_IF<T>(h_idata, h_odata, pbSizeElements,
+                                     nThreads, iters, tileElements,
+                                     partition, ScanPositive<T>());
+            }
+            double avgTime = (curr_second() - start) / (double) iters;
+
+            #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
+                    alloc_if(0) free_if(0))
+            {
+            }
+
+            bool passed = count == nSelected &&
+                          scanMatch(reference, h_odata, nCompared);
+            cout << "Test " << (passed ? "Passed" : "Failed") << endl;
+            if (passed)
+                resultDB.AddResult(name, atts, "MElements/s",
+                                   melems / avgTime);
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(h_flags:length(pbSizeElements) alloc_if(0) free_if(1)) \
+        nocopy(h_offsets:length(nSegments)    alloc_if(0) free_if(1))
+    {
+    }
+    _mm_free(h_flags);
+    _mm_free(h_offsets);
+}
+
+// ****************************************************************************
+// Function: RunMapScanTest
+//
+// Purpose:
+//   Times an inclusive sum scan of normalized and squared elements, fused
+//   into one look-back scan that maps the input as it loads it, and as
+//   separate map passes through a temporary array followed by the scan.
+//   Bandwidth counts the input and output only, so fused and unfused
+//   rates compare directly.
+//
+// Arguments:
+//   testName: name of the test for the element type
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   h_idata, h_odata: input and output, allocated on the card
+//   reference: space for the cpu solution
+//   pbSizeElements: elements in the problem
+//   nThreads: MIC threads to scan with
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunMapScanTest(string testName, ResultDatabase &resultDB,
+                    OptionParser &op, T* h_idata, T* h_odata, T* reference,
+                    int pbSizeElements, int nThreads)
+{
+    typedef MapCompose<T, MapAffine<T>, MapSquare<T> > NormSq;
+    int passes  = op.getOptionInt("passes");
+    int iters   = op.getOptionInt("iterations");
+    int micdev  = op.getOptionInt("target");
+
+    size_t tileElements = op.getOptionInt("tile_kb") * 1024 / sizeof(T);
+    tileElements -= tileElements % SCAN_BLOCK;
+    if (tileElements < SCAN_BLOCK)
+        tileElements = SCAN_BLOCK;
+
+    // Integers are only shifted, so the squares stay exact
+    const T shift = 1;
+    const T scale = std::numeric_limits<T>::is_integer ? 1 : 0.5;
+
+    srand(time(NULL));
+    for (int i = 0; i < pbSizeElements; i++)
+        h_idata[i] = scanInput<T>(ScanSum<T>());
+
+    // The unfused chain's temporary is allocated and first touched on the
+    // card here, so its page faults are not charged to the unfused times
+    __declspec(target(MIC)) static T* h_mapped;
+    h_mapped = (T*)_mm_malloc(pbSizeElements * sizeof(T), ALIGN);
+
+    #pragma offload target(mic:micdev) in(h_idata:length(pbSizeElements + 1) \
+            alloc_if(0) free_if(0)) nocopy(h_mapped:length(pbSizeElements) free_if(0))
+    {
+        mapArray(h_idata, h_mapped, pbSizeElements, MapAffine<T>(), nThreads);
+    }
+
+    // cpu solution, summed in double for the float types
+    NormSq normSq(MapAffine<T>(shift, scale));
+    double carry = 0;
+    for (int i = 0; i < pbSizeElements; i++)
+    {
+        carry += normSq(h_idata[i]);
+        reference[i] = carry;
+    }
+
+    char atts[1024];
+    sprintf(atts, "%d items", pbSizeElements);
+    double gb = 2.0 * pbSizeElements * sizeof(T) / (1000. * 1000. * 1000.);
+
+    for (int k = 0; k < passes; k++)
+    {
+        double scanTime[2] = { 0, 0 };
+        for (int fused = 1; fused >= 0; fused--)
+        {
+            string name = testName + "_MapScan" + (fused ? "" : "_Unfused");
+            cout << name << " Test" << endl;
+
+            double start = curr_second();
+            #pragma offload target(mic:micdev) nocopy(h_idata:length(pbSizeElements + 1) \
+                    alloc_if(0) free_if(0)) nocopy(h_odata:length(pbSizeElements + 1)    \
+                    alloc_if(0) free_if(0)) nocopy(h_mapped:length(pbSizeElements)       \
+                    alloc_if(0) free_if(0))
+            {
+                NormSq normSq(MapAffine<T>(shift, scale));
+                if (fused)
+                {
+                    SCAN_MAP_LOOKBACK<T>(h_idata, h_odata, pbSizeElements,
+                                         nThreads, iters, tileElements, 0,
+                                         false, ScanSum<T>(), normSq);
+                }
+                else
+                {
+                    for (int j = 0; j < iters; j++)
+                    {
+                        mapArray(h_idata, h_mapped, pbSizeElements,
+                                 normSq.f, nThreads);
+                        mapArray(h_mapped, h_mapped, pbSizeElements,
+                                 normSq.g, nThreads);
+                        SCAN_LOOKBACK<T>(h_mapped, h_odata, pbSizeElements,
+                                         nThreads, 1, tileElements, 0,
+                                         false, ScanSum<T>());
+                    }
+                }
+            }
+            double avgTime = (curr_second() - start) / (double) iters;
+
+            #pragma offload target(mic:micdev) out(h_odata:length(pbSizeElements + 1) \
+                    alloc_if(0) free_if(0))
+            {
+            }
+
+            // Long float sums differ from the serial ones by rounding
+            bool passed = true;
+            for (int i = 0; i < pbSizeElements && passed; i++)
+            {
+                double ref = reference[i];
+                passed = std::numeric_limits<T>::is_integer ?
+                    reference[i] == h_odata[i] :
+                    fabs(ref - h_odata[i]) <= ERR * max(fabs(ref), 1.0);
+            }
+            cout << "Test " << (passed ? "Passed" : "Failed") << endl;
+            if (!passed)
+                continue;
+
+            scanTime[fused] = avgTime;
+            resultDB.AddResult(name, atts, "GB/s", gb / avgTime);
+        }
+
+        if (scanTime[0] > 0.0 && scanTime[1] > 0.0)
+        {
+            resultDB.AddResult(testName + "_MapScan_Speedup", atts, "x",
+                               scanTime[0] / scanTime[1]);
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(h_mapped:length(pbSizeElements) alloc_if(0) free_if(1))
+    {
+    }
+    _mm_free(h_mapped);
+}
+
+// ****************************************************************************
+// Function: RunStreamTest
+//
+// Purpose:
+//   Scans a file too large for memory in chunks, each starting from the
+//   carry out of the one before.  The input is memory mapped; while the
+//   card scans a chunk, the host copies the next one out of the mapping,
+//   and the result of the previous chunk is written asynchronously.  Each
+//   chunk has two host buffers for input and two for output.  An existing
+//   file is scanned as it is; only a missing one is created.
+//
+//   _Overlap is the time the host spent reading plus the time the card
+//   spent scanning, over the elapsed time; above 1 the two overlapped.
+//
+// Arguments:
+//   testName: name of the test
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T>
+void RunStreamTest(string testName, ResultDatabase &resultDB,
+                   OptionParser &op)
+{
+    string inName  = op.getOptionString("stream_file");
+    string outName = inName + ".scan";
+    long streamMB  = op.getOptionInt("stream_mb");
+    long chunkElements = ((long)op.getOptionInt("chunk_mb") * 1024 * 1024) /
+                         sizeof(T);
+    int micdev     = op.getOptionInt("target");
+    int nThreads   = scanThreads(op);
+
+    size_t tileElements = op.getOptionInt("tile_kb") * 1024 / sizeof(T);
+    tileElements -= tileElements % SCAN_BLOCK;
+    if (tileElements < SCAN_BLOCK)
+        tileElements = SCAN_BLOCK;
+
+    if (chunkElements <= 0)
+    {
+        cerr << "Error: chunk_mb must be positive" << endl;
+        return;
+    }
+
+    __declspec(target(MIC)) static T *in0, *in1, *out0, *out1;
+    in0  = (T*)_mm_malloc(chunkElements * sizeof(T), ALIGN);
+    in1  = (T*)_mm_malloc(chunkElements * sizeof(T), ALIGN);
+    out0 = (T*)_mm_malloc(chunkElements * sizeof(T), ALIGN);
+    out1 = (T*)_mm_malloc(chunkElements * sizeof(T), ALIGN);
+
+    // Create the input file only if there is none, never overwriting data
+    struct stat st;
+    if (stat(inName.c_str(), &st) != 0)
+    {
+        cout << "Writing " << streamMB << " MB to " << inName << endl;
+        int fd = open(inName.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        long total = streamMB * 1024 * 1024 / sizeof(T);
+        bool ok = fd >= 0;
+        srand(time(NULL));
+        for (long first = 0; ok && first < total; first += chunkElements)
+        {
+            long n = min(chunkElements, total - first);
+            for (long i = 0; i < n; i++)
+                in0[i] = scanInput<T>(ScanSum<T>());
+            ok = write(fd, in0, n * sizeof(T)) == (ssize_t)(n * sizeof(T));
+        }
+        if (fd >= 0)
+            close(fd);
+        if (!ok || stat(inName.c_str(), &st) != 0)
+        {
+            cerr << "Error: unable to write " << inName << endl;
+            _mm_free(in0);
+            _mm_free(in1);
+            _mm_free(out0);
+            _mm_free(out1);
             return;
         }
+    }
 
-        char atts[1024];
-        double avgTime = (totalScanTime / (double) iters);
-        sprintf(atts, "%d items", pbSizeElements);
-        double gb = (double)(pbSizeElements * sizeof(T)) / (1000. * 1000. * 1000.);
-        resultDB.AddResult(testName, atts, "GB/s", gb / avgTime);
-        resultDB.AddResult(testName+"_PCIe", atts, "GB/s", gb / (avgTime + transferTime));
-        resultDB.AddResult(testName+"_Parity", atts, "N", transferTime / avgTime);
+    long size  = st.st_size / sizeof(T);
+    int inFd   = open(inName.c_str(), O_RDONLY);
+    int outFd  = open(outName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    T *input   = size ? (T*)mmap(NULL, size * sizeof(T), PROT_READ,
+                                 MAP_SHARED, inFd, 0) : NULL;
+    bool ok = size > 0 && inFd >= 0 && outFd >= 0 && input != MAP_FAILED;
+    if (!ok)
+        cerr << "Error: unable to open " << inName << " or " << outName
+             << endl;
+    else
+        madvise(input, size * sizeof(T), MADV_SEQUENTIAL);
+
+    // Allocate the chunk buffers on the card; ok changes below
+    const bool allocated = ok;
+    #pragma offload target(mic:micdev) if(allocated)        \
+            nocopy(in0:length(chunkElements) free_if(0))    \
+            nocopy(in1:length(chunkElements) free_if(0))    \
+            nocopy(out0:length(chunkElements) free_if(0))   \
+            nocopy(out1:length(chunkElements) free_if(0))
+    {
     }
 
-    // Clean up
-    #pragma offload target(mic:micdev) in(h_idata:length(pbSizeElements + 1) alloc_if(0) ) \
-                                out(h_odata:length(pbSizeElements + 1) alloc_if(0))
+    long nChunks = (size + chunkElements - 1) / chunkElements;
+    double readTime = 0, cardTime = 0, scanWait = 0;
+    T carry = 0;
+    AsyncWriter writer(outFd);
+    double start = curr_second();
+
+    // Read the first chunk
+    long n = ok ? min(chunkElements, size) : 0;
+    double t = curr_second();
+    #pragma omp parallel for
+    for (long i = 0; i < n; i++)
+        in0[i] = input[i];
+    readTime += curr_second() - t;
+
+    for (long c = 0; ok && c < nChunks; c++)
     {
+        long first = c * chunkElements;
+        long next  = first + n;
+        long nNext = min(chunkElements, size - next);
+        T* in      = (c & 1) ? in1 : in0;
+        T* out     = (c & 1) ? out1 : out0;
+        T* inNext  = (c & 1) ? in0 : in1;
+        double chunkTime = 0;
+
+        // Scan this chunk on the card...
+        #pragma offload target(mic:micdev)                      \
+                in(in:length(n) alloc_if(0) free_if(0))         \
+                out(out:length(n) alloc_if(0) free_if(0))       \
+                in(n, nThreads, tileElements) inout(carry)      \
+                out(chunkTime) signal(out)
+        {
+            double t0 = omp_get_wtime();
+            carry = SCAN_LOOKBACK<T>(in, out, n, nThreads, 1, tileElements,
+                                     carry, false, ScanSum<T>());
+            chunkTime = omp_get_wtime() - t0;
+        }
+
+        // ...while reading the next one
+        t = curr_second();
+        if (nNext > 0)
+        {
+            madvise(input + next + nNext, min(chunkElements,
+                    size - next - nNext) * sizeof(T), MADV_WILLNEED);
+            #pragma omp parallel for
+            for (long i = 0; i < nNext; i++)
+                inNext[i] = input[next + i];
+        }
+        madvise(input + first, n * sizeof(T), MADV_DONTNEED);
+        readTime += curr_second() - t;
+
+        t = curr_second();
+        #pragma offload_wait target(mic:micdev) wait(out)
+        scanWait += curr_second() - t;
+        cardTime += chunkTime;
+
+        // The write of the previous chunk completes before this one
+        // starts, so its buffer is free for the next chunk's result
+        ok = writer.start(out, n * sizeof(T));
+        n = nNext;
     }
-    _mm_free(h_idata - ALIGN + 1);
-    _mm_free(h_odata - ALIGN + 1);
-    _mm_free(reference);
+    ok = ok && writer.wait() && writer.bytes() == (off_t)(size * sizeof(T));
+    double totalTime = curr_second() - start;
+
+    #pragma offload target(mic:micdev) if(allocated)                    \
+            nocopy(in0:length(chunkElements) alloc_if(0) free_if(1))    \
+            nocopy(in1:length(chunkElements) alloc_if(0) free_if(1))    \
+            nocopy(out0:length(chunkElements) alloc_if(0) free_if(1))   \
+            nocopy(out1:length(chunkElements) alloc_if(0) free_if(1))
+    {
+    }
+
+    // Verify the output against a serial scan of the input
+    T *output = NULL;
+    if (ok)
+    {
+        output = (T*)mmap(NULL, size * sizeof(T), PROT_READ, MAP_SHARED,
+                          outFd, 0);
+        ok = output != MAP_FAILED;
+    }
+    if (ok)
+    {
+        T sum = 0;
+        long mismatches = 0;
+        for (long i = 0; i < size; i++)
+        {
+            sum += input[i];
+            mismatches += output[i] != sum;
+        }
+        munmap(output, size * sizeof(T));
+        ok = mismatches == 0;
+        cout << "Test " << (ok ? "Passed" : "Failed") << endl;
+    }
+    else
+    {
+        cerr << "Error: streaming scan I/O failed" << endl;
+    }
+
+    if (ok)
+    {
+        char atts[1024];
+        sprintf(atts, "%ld items %ld chunks", size, nChunks);
+        double gb = (double)size * sizeof(T) / (1000. * 1000. * 1000.);
+        resultDB.AddResult(testName, atts, "GB/s", gb / totalTime);
+        resultDB.AddResult(testName+"_ReadTime", atts, "s", readTime);
+        resultDB.AddResult(testName+"_ScanTime", atts, "s", cardTime);
+        resultDB.AddResult(testName+"_ScanWait", atts, "s", scanWait);
+        resultDB.AddResult(testName+"_WriteWait", atts, "s",
+                           writer.waitTime);
+        resultDB.AddResult(testName+"_Overlap", atts, "x",
+                           (readTime + cardTime) / totalTime);
+    }
+
+    // Clean up
+    if (input != NULL && input != MAP_FAILED)
+        munmap(input, size * sizeof(T));
+    if (inFd >= 0)
+        close(inFd);
+    if (outFd >= 0)
+        close(outFd);
+    _mm_free(in0);
+    _mm_free(in1);
+    _mm_free(out0);
+    _mm_free(out1);
 }
 
 // ****************************************************************************
@@ -244,40 +1063,32 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
 //   reference : space for the cpu solution
 //   dev_result : result from the device
 //   size : number of elements
+//   exclusive : the device wrote exclusive prefixes
+//   op : the scan operator
 //
 // Returns:  nothing, prints relevant info to stdout
 //
 // Modifications:
 //
 // ****************************************************************************
-template <class T>
-bool scanCPU(T *data, T* reference, T* dev_result, const size_t size)
+template <class T, class Op>
+bool scanCPU(T *data, T* reference, T* dev_result, const size_t size,
+             bool exclusive, Op op)
 {
     reference[0] = 0;
     bool passed = true;
 
-    // NB: You cannot validate beyond a certain buffer size because
-    // of rounding errors.
-    if (size > 128)
+    if (size > 0)
     {
-        // This is an inclusive scan while the OpenMP code is an exclusive scan
-        reference[0] = data[0];
-        for (unsigned int i = 1; i < size; ++i)
+        T carry = Op::identity();
+        for (size_t i = 0; i < size; ++i)
         {
-            reference[i] = data[i] + reference[i - 1];
+            T next = op(carry, data[i]);
+            reference[i] = exclusive ? carry : next;
+            carry = next;
         }
 
-        for (unsigned int i = 0; i < size; ++i)
-        {
-            if (abs(reference[i] - dev_result[i]) > ERR )
-            {
-#ifdef VERBOSE_OUTPUT
-                cout << "Mismatch at i: " << i << " ref: " << reference[i - 1]
-                     << " dev: " << dev_result[i] << endl;
-#endif
-                passed = false;
-            }
-        }
+        passed = scanMatch(reference, dev_result, size);
     }
     cout << "Test ";
     if (passed)
@@ -286,3 +1097,34 @@ bool scanCPU(T *data, T* reference, T* dev_result, const size_t size)
         cout << "Failed" << endl;
     return passed;
 }
+
+// ****************************************************************************
+// Function: scanMatch
+//
+// Purpose:
+//   Compares device results against the cpu solution, exactly for
+//   integers and within ERR for floating point
+//
+// Returns:  true if all elements match
+//
+// ****************************************************************************
+template <class T>
+bool scanMatch(const T* reference, const T* dev_result, const size_t size)
+{
+    bool passed = true;
+    for (size_t i = 0; i < size; ++i)
+    {
+        bool match = std::numeric_limits<T>::is_integer ?
+            reference[i] == dev_result[i] :
+            abs(reference[i] - dev_result[i]) <= ERR;
+        if (!match)
+        {
+#ifdef VERBOSE_OUTPUT
+            cout << "Mismatch at i: " << i << " ref: " << reference[i]
+                 << " dev: " << dev_result[i] << endl;
+#endif
+            passed = false;
+        }
+    }
+    return passed;
+}
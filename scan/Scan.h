@@ -35,13 +35,32 @@
 void
 RunBenchmark(ResultDatabase&, OptionParser&);
 
-template <class T>
-__declspec(target(mic))
-void scanArray(T* , T* , const size_t);
+template <class T, class Op>
+bool scanCPU(T*, T* , T* , const size_t, bool, Op);
 
 template <class T>
-bool scanCPU(T*, T* , T* , const size_t );
+bool scanMatch(const T*, const T*, const size_t);
+
+int
+scanThreads(OptionParser &);
 
 template <class T>
 void RunTest(string , ResultDatabase &, OptionParser &);
 
+template <class T>
+void RunStreamTest(string, ResultDatabase &, OptionParser &);
+
+template <class T>
+void RunSizeTest(string, ResultDatabase &, OptionParser &, int, int, int);
+
+template <class T, class Op>
+void RunScanTest(string, ResultDatabase &, OptionParser &, T*, T*, T*,
+                 int, int, double);
+
+template <class T>
+void RunSegmentedTest(string, ResultDatabase &, OptionParser &, T*, T*, T*,
+                      int, int);
+
+template <class T>
+void RunMapScanTest(string, ResultDatabase &, OptionParser &, T*, T*, T*,
+                    int, int);
@@ -33,86 +33,345 @@
 // ==============================================================================
 
 #include <string.h>
+#include <limits>
 
-template <class T> __declspec(target(mic)) void SCAN_KNC(T* pInput,
-                                                         T* pOutput,
-                                                         const size_t nElements,
-                                                         const int nIterations,
-                                                         T fOffset)
+#pragma offload_attribute(push,target(mic))
+
+// Elements scanned in registers at a time
+#define SCAN_BLOCK 32
+
+// Elements mapped into a buffer at a time by the fused map-scans, a
+// multiple of SCAN_BLOCK that stays in the L1
+#define SCAN_MAP_CHUNK 256
+
+// ****************************************************************************
+// Scan operators
+//
+//   An operator is a functor combining two values, which must be
+//   associative but need not be commutative: the kernels always combine a
+//   prefix on the left with what follows it on the right.  identity()
+//   returns the value leaving the other operand unchanged; it is the first
+//   output of an exclusive scan.
+//
+// ****************************************************************************
+template <class T>
+inline T scanLowest()
 {
-    // Keep partial sums in it
-    unsigned int nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 4; // Leave something for the OS
+    return std::numeric_limits<T>::is_integer ?
+        std::numeric_limits<T>::min() : -std::numeric_limits<T>::max();
+}
 
-    T*     pPartialSums    = (T*)_mm_malloc((nThreads + 1) * sizeof(T), ALIGN);
-    size_t nThreadElements = nElements / nThreads;
+template <class T>
+struct ScanSum
+{
+    static const char *name() { return "Sum"; }
+    static T identity() { return 0; }
+    T operator()(T a, T b) const { return a + b; }
+};
+
+template <class T>
+struct ScanProd
+{
+    static const char *name() { return "Prod"; }
+    static T identity() { return 1; }
+    T operator()(T a, T b) const { return a * b; }
+};
+
+template <class T>
+struct ScanMax
+{
+    static const char *name() { return "Max"; }
+    static T identity() { return scanLowest<T>(); }
+    T operator()(T a, T b) const { return a < b ? b : a; }
+};
+
+template <class T>
+struct ScanMin
+{
+    static const char *name() { return "Min"; }
+    static T identity() { return std::numeric_limits<T>::max(); }
+    T operator()(T a, T b) const { return b < a ? b : a; }
+};
+
+// ****************************************************************************
+// Function: scanBlock
+//
+// Purpose:
+//   Inclusive scan of SCAN_BLOCK elements in registers: pairs are combined
+//   first, the odd positions are scanned over the pairs, and the even
+//   positions are filled in from their left neighbours.  Loads are kept
+//   contiguous, without gather/scatter.
+//
+// ****************************************************************************
+template <class T, class Op>
+inline void scanBlock(const T* pInput, T* vTemp, Op op)
+{
+    const int nPairs = SCAN_BLOCK / 2;
+
+    // Don't use G/S
+    #pragma novector
+    for (int k = 0; k < nPairs; k++)
+        vTemp[k * 2 + 1] = op(pInput[k * 2], pInput[k * 2 + 1]);
+
+    // Don't use G/S
+    #pragma novector
+    for (int k = 1; k < nPairs; k++)
+        vTemp[k * 2 + 1] = op(vTemp[k * 2 - 1], vTemp[k * 2 + 1]);
+
+    vTemp[0] = pInput[0];
+
+    // Don't use G/S
+    #pragma novector
+    for (int k = 1; k < nPairs; k++)
+        vTemp[k * 2] = op(vTemp[k * 2 - 1], pInput[k * 2]);
+}
+
+// ****************************************************************************
+// Function: reduceBlock
+//
+// Purpose:
+//   Combines SCAN_BLOCK elements as a tree of neighbouring pairs, which
+//   keeps their order.
+//
+// ****************************************************************************
+template <class T, class Op>
+inline T reduceBlock(const T* pInput, Op op)
+{
+    __declspec(align(64)) T v[SCAN_BLOCK / 2];
 
-    __declspec(target(mic)) __declspec(align(64)) volatile int g_nThdIndex = -1;
+    #pragma simd vectorlengthfor(T)
+    for (int k = 0; k < SCAN_BLOCK / 2; k++)
+        v[k] = op(pInput[k * 2], pInput[k * 2 + 1]);
 
-    #pragma omp parallel
+    for (int w = SCAN_BLOCK / 4; w > 0; w /= 2)
     {
-        int i = _InterlockedIncrement((void *)&g_nThdIndex);
+        #pragma novector
+        for (int k = 0; k < w; k++)
+            v[k] = op(v[k * 2], v[k * 2 + 1]);
+    }
+    return v[0];
+}
 
-        for (int iteration = 0; iteration < nIterations; iteration++)
-        {
-            // Working pointers
-            T* pCrntInput  = pInput;
-            T* pCrntOutput = pOutput;
+// ****************************************************************************
+// Function: scanPartialBlock
+//
+// Purpose:
+//   Scans fewer than SCAN_BLOCK elements with the block scan, padding the
+//   block with the identity, so heads and tails stay vectorized.
+//
+// Returns:  the carry combined with the n elements
+//
+// ****************************************************************************
+template <class T, class Op>
+inline T scanPartialBlock(const T* pInput, T* pOutput, size_t n, T carry,
+                          bool exclusive, Op op)
+{
+    __declspec(align(64)) T vInput[SCAN_BLOCK];
+    __declspec(align(64)) T vTemp[SCAN_BLOCK + 1];
+
+    for (int k = 0; k < SCAN_BLOCK; k++)
+        vInput[k] = k < n ? pInput[k] : Op::identity();
+
+    vTemp[0] = Op::identity();
+    scanBlock(vInput, vTemp + 1, op);
+
+    const T* v = exclusive ? vTemp : vTemp + 1;
 
-            T fPartialSums = 0;
+    #pragma simd vectorlengthfor(T)
+    for (int k = 0; k < n; k++)
+        pOutput[k] = op(carry, v[k]);
 
-            #pragma simd reduction(+:fPartialSums) vectorlengthfor(T)
-            for (int j = 0; j < nThreadElements; j++)
-                fPartialSums += pCrntInput[j + i * nThreadElements];
+    return op(carry, vTemp[n]);
+}
 
-            pPartialSums[i + 1] = fPartialSums;
+// ****************************************************************************
+// Function: scanRange
+//
+// Purpose:
+//   Scans pInput[0, n) into pOutput starting from the carry.  A partial
+//   block brings the output to a 64 byte boundary, whole blocks follow
+//   with aligned stores, and a partial block finishes the tail.
+//
+// Returns:  the carry combined with all n elements
+//
+// ****************************************************************************
+template <class T, class Op>
+inline T scanRange(const T* pInput, T* pOutput, size_t n, T carry,
+                   bool exclusive, Op op)
+{
+    size_t j = ((64 - ((size_t)pOutput & 63)) & 63) / sizeof(T);
+    if (j > n)
+        j = n;
+    if (j > 0)
+        carry = scanPartialBlock(pInput, pOutput, j, carry, exclusive, op);
+
+    for (; j + SCAN_BLOCK <= n; j += SCAN_BLOCK)
+    {
+        // vTemp[0] is the identity, so vTemp[k] is the exclusive prefix
+        // of element k and vTemp[k + 1] the inclusive one
+        __declspec(align(64)) T vTemp[SCAN_BLOCK + 1];
+        vTemp[0] = Op::identity();
+        scanBlock(pInput + j, vTemp + 1, op);
+
+        T*       out = pOutput + j;
+        const T* v   = exclusive ? vTemp : vTemp + 1;
+
+        __assume_aligned(out, 64);
+
+        #pragma simd vectorlengthfor(T)
+        for (int k = 0; k < SCAN_BLOCK; k++)
+            out[k] = op(carry, v[k]);
+
+        carry = op(carry, vTemp[SCAN_BLOCK]);
+    }
+
+    if (j < n)
+        carry = scanPartialBlock(pInput + j, pOutput + j, n - j, carry,
+                                 exclusive, op);
+    return carry;
+}
+
+// ****************************************************************************
+// Function: reduceRange
+//
+// Purpose:
+//   Combines pInput[0, n) in order, a block at a time, with the tail
+//   padded to a block with the identity.
+//
+// ****************************************************************************
+template <class T, class Op>
+inline T reduceRange(const T* pInput, size_t n, Op op)
+{
+    T total = Op::identity();
+    size_t j = 0;
+    for (; j + SCAN_BLOCK <= n; j += SCAN_BLOCK)
+        total = op(total, reduceBlock(pInput + j, op));
+
+    if (j < n)
+    {
+        __declspec(align(64)) T vInput[SCAN_BLOCK];
+        for (int k = 0; k < SCAN_BLOCK; k++)
+            vInput[k] = j + k < n ? pInput[j + k] : Op::identity();
+        total = op(total, reduceBlock(vInput, op));
+    }
+    return total;
+}
+
+// ****************************************************************************
+// Function: scanMapRange, reduceMapRange
+//
+// Purpose:
+//   scanRange and reduceRange of map(pInput[0, n)).  The input is mapped
+//   SCAN_MAP_CHUNK elements at a time into a buffer in the L1, so the
+//   mapped values are never written to memory.
+//
+// ****************************************************************************
+template <class T, class Op, class Map>
+inline T scanMapRange(const T* pInput, T* pOutput, size_t n, T carry,
+                      bool exclusive, Op op, const Map &map)
+{
+    __declspec(align(64)) T vMapped[SCAN_MAP_CHUNK];
+    for (size_t j = 0; j < n; j += SCAN_MAP_CHUNK)
+    {
+        size_t m = n - j < SCAN_MAP_CHUNK ? n - j : SCAN_MAP_CHUNK;
+
+        #pragma simd vectorlengthfor(T)
+        for (int k = 0; k < m; k++)
+            vMapped[k] = map(pInput[j + k]);
+
+        carry = scanRange(vMapped, pOutput + j, m, carry, exclusive, op);
+    }
+    return carry;
+}
+
+template <class T, class Op, class Map>
+inline T reduceMapRange(const T* pInput, size_t n, Op op, const Map &map)
+{
+    __declspec(align(64)) T vMapped[SCAN_MAP_CHUNK];
+    T total = Op::identity();
+    for (size_t j = 0; j < n; j += SCAN_MAP_CHUNK)
+    {
+        size_t m = n - j < SCAN_MAP_CHUNK ? n - j : SCAN_MAP_CHUNK;
+
+        #pragma simd vectorlengthfor(T)
+        for (int k = 0; k < m; k++)
+            vMapped[k] = map(pInput[j + k]);
+
+        total = op(total, reduceRange(vMapped, m, op));
+    }
+    return total;
+}
+
+// ****************************************************************************
+// Function: SCAN_KNC
+//
+// Purpose:
+//   Two pass parallel scan: every thread reduces its chunk, thread 0 scans
+//   the chunk totals, then every thread scans its chunk from its prefix.
+//   Any length is scanned; the first nElements % nThreads threads take one
+//   element more than the others.
+//
+// Arguments:
+//   pInput, pOutput: input and output arrays
+//   nElements: elements to scan
+//   nThreads: threads to run
+//   nIterations: times to repeat the scan
+//   fOffset: value combined in front of the first element
+//   exclusive: write exclusive rather than inclusive prefixes
+//   op: the scan operator
+//
+// Returns:  fOffset combined with all elements, the carry into a following
+//           chunk
+//
+// ****************************************************************************
+template <class T, class Op>
+T SCAN_KNC(const T* pInput, T* pOutput, const size_t nElements,
+           const int nThreads, const int nIterations, T fOffset,
+           bool exclusive, Op op)
+{
+    T*     pPartialSums    = (T*)_mm_malloc((nThreads + 1) * sizeof(T), ALIGN);
+    size_t nThreadElements = nElements / nThreads;
+    size_t nRemainder      = nElements % nThreads;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int i = omp_get_thread_num();
+        size_t first = i * nThreadElements + (i < nRemainder ? i : nRemainder);
+        size_t n     = nThreadElements + (i < nRemainder ? 1 : 0);
+        const T* pCrntInput  = pInput + first;
+        T*       pCrntOutput = pOutput + first;
+
+        for (int iteration = 0; iteration < nIterations; iteration++)
+        {
+            pPartialSums[i + 1] = reduceRange(pCrntInput, n, op);
 
             #pragma omp barrier
             ;
 
-            if(i == 0)
+            if (i == 0)
             {
                 pPartialSums[0] = fOffset;
                 for (int j = 1; j <= nThreads; j++)
                 {
-                    pPartialSums[j] += pPartialSums[j-1];
+                    pPartialSums[j] = op(pPartialSums[j - 1], pPartialSums[j]);
                 }
             }
 
             #pragma omp barrier
             ;
 
-            pCrntOutput[i * nThreadElements] = pCrntInput[i * nThreadElements] + pPartialSums[i];
+            scanRange(pCrntInput, pCrntOutput, n, pPartialSums[i],
+                      exclusive, op);
 
-            for (int j = i * nThreadElements + 1; j < (i+1) * nThreadElements; j += 32)
-            {
-                __declspec(align(64)) T vTemp[32];
-
-                // Don't use G/S
-                #pragma novector
-                for (int k = 0; k < 16; k++)
-                    vTemp[k * 2 + 1] = pCrntInput[j + k * 2] + pCrntInput[j + k * 2 + 1];
-
-                // Don't use G/S
-                #pragma novector
-                for (int k = 1; k < 16; k ++)
-                    vTemp[k * 2 + 1] += vTemp[k * 2 - 1];
-
-                vTemp[0] = pCrntInput[j];
-
-                // Don't use G/S
-                #pragma novector
-                for (int k = 1; k < 16; k++)
-                    vTemp[k * 2] = vTemp[k * 2 - 1] + pCrntInput[j + k * 2];
-
-                T*  out = pCrntOutput + j;
-                int inc = pCrntOutput[j - 1];
-
-                __assume_aligned(out, 64);
-
-                #pragma simd vectorlengthfor(T)
-                for (int k = 0; k < 32; k++)
-                    out[k] = inc + vTemp[k];
-            }
+            // The partials are rewritten by the next iteration
+            #pragma omp barrier
+            ;
         }
     }
+
+    T total = pPartialSums[nThreads];
+    _mm_free(pPartialSums);
+    return total;
 }
+
+#pragma offload_attribute(pop)
@@ -0,0 +1,317 @@
+//===========================================================================
+//
+// This example from a prerelease of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.1i for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//         Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, nor
+//    the names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ==============================================================================
+
+// ****************************************************************************
+// File:  Scan_Lookback.h
+//
+// Purpose:
+//   Single pass chained scan with decoupled look-back.  The input is cut
+//   into cache sized tiles, handed out to the threads in order.  A thread
+//   reduces its tile, publishes the tile's aggregate, then walks back over
+//   its predecessors combining their aggregates until it reaches one that
+//   has published its inclusive prefix.  It publishes its own inclusive
+//   prefix and scans the tile, which is still in cache, from the exclusive
+//   prefix it found.  Memory traffic is one read and one write of the
+//   data, against two reads and a write for SCAN_KNC, and no thread waits
+//   at a barrier within a scan.
+//
+// ****************************************************************************
+
+#include <immintrin.h>
+#include <sched.h>
+
+#pragma offload_attribute(push,target(mic))
+
+// Tile states, offset by twice the iteration so the flags never need
+// resetting between iterations
+#define SCAN_TILE_AGGREGATE 1
+#define SCAN_TILE_PREFIX    2
+
+// Polls before a waiting thread gives up its hardware thread
+#define SCAN_SPIN_YIELD     64
+
+#ifdef __MIC__
+#define SCAN_PAUSE() _mm_delay_32(8)
+#else
+#define SCAN_PAUSE() _mm_pause()
+#endif
+
+// Status of one tile
+template <class T>
+struct ScanTileFields
+{
+    volatile int flag;
+    T aggregate;            // the tile's elements combined
+    T prefix;               // everything up to the end of the tile
+};
+
+// A tile's status padded to whole cache lines, alignment padding included
+template <class T>
+struct ScanTileStatus : ScanTileFields<T>
+{
+    char pad[64 - sizeof(ScanTileFields<T>) % 64];
+};
+
+// ****************************************************************************
+// Function: scanWaitFlag
+//
+// Purpose:
+//   Waits until a tile's flag reaches state, yielding after
+//   SCAN_SPIN_YIELD polls so that oversubscribed threads make progress
+//
+// Returns:  the flag read
+//
+// ****************************************************************************
+inline int scanWaitFlag(volatile int *flag, int state)
+{
+    int f;
+    for (int spins = 0; (f = *flag) < state; spins++)
+    {
+        if (spins >= SCAN_SPIN_YIELD)
+            sched_yield();
+        else
+            SCAN_PAUSE();
+    }
+    __sync_synchronize();
+    return f;
+}
+
+// ****************************************************************************
+// Function: lookbackScan
+//
+// Purpose:
+//   Runs the look-back over the tiles of an array.  What a tile holds is
+//   up to the tile functor: tile.reduce(first, n) combines the tile's
+//   elements into a T, and tile.scan(first, n, prefix) processes the tile
+//   given everything before it combined.  Scans, segmented scans and
+//   stream compaction are all tile functors.
+//
+// Arguments:
+//   nElements: elements in the array
+//   nThreads: threads to run
+//   nIterations: times to repeat the scan
+//   tileElements: elements per tile, sized to stay in cache between
+//                 tile.reduce and tile.scan
+//   fOffset: value combined in front of the first tile
+//   op: the operator combining tile aggregates
+//   tile: the tile functor
+//
+// Returns:  fOffset combined with all tiles
+//
+// ****************************************************************************
+template <class T, class Op, class Tile>
+T lookbackScan(const size_t nElements, const int nThreads,
+               const int nIterations, const size_t tileElements,
+               T fOffset, Op op, const Tile &tile)
+{
+    long nTiles = (nElements + tileElements - 1) / tileElements;
+    if (nTiles == 0)
+        return fOffset;
+
+    ScanTileStatus<T>* pStatus = (ScanTileStatus<T>*)
+        _mm_malloc(nTiles * sizeof(ScanTileStatus<T>), ALIGN);
+    // Next tile to hand out, per iteration
+    volatile long* pNext = (volatile long*)
+        _mm_malloc(nIterations * sizeof(long), ALIGN);
+    for (long t = 0; t < nTiles; t++)
+        pStatus[t].flag = 0;
+    for (int iteration = 0; iteration < nIterations; iteration++)
+        pNext[iteration] = 0;
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        for (int iteration = 0; iteration < nIterations; iteration++)
+        {
+            const int aggregateState = 2 * iteration + SCAN_TILE_AGGREGATE;
+            const int prefixState    = 2 * iteration + SCAN_TILE_PREFIX;
+
+            for (;;)
+            {
+                // Tiles are taken in order, so every tile a thread waits
+                // for is held by a running thread
+                long t = __sync_fetch_and_add(&pNext[iteration], 1);
+                if (t >= nTiles)
+                    break;
+
+                size_t first = t * tileElements;
+                size_t n     = nElements - first < tileElements ?
+                               nElements - first : tileElements;
+                ScanTileStatus<T> &s = pStatus[t];
+
+                T aggregate = tile.reduce(first, n);
+                T prefix    = fOffset;
+
+                if (t > 0)
+                {
+                    s.aggregate = aggregate;
+                    __sync_synchronize();
+                    s.flag = aggregateState;
+
+                    // Combine predecessors right to left until one has
+                    // its inclusive prefix
+                    prefix = Op::identity();
+                    for (long p = t - 1; ; p--)
+                    {
+                        int f = scanWaitFlag(&pStatus[p].flag, aggregateState);
+                        if (f >= prefixState)
+                        {
+                            prefix = op(pStatus[p].prefix, prefix);
+                            break;
+                        }
+                        prefix = op(pStatus[p].aggregate, prefix);
+                    }
+                }
+
+                s.prefix = op(prefix, aggregate);
+                __sync_synchronize();
+                s.flag = prefixState;
+
+                tile.scan(first, n, prefix);
+            }
+
+            // The tiles are handed out again by the next iteration
+            #pragma omp barrier
+            ;
+        }
+    }
+
+    T total = pStatus[nTiles - 1].prefix;
+    _mm_free(pStatus);
+    _mm_free((void*)pNext);
+    return total;
+}
+
+// Tile functor of a plain scan
+template <class T, class Op>
+struct ScanTile
+{
+    const T* pInput;
+    T*       pOutput;
+    bool     exclusive;
+    Op       op;
+
+    T reduce(size_t first, size_t n) const
+    {
+        return reduceRange(pInput + first, n, op);
+    }
+
+    void scan(size_t first, size_t n, T prefix) const
+    {
+        scanRange(pInput + first, pOutput + first, n, prefix, exclusive, op);
+    }
+};
+
+// ****************************************************************************
+// Function: SCAN_LOOKBACK
+//
+// Purpose:
+//   Single pass parallel scan with decoupled look-back
+//
+// Arguments:
+//   pInput, pOutput: input and output arrays
+//   nElements: elements to scan
+//   nThreads: threads to run
+//   nIterations: times to repeat the scan
+//   tileElements: elements per tile, a multiple of SCAN_BLOCK sized to
+//                 stay in cache between the reduction and the scan
+//   fOffset: value combined in front of the first element
+//   exclusive: write exclusive rather than inclusive prefixes
+//   op: the scan operator
+//
+// Returns:  fOffset combined with all elements
+//
+// ****************************************************************************
+template <class T, class Op>
+T SCAN_LOOKBACK(const T* pInput, T* pOutput, const size_t nElements,
+                const int nThreads, const int nIterations,
+                const size_t tileElements, T fOffset, bool exclusive, Op op)
+{
+    ScanTile<T, Op> tile;
+    tile.pInput    = pInput;
+    tile.pOutput   = pOutput;
+    tile.exclusive = exclusive;
+    tile.op        = op;
+    return lookbackScan(nElements, nThreads, nIterations, tileElements,
+                        fOffset, op, tile);
+}
+
+// Tile functor of a scan of mapped elements
+template <class T, class Op, class Map>
+struct MapScanTile
+{
+    const T* pInput;
+    T*       pOutput;
+    bool     exclusive;
+    Op       op;
+    Map      map;
+
+    T reduce(size_t first, size_t n) const
+    {
+        return reduceMapRange(pInput + first, n, op, map);
+    }
+
+    void scan(size_t first, size_t n, T prefix) const
+    {
+        scanMapRange(pInput + first, pOutput + first, n, prefix, exclusive,
+                     op, map);
+    }
+};
+
+// ****************************************************************************
+// Function: SCAN_MAP_LOOKBACK
+//
+// Purpose:
+//   SCAN_LOOKBACK of map(pInput[i]): a chain of element-wise steps and a
+//   scan in a single pass, without writing the mapped elements
+//
+// Returns:  fOffset combined with all mapped elements
+//
+// ****************************************************************************
+template <class T, class Op, class Map>
+T SCAN_MAP_LOOKBACK(const T* pInput, T* pOutput, const size_t nElements,
+                    const int nThreads, const int nIterations,
+                    const size_t tileElements, T fOffset, bool exclusive,
+                    Op op, const Map &map)
+{
+    MapScanTile<T, Op, Map> tile;
+    tile.pInput    = pInput;
+    tile.pOutput   = pOutput;
+    tile.exclusive = exclusive;
+    tile.op        = op;
+    tile.map       = map;
+    return lookbackScan(nElements, nThreads, nIterations, tileElements,
+                        fOffset, op, tile);
+}
+
+#pragma offload_attribute(pop)
@@ -0,0 +1,319 @@
+//===========================================================================
+//
+// This example from a prerelease of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.1i for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//         Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, nor
+//    the names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ==============================================================================
+
+// ****************************************************************************
+// File:  Scan_Segmented.h
+//
+// Purpose:
+//   Segmented scans and stream compaction as look-back tile functors.
+//
+//   A segmented scan restarts at every segment head.  Tiles combine as
+//   (head, value) pairs: a pair with a head replaces whatever is to its
+//   left, which keeps the operator associative.  Heads come either as a
+//   flag per element or as sorted segment offsets.
+//
+//   Compaction counts the selected elements of a tile, looks back for the
+//   count before it, and packs the tile, still in cache, from there: the
+//   input is read from memory once.  Partitioning also writes the rejected
+//   elements, from the end of the output backwards.
+//
+// ****************************************************************************
+
+#include <algorithm>
+
+#pragma offload_attribute(push,target(mic))
+
+// Tile aggregate of a segmented scan: whether the tile holds a head, and
+// its elements combined from the last head, or all of them if none
+template <class T>
+struct ScanSegPair
+{
+    T   value;
+    int head;
+};
+
+template <class T, class Op>
+struct ScanSegmented
+{
+    Op op;
+
+    ScanSegmented(const Op &op_ = Op()) : op(op_) {}
+
+    static ScanSegPair<T> identity()
+    {
+        ScanSegPair<T> r;
+        r.value = Op::identity();
+        r.head  = 0;
+        return r;
+    }
+
+    ScanSegPair<T> operator()(ScanSegPair<T> a, ScanSegPair<T> b) const
+    {
+        ScanSegPair<T> r;
+        r.value = b.head ? b.value : op(a.value, b.value);
+        r.head  = a.head | b.head;
+        return r;
+    }
+};
+
+// ****************************************************************************
+// Struct: SegFlagTile
+//
+// Purpose:
+//   Tile functor of a segmented scan with a head flag per element.  The
+//   runs between heads are scanned with the block scan.
+//
+// ****************************************************************************
+template <class T, class Op>
+struct SegFlagTile
+{
+    const T*             pInput;
+    const unsigned char* pFlags;
+    T*                   pOutput;
+    bool                 exclusive;
+    Op                   op;
+
+    ScanSegPair<T> reduce(size_t first, size_t n) const
+    {
+        size_t j = n;
+        while (j > 0 && !pFlags[first + j - 1])
+            j--;
+
+        ScanSegPair<T> r;
+        r.head  = j > 0;
+        j       = r.head ? j - 1 : 0;
+        r.value = reduceRange(pInput + first + j, n - j, op);
+        return r;
+    }
+
+    void scan(size_t first, size_t n, ScanSegPair<T> prefix) const
+    {
+        T carry = prefix.value;
+        for (size_t a = 0, b; a < n; a = b)
+        {
+            for (b = a + 1; b < n && !pFlags[first + b]; b++)
+                ;
+            if (pFlags[first + a])
+                carry = Op::identity();
+            carry = scanRange(pInput + first + a, pOutput + first + a,
+                              b - a, carry, exclusive, op);
+        }
+    }
+};
+
+// ****************************************************************************
+// Struct: SegOffsetTile
+//
+// Purpose:
+//   Tile functor of a segmented scan with segment offsets.  The heads in a
+//   tile are found by binary search.
+//
+// ****************************************************************************
+template <class T, class Op>
+struct SegOffsetTile
+{
+    const T*   pInput;
+    const int* pOffsets;        // first element of every segment, sorted
+    int        nSegments;
+    T*         pOutput;
+    bool       exclusive;
+    Op         op;
+
+    ScanSegPair<T> reduce(size_t first, size_t n) const
+    {
+        // last head in the tile
+        const int* h = std::upper_bound(pOffsets, pOffsets + nSegments,
+                                        (long)(first + n - 1));
+        ScanSegPair<T> r;
+        r.head = h > pOffsets && (size_t)h[-1] >= first;
+        size_t j = r.head ? h[-1] - first : 0;
+        r.value = reduceRange(pInput + first + j, n - j, op);
+        return r;
+    }
+
+    void scan(size_t first, size_t n, ScanSegPair<T> prefix) const
+    {
+        // first head in the tile
+        const int* h = std::lower_bound(pOffsets, pOffsets + nSegments,
+                                        (long)first);
+        const int* end = pOffsets + nSegments;
+        T carry = prefix.value;
+        for (size_t a = 0, b; a < n; a = b)
+        {
+            bool head = h < end && (size_t)*h == first + a;
+            while (h < end && (size_t)*h <= first + a)
+                h++;
+            b = (h < end && (size_t)*h < first + n) ? *h - first : n;
+            if (head)
+                carry = Op::identity();
+            carry = scanRange(pInput + first + a, pOutput + first + a,
+                              b - a, carry, exclusive, op);
+        }
+    }
+};
+
+// ****************************************************************************
+// Struct: SelectTile
+//
+// Purpose:
+//   Tile functor of compaction.  Selected elements are packed to the
+//   front of the output in order; when partitioning, the rejected ones
+//   are packed to the back in reverse order.
+//
+// ****************************************************************************
+template <class T, class Pred>
+struct SelectTile
+{
+    const T* pInput;
+    T*       pOutput;
+    size_t   nElements;
+    bool     partition;
+    Pred     pred;
+
+    long reduce(size_t first, size_t n) const
+    {
+        const T* in = pInput + first;
+        long count = 0;
+        #pragma simd reduction(+:count)
+        for (size_t j = 0; j < n; j++)
+            count += pred(in[j]) ? 1 : 0;
+        return count;
+    }
+
+    void scan(size_t first, size_t n, long prefix) const
+    {
+        const T* in       = pInput + first;
+        long     selected = prefix;
+        long     rejected = first - prefix;
+        for (size_t j = 0; j < n; j++)
+        {
+            if (pred(in[j]))
+                pOutput[selected++] = in[j];
+            else if (partition)
+                pOutput[nElements - 1 - rejected++] = in[j];
+        }
+    }
+};
+
+// Selects the positive elements
+template <class T>
+struct ScanPositive
+{
+    bool operator()(T x) const { return x > 0; }
+};
+
+// ****************************************************************************
+// Function: SEGSCAN_FLAGS
+//
+// Purpose:
+//   Single pass segmented scan, segments starting where pFlags is set
+//
+// Arguments:
+//   pInput, pFlags, pOutput: input, head flags and output arrays
+//   nElements, nThreads, nIterations, tileElements, exclusive, op: as for
+//                 SCAN_LOOKBACK
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T, class Op>
+void SEGSCAN_FLAGS(const T* pInput, const unsigned char* pFlags, T* pOutput,
+                   const size_t nElements, const int nThreads,
+                   const int nIterations, const size_t tileElements,
+                   bool exclusive, Op op)
+{
+    SegFlagTile<T, Op> tile;
+    tile.pInput    = pInput;
+    tile.pFlags    = pFlags;
+    tile.pOutput   = pOutput;
+    tile.exclusive = exclusive;
+    tile.op        = op;
+    lookbackScan(nElements, nThreads, nIterations, tileElements,
+                 ScanSegmented<T, Op>::identity(), ScanSegmented<T, Op>(op),
+                 tile);
+}
+
+// ****************************************************************************
+// Function: SEGSCAN_OFFSETS
+//
+// Purpose:
+//   Single pass segmented scan, segments starting at pOffsets[0, nSegments)
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class T, class Op>
+void SEGSCAN_OFFSETS(const T* pInput, const int* pOffsets, int nSegments,
+                     T* pOutput, const size_t nElements, const int nThreads,
+                     const int nIterations, const size_t tileElements,
+                     bool exclusive, Op op)
+{
+    SegOffsetTile<T, Op> tile;
+    tile.pInput    = pInput;
+    tile.pOffsets  = pOffsets;
+    tile.nSegments = nSegments;
+    tile.pOutput   = pOutput;
+    tile.exclusive = exclusive;
+    tile.op        = op;
+    lookbackScan(nElements, nThreads, nIterations, tileElements,
+                 ScanSegmented<T, Op>::identity(), ScanSegmented<T, Op>(op),
+                 tile);
+}
+
+// ****************************************************************************
+// Function: SELECT_IF
+//
+// Purpose:
+//   Single pass stream compaction of the elements satisfying pred, or a
+//   partition of them when partition is set
+//
+// Returns:  the number of elements selected
+//
+// ****************************************************************************
+template <class T, class Pred>
+long SELECT_IF(const T* pInput, T* pOutput, const size_t nElements,
+               const int nThreads, const int nIterations,
+               const size_t tileElements, bool partition, Pred pred)
+{
+    SelectTile<T, Pred> tile;
+    tile.pInput    = pInput;
+    tile.pOutput   = pOutput;
+    tile.nElements = nElements;
+    tile.partition = partition;
+    tile.pred      = pred;
+    return lookbackScan(nElements, nThreads, nIterations, tileElements,
+                        0L, ScanSum<long>(), tile);
+}
+
+#pragma offload_attribute(pop)
@@ -33,18 +33,26 @@
 // THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
 #include <vector>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "offload.h"
 #include "omp.h"
 
 #include "OptionParser.h"
 #include "ResultDatabase.h"
 #include "sortKernel.h"
+#include "msdSortKernel.h"
+#include "segSortKernel.h"
+#include "topKKernel.h"
+#include "sortInput.h"
+#include "externalSort.h"
 #include "Sort.h"
 #include "Timer.h"
 
@@ -78,6 +86,29 @@ void addBenchmarkSpecOptions(OptionParser &op)
 {
     op.addOption("iterations", OPT_INT, "256", "specify scan iterations");
     op.addOption("nthreads", OPT_INT, "64", "specify number of threads");
+    op.addOption("digit_bits", OPT_INT, "0", "radix digit width: 8, 11 or "
+                 "16 bits, 0 to choose from the key range");
+    op.addOption("max_threads", OPT_INT, "0", "sweep the thread count in "
+                 "powers of two up to this, reporting barrier latency and "
+                 "u32 sort throughput (0 = no sweep)");
+    op.addOption("max_mb", OPT_INT, "0", "sweep u64 key sizes from 1 MB "
+                 "up to this in factors of 4, comparing the LSD and MSD "
+                 "sorts (0 = no sweep)");
+    op.addOption("cache_kb", OPT_INT, "512", "per-thread cache for the "
+                 "radix histograms and scatter buffers in KB");
+    addDistributionOptions(op);
+    op.addOption("seg_lens", OPT_VECINT, "4,64,4096", "average segment "
+                 "lengths of the segmented sort test");
+    op.addOption("topk", OPT_VECINT, "10,1000,100000", "values of k of the "
+                 "top-k test");
+    op.addOption("ext_file", OPT_STRING, "", "run only the out-of-core "
+                 "sort of the u64 keys in this file");
+    op.addOption("ext_mb", OPT_INT, "0", "create the out-of-core input "
+                 "file with this many MB if it does not exist");
+    op.addOption("run_mb", OPT_INT, "256", "size of the sorted runs of the "
+                 "out-of-core sort in MB");
+    op.addOption("merge_kb", OPT_INT, "4096", "read block of each run in "
+                 "the out-of-core merge in KB");
 
 }
 
@@ -102,49 +133,190 @@ void addBenchmarkSpecOptions(OptionParser &op)
 void
 RunBenchmark(OptionParser &op, ResultDatabase &resultDB)
 {
-    int device;
+    int probSizes[4] = { 1, 8, 48, 96 };
+    int numThreads = op.getOptionInt("nthreads");
+    int maxThreads = op.getOptionInt("max_threads");
+
+    int sizeMB = probSizes[op.getOptionInt("size")-1];
+    int maxMB = op.getOptionInt("max_mb");
+
+    // Key distributions to run, "all" runs each of them
+    vector<string> dists;
+    string dist = op.getOptionString("distribution");
+    if (dist == "all")
+    {
+        dists.assign(sortDistributions, sortDistributions+NUM_DISTRIBUTIONS);
+    }
+    else
+    {
+        dists.push_back(dist);
+    }
+
+    if (op.getOptionString("ext_file") != "")
+    {
+        RunExternalTest(resultDB, op, numThreads, dists[0]);
+        return;
+    }
+
+    if (maxThreads > 0)
+    {
+        RunScalingTest(resultDB, op, maxThreads, dists[0]);
+    }
+
+    for (size_t d = 0; d < dists.size(); d++)
+    {
+        for (int msd = 0; msd < 2; msd++)
+        {
+            string name = msd ? "SortMSD" : "Sort";
 
-    cout << "Running test with unsigned int" << endl;
-    RunTest<unsigned int>("Sort", resultDB, op);
+            cout << "Running " << name << " test with unsigned int keys, "
+                 << dists[d] << " distribution" << endl;
+            RunTest<unsigned int, unsigned int>(name+"-u32", resultDB, op,
+                    numThreads, sizeMB, msd, dists[d]);
 
+            cout << "Running " << name << " test with unsigned long long "
+                 << "keys, " << dists[d] << " distribution" << endl;
+            RunTest<unsigned long long, unsigned int>(name+"-u64", resultDB,
+                    op, numThreads, sizeMB, msd, dists[d]);
+
+            cout << "Running " << name << " test with float keys, "
+                 << dists[d] << " distribution" << endl;
+            RunTest<float, unsigned int>(name+"-f32", resultDB, op,
+                    numThreads, sizeMB, msd, dists[d]);
+
+            cout << "Running " << name << " test with double keys, "
+                 << dists[d] << " distribution" << endl;
+            RunTest<double, unsigned int>(name+"-f64", resultDB, op,
+                    numThreads, sizeMB, msd, dists[d]);
+
+            cout << "Running " << name << " test with unsigned long long "
+                 << "key-value pairs, " << dists[d] << " distribution"
+                 << endl;
+            RunTest<unsigned long long, unsigned long long>(name+"-u64u64",
+                    resultDB, op, numThreads, sizeMB, msd, dists[d]);
+        }
+
+        cout << "Running segmented sort and top-k tests, " << dists[d]
+             << " distribution" << endl;
+        RunSegmentTest<unsigned int, unsigned int>("SegSort-u32", resultDB,
+                op, numThreads, sizeMB, dists[d]);
+        RunSegmentTest<double, unsigned int>("SegSort-f64", resultDB, op,
+                numThreads, sizeMB, dists[d]);
+        RunTopKTest<unsigned int, unsigned int>("TopK-u32", resultDB, op,
+                numThreads, sizeMB, dists[d]);
+        RunTopKTest<double, unsigned int>("TopK-f64", resultDB, op,
+                numThreads, sizeMB, dists[d]);
+    }
+
+    // LSD versus MSD across sizes
+    for (int mb = 1; mb <= maxMB; mb *= 4)
+    {
+        RunTest<unsigned long long, unsigned int>("SortSweep-u64", resultDB,
+                op, numThreads, mb, false, dists[0]);
+        RunTest<unsigned long long, unsigned int>("SortSweepMSD-u64",
+                resultDB, op, numThreads, mb, true, dists[0]);
+    }
 }
 
-template <class T>
-void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
+// ****************************************************************************
+// Function: RunScalingTest
+//
+// Purpose:
+//   Sweeps the number of sort threads in powers of two up to maxThreads,
+//   reporting the latency of the sort barrier and the u32 sort throughput
+//   at each thread count
+//
+// Arguments:
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   maxThreads: largest thread count
+//   dist: key distribution
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+void RunScalingTest(ResultDatabase &resultDB, OptionParser &op,
+                    int maxThreads, string dist)
 {
+    int micdev = op.getOptionInt("target");
+    int iters = 1000;
     int probSizes[4] = { 1, 8, 48, 96 };
+    int sizeMB = probSizes[op.getOptionInt("size")-1];
+
+    if (maxThreads > MAX_WORKER)
+    {
+        maxThreads = MAX_WORKER;
+    }
+    for (int t = 1; ; t *= 2)
+    {
+        if (t > maxThreads)
+        {
+            t = maxThreads;
+        }
+        double latency = 0;
+        #pragma offload target(mic:micdev) in(t, iters) out(latency)
+        {
+            latency = barrierLatency(t, iters);
+        }
+
+        char atts[1024];
+        sprintf(atts, "%d threads", t);
+        cout << "Barrier latency with " << t << " threads: " << latency
+             << " us" << endl;
+        resultDB.AddResult("Sort_Barrier", atts, "us", latency);
 
-    int size = probSizes[op.getOptionInt("size")-1];
-    
-    // Convert to MiB
-    size = (size*1024*1024)/sizeof(T);
-    
-    // Create input data on CPU
-    unsigned int bytes = size * sizeof(T);
+        RunTest<unsigned int, unsigned int>("SortScaling-u32", resultDB, op,
+                                            t, sizeMB, false, dist);
+        if (t == maxThreads)
+        {
+            break;
+        }
+    }
+}
+
+template <class K, class V>
+void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op,
+             int numThreads, int sizeMB, bool msd, string dist)
+{
+    // Convert from MiB
+    int size = ((long)sizeMB*1024*1024)/sizeof(K);
 
     // Allocate Host Memory
-    __declspec(target(MIC)) static T *hkey, *outkey;
-    __declspec(target(MIC)) static T *hvalue, *outvalue;
+    __declspec(target(MIC)) static K *hkey, *outkey;
+    __declspec(target(MIC)) static V *hvalue, *outvalue;
+
+    hkey   = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    hvalue = (V*)_mm_malloc(size*sizeof(V),ALIGN);
 
-    hkey   = (T*)_mm_malloc(bytes,ALIGN);
-    hvalue = (T*)_mm_malloc(bytes,ALIGN);
+    outkey   = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    outvalue = (V*)_mm_malloc(size*sizeof(V),ALIGN);
 
-    outkey   = (T*)_mm_malloc(bytes,ALIGN);
-    outvalue = (T*)_mm_malloc(bytes,ALIGN);
 
+    // The sort uses its input arrays as scratch space, keep a copy of the
+    // keys for verification
+    K *refkey = (K*)_mm_malloc(size*sizeof(K),ALIGN);
 
-    // Initialize host memory
+    // Initialize host memory: keys of the requested distribution, the
+    // values are the original positions of the keys
     cout << "Initializing host memory." << endl;
 
-    srand(time(NULL));
-    for (int i = 0; i < size; i++)
+    if (!generateKeys<K>(refkey, size, dist, op, op.getOptionInt("seed")))
     {
-        hkey[i] = hvalue[i]= (i+255) % 1089; // Fill with some pattern
+        cerr << "Unknown key distribution: " << dist << endl;
+        _mm_free(hkey);
+        _mm_free(hvalue);
+        _mm_free(outkey);
+        _mm_free(outvalue);
+        _mm_free(refkey);
+        return;
     }
 
     int micdev = op.getOptionInt("target");
     int iters = op.getOptionInt("passes");
-    int numThreads = op.getOptionInt("nthreads");
+    int digitBits = op.getOptionInt("digit_bits");
+    int cacheKB = op.getOptionInt("cache_kb");
+    int info[3];
+    double stepTime[2];
 
     cout << "nthreads   = " <<numThreads<< endl;
 
@@ -152,11 +324,18 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
     for(int it=0;it<iters;it++)
     {
 
+        #pragma omp parallel for
+        for (int i = 0; i < size; i++)
+        {
+            hkey[i] = refkey[i];
+            hvalue[i] = i;
+        }
+
         // Allocating buffer on card
         #pragma offload target(mic:micdev) in(hkey:length(size)  free_if(0)) \
                 in(hvalue:length(size) free_if(0))\
-                out(outkey:length(size) free_if(0))\
-                out(outvalue:length(size) free_if(0))
+                nocopy(outkey:length(size) free_if(0))\
+                nocopy(outvalue:length(size) free_if(0))
         {
         }
 
@@ -175,9 +354,20 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
                 nocopy(hvalue:length(size) alloc_if(0) free_if(0))  \
                 nocopy(outkey:length(size) alloc_if(0) free_if(0))  \
                 nocopy(outvalue:length(size) alloc_if(0) free_if(0))\
-                in(numThreads)
+                in(numThreads, digitBits, cacheKB) out(info, stepTime)
         {
-            sortKernel<T>(hkey, hvalue, outkey, outvalue, size, numThreads);
+            if (msd)
+            {
+                msdSortKernel<K,V>(hkey, hvalue, outkey, outvalue, size,
+                                   numThreads, digitBits, cacheKB, info);
+            }
+            else
+            {
+                sortKernel<K,V>(hkey, hvalue, outkey, outvalue, size,
+                                numThreads, digitBits, cacheKB, info);
+            }
+            stepTime[0] = StepTime[0];
+            stepTime[1] = StepTime[1];
         }
         totalRunTime = curr_second()-start;
 
@@ -190,26 +380,631 @@ void RunTest(string testName, ResultDatabase &resultDB, OptionParser &op)
         }
 
         // If results aren't correct, don't report perf numbers
-        if (!verifyResult<T>(outkey, outvalue, size))
+        if (!verifyResult<K,V>(refkey, outkey, outvalue, size))
         {
-            return;
+            break;
         }
 
+        cout << info[0] << " bit digits, " << info[2] << " of " << info[1]
+             << " passes run" << endl;
+
         char atts[1024];
-        double avgTime = (totalRunTime / (double) iters);
-        sprintf(atts, "%d items", size);
-        double gb = (double)(size * sizeof(T)) / (1000. * 1000. * 1000.);
-        resultDB.AddResult(testName, atts, "GB/s", gb / avgTime);
+        sprintf(atts, "%d items %d threads %s", size, numThreads,
+                dist.c_str());
+        double gb = (double)size * (sizeof(K) + sizeof(V)) /
+                    (1000. * 1000. * 1000.);
+        resultDB.AddResult(testName, atts, "GB/s", gb / totalRunTime);
+        resultDB.AddResult(testName+"_Rate", atts, "MKeys/s",
+                size / totalRunTime / 1e6);
         resultDB.AddResult(testName+"_PCIe", atts, "GB/s",
-                gb / (avgTime + transferTime));
+                gb / (totalRunTime + transferTime));
         resultDB.AddResult(testName+"_Parity", atts, "N",
-                transferTime / avgTime);
+                transferTime / totalRunTime);
+        resultDB.AddResult(testName+"_Passes", atts, "N", info[2]);
+        if (!msd && info[2] > 0)
+        {
+            // Every pass histograms the keys; the scatter reads and writes
+            // the keys and values of the passes that are run
+            double histGB = (double)info[1] * size * sizeof(K) /
+                            (1000. * 1000. * 1000.);
+            double scatterGB = 2.0 * info[2] * gb;
+            resultDB.AddResult(testName+"_Histogram", atts, "GB/s",
+                    histGB / stepTime[0]);
+            resultDB.AddResult(testName+"_Scatter", atts, "GB/s",
+                    scatterGB / stepTime[1]);
+        }
+
+    }
+    // Clean up
+    _mm_free(refkey);
+    _mm_free(hkey);
+    _mm_free(hvalue);
+    _mm_free(outkey);
+    _mm_free(outvalue);
+
+}
+
+// ****************************************************************************
+// Function: RunSegmentTest
+//
+// Purpose:
+//   Times the segmented sort of segments with average lengths from the
+//   seg_lens option against a full sort of the same keys.  Segment lengths
+//   are drawn uniformly from 1 to twice the average.
+//
+// Arguments:
+//   testName: name of the test in the results
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   numThreads: number of sort threads
+//   sizeMB: size of the keys in MB
+//   dist: key distribution
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class K, class V>
+void RunSegmentTest(string testName, ResultDatabase &resultDB,
+                    OptionParser &op, int numThreads, int sizeMB,
+                    string dist)
+{
+    int size = ((long)sizeMB*1024*1024)/sizeof(K);
+    vector<long long> segLens = op.getOptionVecInt("seg_lens");
+
+    __declspec(target(MIC)) static K *hkey, *outkey;
+    __declspec(target(MIC)) static V *hvalue, *outvalue;
+    __declspec(target(MIC)) static unsigned int *offsets;
+
+    hkey     = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    hvalue   = (V*)_mm_malloc(size*sizeof(V),ALIGN);
+    outkey   = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    outvalue = (V*)_mm_malloc(size*sizeof(V),ALIGN);
+    offsets  = (unsigned int*)_mm_malloc((size+1)*sizeof(unsigned int),
+                                         ALIGN);
+    K *refkey = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+
+    cout << "Initializing host memory." << endl;
+    if (!generateKeys<K>(refkey, size, dist, op, op.getOptionInt("seed")))
+    {
+        cerr << "Unknown key distribution: " << dist << endl;
+        segLens.clear();
+    }
+
+    int micdev = op.getOptionInt("target");
+    int iters = op.getOptionInt("passes");
+    int digitBits = op.getOptionInt("digit_bits");
+    int cacheKB = op.getOptionInt("cache_kb");
+    int info[3];
+    long segInfo[3];
+
+    for (size_t l = 0; l < segLens.size(); l++)
+    {
+        // Segment boundaries
+        long avg = segLens[l] < 1 ? 1 : segLens[l];
+        int numSegments = 0;
+        offsets[0] = 0;
+        for (long off = 0; off < size; numSegments++)
+        {
+            off += 1 + sortHash(numSegments) % (2 * avg - 1);
+            offsets[numSegments+1] = off < size ? off : size;
+        }
 
+        for (int it = 0; it < iters; it++)
+        {
+            // Full sort of the same keys
+            #pragma omp parallel for
+            for (int i = 0; i < size; i++)
+            {
+                hkey[i] = refkey[i];
+                hvalue[i] = i;
+            }
+            #pragma offload target(mic:micdev) \
+                    in(hkey:length(size) free_if(0)) \
+                    in(hvalue:length(size) free_if(0)) \
+                    nocopy(outkey:length(size) free_if(0)) \
+                    nocopy(outvalue:length(size) free_if(0)) \
+                    in(offsets:length(numSegments+1) free_if(0))
+            {
+            }
+            double start = curr_second();
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(0))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outkey:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outvalue:length(size) alloc_if(0) free_if(0))\
+                    in(numThreads, digitBits, cacheKB) out(info)
+            {
+                sortKernel<K,V>(hkey, hvalue, outkey, outvalue, size,
+                                numThreads, digitBits, cacheKB, info);
+            }
+            double fullTime = curr_second() - start;
+
+            // Segmented sort, from the same input
+            #pragma omp parallel for
+            for (int i = 0; i < size; i++)
+            {
+                hkey[i] = refkey[i];
+                hvalue[i] = i;
+            }
+            #pragma offload target(mic:micdev) in(hkey:length(size) \
+                    alloc_if(0) free_if(0)) in(hvalue:length(size)  \
+                    alloc_if(0) free_if(0))
+            {
+            }
+            start = curr_second();
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(0))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outkey:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outvalue:length(size) alloc_if(0) free_if(0))\
+                    nocopy(offsets:length(numSegments+1) alloc_if(0)    \
+                    free_if(0)) in(numSegments, numThreads, cacheKB)    \
+                    out(segInfo)
+            {
+                segSortKernel<K,V>(hkey, hvalue, outkey, outvalue, size,
+                                   offsets, numSegments, numThreads, cacheKB,
+                                   segInfo);
+            }
+            double segTime = curr_second() - start;
+
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(1))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(1))  \
+                    out(outkey:length(size) alloc_if(0))                \
+                    out(outvalue:length(size) alloc_if(0))              \
+                    nocopy(offsets:length(numSegments+1) alloc_if(0))
+            {
+            }
+
+            if (!verifySegments<K,V>(refkey, outkey, outvalue, offsets,
+                                     numSegments))
+            {
+                break;
+            }
+            cout << numSegments << " segments: " << segInfo[0]
+                 << " by network, " << segInfo[1] << " serial, "
+                 << segInfo[2] << " parallel" << endl;
+
+            char atts[1024];
+            sprintf(atts, "%d items %d segments %d threads %s", size,
+                    numSegments, numThreads, dist.c_str());
+            resultDB.AddResult(testName, atts, "MSegments/s",
+                    numSegments / segTime / 1e6);
+            resultDB.AddResult(testName+"_Rate", atts, "MKeys/s",
+                    size / segTime / 1e6);
+            resultDB.AddResult(testName+"_Speedup", atts, "X",
+                    fullTime / segTime);
+        }
     }
+
     // Clean up
+    _mm_free(refkey);
     _mm_free(hkey);
     _mm_free(hvalue);
+    _mm_free(outkey);
+    _mm_free(outvalue);
+    _mm_free(offsets);
+}
+
+// ****************************************************************************
+// Function: RunTopKTest
+//
+// Purpose:
+//   Times the selection of the k smallest keys, for each k of the topk
+//   option, against a full sort of the same keys
+//
+// Arguments:
+//   testName: name of the test in the results
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   numThreads: number of sort threads
+//   sizeMB: size of the keys in MB
+//   dist: key distribution
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <class K, class V>
+void RunTopKTest(string testName, ResultDatabase &resultDB,
+                 OptionParser &op, int numThreads, int sizeMB, string dist)
+{
+    int size = ((long)sizeMB*1024*1024)/sizeof(K);
+    vector<long long> ks = op.getOptionVecInt("topk");
+
+    __declspec(target(MIC)) static K *hkey, *outkey;
+    __declspec(target(MIC)) static V *hvalue, *outvalue;
+
+    hkey     = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    hvalue   = (V*)_mm_malloc(size*sizeof(V),ALIGN);
+    outkey   = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+    outvalue = (V*)_mm_malloc(size*sizeof(V),ALIGN);
+    K *refkey = (K*)_mm_malloc(size*sizeof(K),ALIGN);
+
+    cout << "Initializing host memory." << endl;
+    if (!generateKeys<K>(refkey, size, dist, op, op.getOptionInt("seed")))
+    {
+        cerr << "Unknown key distribution: " << dist << endl;
+        ks.clear();
+    }
+
+    int micdev = op.getOptionInt("target");
+    int iters = op.getOptionInt("passes");
+    int digitBits = op.getOptionInt("digit_bits");
+    int cacheKB = op.getOptionInt("cache_kb");
+    int info[3];
+    long topInfo[3];
+
+    for (size_t j = 0; j < ks.size(); j++)
+    {
+        long k = ks[j] < 1 ? 1 : (ks[j] > size ? size : ks[j]);
+        for (int it = 0; it < iters; it++)
+        {
+            // Full sort of the same keys
+            #pragma omp parallel for
+            for (int i = 0; i < size; i++)
+            {
+                hkey[i] = refkey[i];
+                hvalue[i] = i;
+            }
+            #pragma offload target(mic:micdev) \
+                    in(hkey:length(size) free_if(0)) \
+                    in(hvalue:length(size) free_if(0)) \
+                    nocopy(outkey:length(size) free_if(0)) \
+                    nocopy(outvalue:length(size) free_if(0))
+            {
+            }
+            double start = curr_second();
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(0))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outkey:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outvalue:length(size) alloc_if(0) free_if(0))\
+                    in(numThreads, digitBits, cacheKB) out(info)
+            {
+                sortKernel<K,V>(hkey, hvalue, outkey, outvalue, size,
+                                numThreads, digitBits, cacheKB, info);
+            }
+            double fullTime = curr_second() - start;
+
+            // Top-k, from the same input
+            #pragma omp parallel for
+            for (int i = 0; i < size; i++)
+            {
+                hkey[i] = refkey[i];
+                hvalue[i] = i;
+            }
+            #pragma offload target(mic:micdev) in(hkey:length(size) \
+                    alloc_if(0) free_if(0)) in(hvalue:length(size)  \
+                    alloc_if(0) free_if(0))
+            {
+            }
+            start = curr_second();
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(0))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outkey:length(size) alloc_if(0) free_if(0))  \
+                    nocopy(outvalue:length(size) alloc_if(0) free_if(0))\
+                    in(k, numThreads, cacheKB) out(topInfo)
+            {
+                topKKernel<K,V>(hkey, hvalue, outkey, outvalue, size, k,
+                                numThreads, cacheKB, topInfo);
+            }
+            double topTime = curr_second() - start;
+
+            #pragma offload target(mic:micdev) nocopy(hkey:length(size) \
+                    alloc_if(0) free_if(1))                             \
+                    nocopy(hvalue:length(size) alloc_if(0) free_if(1))  \
+                    out(outkey:length(k) alloc_if(0))                   \
+                    out(outvalue:length(k) alloc_if(0))
+            {
+            }
+
+            if (!verifyTopK<K,V>(refkey, outkey, outvalue, size, k))
+            {
+                break;
+            }
+            cout << "k = " << k << ": " << topInfo[1] << " select steps, "
+                 << topInfo[2] << " candidates after the first" << endl;
+
+            char atts[1024];
+            sprintf(atts, "%d items k=%ld %d threads %s", size, k,
+                    numThreads, dist.c_str());
+            resultDB.AddResult(testName, atts, "MKeys/s",
+                    size / topTime / 1e6);
+            resultDB.AddResult(testName+"_Speedup", atts, "X",
+                    fullTime / topTime);
+        }
+    }
+
+    // Clean up
+    _mm_free(refkey);
+    _mm_free(hkey);
+    _mm_free(hvalue);
+    _mm_free(outkey);
+    _mm_free(outvalue);
+}
 
+// ****************************************************************************
+// Function: RunExternalTest
+//
+// Purpose:
+//   Out-of-core sort of the u64 keys of a file.  The file is mapped and
+//   streamed in runs of run_mb MB; each run is sorted on the card and
+//   appended to a run file with asynchronous writes, overlapping the write
+//   of a run with the read and sort of the next.  The runs are then merged
+//   with a loser tree, reading each run in blocks of merge_kb KB, into the
+//   output file.  An existing input file is sorted as it is; only a
+//   missing one is created, with ext_mb MB of keys of the requested
+//   distribution generated one run at a time.
+//
+// Arguments:
+//   resultDB: results from the benchmark are stored in this db
+//   op: the options parser / parameter database
+//   numThreads: number of sort threads
+//   dist: key distribution of a generated input file
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+void RunExternalTest(ResultDatabase &resultDB, OptionParser &op,
+                     int numThreads, string dist)
+{
+    typedef unsigned long long K;
+    typedef unsigned int V;
+
+    string inName = op.getOptionString("ext_file");
+    string runName = inName + ".runs";
+    string outName = inName + ".sorted";
+    long extMB = op.getOptionInt("ext_mb");
+    long runKeys = ((long)op.getOptionInt("run_mb")*1024*1024)/sizeof(K);
+    size_t mergeKeys = ((size_t)op.getOptionInt("merge_kb")*1024)/sizeof(K);
+    int micdev = op.getOptionInt("target");
+    int digitBits = op.getOptionInt("digit_bits");
+    int cacheKB = op.getOptionInt("cache_kb");
+    int info[3];
+
+    if (runKeys <= 0 || mergeKeys == 0)
+    {
+        cerr << "Error: run_mb and merge_kb must be positive" << endl;
+        return;
+    }
+
+    __declspec(target(MIC)) static K *hkey, *outkey;
+    __declspec(target(MIC)) static V *hvalue, *outvalue;
+
+    hkey     = (K*)_mm_malloc(runKeys*sizeof(K),ALIGN);
+    hvalue   = (V*)_mm_malloc(runKeys*sizeof(V),ALIGN);
+    outkey   = (K*)_mm_malloc(runKeys*sizeof(K),ALIGN);
+    outvalue = (V*)_mm_malloc(runKeys*sizeof(V),ALIGN);
+
+    // Create the input file only if there is none, never overwriting data
+    struct stat st;
+    if (stat(inName.c_str(), &st) != 0)
+    {
+        cout << "Writing " << extMB << " MB of " << dist << " keys to "
+             << inName << endl;
+        int fd = open(inName.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        long total = extMB*1024*1024/sizeof(K);
+        bool ok = fd >= 0;
+        for (long first = 0; ok && first < total; first += runKeys)
+        {
+            long n = min(runKeys, total - first);
+            ok = generateKeys<K>(hkey, n, dist, op,
+                                 op.getOptionInt("seed") + first) &&
+                 write(fd, hkey, n*sizeof(K)) == (ssize_t)(n*sizeof(K));
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (!ok || stat(inName.c_str(), &st) != 0)
+        {
+            cerr << "Error: unable to write " << inName << endl;
+            _mm_free(hkey);
+            _mm_free(hvalue);
+            _mm_free(outkey);
+            _mm_free(outvalue);
+            return;
+        }
+    }
+
+    long size = st.st_size / sizeof(K);
+    int inFd  = open(inName.c_str(), O_RDONLY);
+    int runFd = open(runName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int outFd = open(outName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    K *in = size ? (K*)mmap(NULL, size*sizeof(K), PROT_READ, MAP_SHARED,
+                            inFd, 0) : NULL;
+    bool ok = size > 0 && inFd >= 0 && runFd >= 0 && outFd >= 0 &&
+              in != MAP_FAILED;
+    if (!ok)
+    {
+        cerr << "Error: unable to open " << inName << " or its run and "
+             << "output files" << endl;
+    }
+    else
+    {
+        madvise(in, size*sizeof(K), MADV_SEQUENTIAL);
+    }
+
+    // Allocate the run buffers on the card; ok changes below
+    const bool allocated = ok;
+    #pragma offload target(mic:micdev) if(allocated)    \
+            nocopy(hkey:length(runKeys) free_if(0))     \
+            nocopy(hvalue:length(runKeys) free_if(0))   \
+            nocopy(outkey:length(runKeys) free_if(0))   \
+            nocopy(outvalue:length(runKeys) free_if(0))
+    {
+    }
+
+    // Phase 1: sorted runs.  The sorted run stays on the card until the
+    // write of the previous run has completed
+    int numRuns = (size + runKeys - 1) / runKeys;
+    double readTime = 0, sortTime = 0, outTime = 0;
+    K sum = 0, bits = 0;
+    AsyncWriter runWriter(runFd);
+    double start = curr_second();
+    for (int r = 0; ok && r < numRuns; r++)
+    {
+        long first = (long)r * runKeys;
+        long n = min(runKeys, size - first);
+
+        double t = curr_second();
+        K s = 0, x = 0;
+        #pragma omp parallel for reduction(+:s) reduction(^:x)
+        for (long i = 0; i < n; i++)
+        {
+            K k = in[first + i];
+            hkey[i] = k;
+            s += k;
+            x ^= k;
+        }
+        sum += s;
+        bits ^= x;
+        madvise(in + first, n*sizeof(K), MADV_DONTNEED);
+        readTime += curr_second() - t;
+
+        t = curr_second();
+        #pragma offload target(mic:micdev)                          \
+                in(hkey:length(n) alloc_if(0) free_if(0))           \
+                nocopy(hvalue:length(n) alloc_if(0) free_if(0))     \
+                nocopy(outkey:length(n) alloc_if(0) free_if(0))     \
+                nocopy(outvalue:length(n) alloc_if(0) free_if(0))   \
+                in(numThreads, digitBits, cacheKB) out(info)
+        {
+            // The values are not written out, they are the positions of
+            // the keys in the run
+            #pragma omp parallel for
+            for (long i = 0; i < n; i++)
+            {
+                hvalue[i] = i;
+            }
+            sortKernel<K,V>(hkey, hvalue, outkey, outvalue, n,
+                            numThreads, digitBits, cacheKB, info);
+        }
+        sortTime += curr_second() - t;
+
+        ok = runWriter.wait();
+        t = curr_second();
+        #pragma offload target(mic:micdev) \
+                out(outkey:length(n) alloc_if(0) free_if(0))
+        {
+        }
+        outTime += curr_second() - t;
+        ok = ok && runWriter.start(outkey, n*sizeof(K));
+    }
+    ok = ok && runWriter.wait();
+    double runTime = curr_second() - start;
+
+    #pragma offload target(mic:micdev) if(allocated)            \
+            nocopy(hkey:length(runKeys) alloc_if(0) free_if(1))     \
+            nocopy(hvalue:length(runKeys) alloc_if(0) free_if(1))   \
+            nocopy(outkey:length(runKeys) alloc_if(0) free_if(1))   \
+            nocopy(outvalue:length(runKeys) alloc_if(0) free_if(1))
+    {
+    }
+
+    // Phase 2: k-way merge.  Each run reads through its own block, the
+    // output is double buffered in the host run buffers
+    double mergeTime = 0;
+    double mergeWait = 0;
+    if (ok)
+    {
+        start = curr_second();
+        K *runBuf = (K*)_mm_malloc(numRuns*mergeKeys*sizeof(K),ALIGN);
+        vector< RunReader<K> > runs(numRuns);
+        for (int r = 0; ok && r < numRuns; r++)
+        {
+            off_t first = (off_t)r * runKeys * sizeof(K);
+            off_t last = min((off_t)(r + 1) * runKeys, (off_t)size) *
+                         sizeof(K);
+            ok = runs[r].open(runFd, first, last, runBuf + r*mergeKeys,
+                              mergeKeys);
+        }
+
+        AsyncWriter outWriter(outFd);
+        K *outBuf[2] = { hkey, outkey };
+        int cur = 0;
+        long pos = 0;
+        LoserTree<K> tree(&runs[0], numRuns);
+        while (ok && !tree.done())
+        {
+            outBuf[cur][pos++] = tree.top();
+            ok = tree.pop();
+            if (pos == runKeys || tree.done())
+            {
+                ok = ok && outWriter.start(outBuf[cur], pos*sizeof(K));
+                cur ^= 1;
+                pos = 0;
+            }
+        }
+        ok = ok && outWriter.wait() && outWriter.bytes() == size*sizeof(K);
+        mergeTime = curr_second() - start;
+        mergeWait = outWriter.waitTime;
+        _mm_free(runBuf);
+    }
+    if (!ok)
+    {
+        cerr << "Error: external sort I/O failed" << endl;
+    }
+
+    // Verify that the output is sorted and holds the same keys
+    K *out = NULL;
+    if (ok)
+    {
+        out = (K*)mmap(NULL, size*sizeof(K), PROT_READ, MAP_SHARED, outFd,
+                       0);
+        ok = out != MAP_FAILED;
+    }
+    if (ok)
+    {
+        long unsorted = 0;
+        K s = 0, x = 0;
+        #pragma omp parallel for reduction(+:s,unsorted) reduction(^:x)
+        for (long i = 0; i < size; i++)
+        {
+            s += out[i];
+            x ^= out[i];
+            unsorted += i > 0 && out[i] < out[i-1];
+        }
+        munmap(out, size*sizeof(K));
+        ok = unsorted == 0 && s == sum && x == bits;
+        cout << "Test " << (ok ? "Passed" : "Failed") << endl;
+    }
+
+    if (ok)
+    {
+        char atts[1024];
+        sprintf(atts, "%ld items %d runs %d threads %s", size, numRuns,
+                numThreads, dist.c_str());
+        double gb = (double)size * sizeof(K) / (1000. * 1000. * 1000.);
+        double total = runTime + mergeTime;
+        resultDB.AddResult("ExtSort-u64", atts, "GB/s", gb / total);
+        resultDB.AddResult("ExtSort-u64_Runs", atts, "GB/s", gb / runTime);
+        resultDB.AddResult("ExtSort-u64_Merge", atts, "GB/s",
+                           gb / mergeTime);
+        resultDB.AddResult("ExtSort-u64_ReadTime", atts, "s", readTime);
+        resultDB.AddResult("ExtSort-u64_SortTime", atts, "s", sortTime);
+        resultDB.AddResult("ExtSort-u64_PCIeTime", atts, "s", outTime);
+        resultDB.AddResult("ExtSort-u64_WriteWait", atts, "s",
+                           runWriter.waitTime + mergeWait);
+        resultDB.AddResult("ExtSort-u64_MergeTime", atts, "s",
+                           mergeTime - mergeWait);
+    }
+
+    // Clean up
+    if (in != NULL && in != MAP_FAILED)
+    {
+        munmap(in, size*sizeof(K));
+    }
+    if (inFd >= 0) close(inFd);
+    if (runFd >= 0) close(runFd);
+    if (outFd >= 0) close(outFd);
+    unlink(runName.c_str());
+    unlink(outName.c_str());
+    _mm_free(hkey);
+    _mm_free(hvalue);
+    _mm_free(outkey);
+    _mm_free(outvalue);
 }
 
 template <class T>
@@ -310,17 +1105,131 @@ __declspec(target(MIC)) void  scanArray(T *input,  T* output, const size_t n)
     free(ipblocksum);
 }
 
-template <class T>
-bool verifyResult(T *key,  T* val, const size_t size)
+// ****************************************************************************
+// Function: verifyResult
+//
+// Purpose:
+//   Checks that the keys are sorted, that the values are a permutation of
+//   the original positions that carries each key along, and that equal
+//   keys kept their original order (the radix sort is stable)
+//
+// Arguments:
+//   inkey: the unsorted keys
+//   key, val: the sorted keys and values
+//   size: number of elements
+//
+// Returns:  true if the sort is correct
+//
+// ****************************************************************************
+template <class K, class V>
+bool verifyResult(K *inkey, K *key, V *val, const size_t size)
 {
     bool passed = true;
+    vector<bool> seen(size, false);
 
-    for (unsigned int i = 0; i < size-1; ++i)
+    for (size_t i = 0; i < size && passed; ++i)
     {
-        if ((key[i]) > (key[i+1]))
+        if (val[i] >= size || seen[val[i]] || inkey[val[i]] != key[i])
         {
             passed = false;
         }
+        else if (i > 0 && (key[i-1] > key[i] ||
+                 (key[i-1] == key[i] && val[i-1] > val[i])))
+        {
+            passed = false;
+        }
+        else
+        {
+            seen[val[i]] = true;
+        }
+    }
+    cout << "Test ";
+    if (passed)
+        cout << "Passed" << endl;
+    else
+        cout << "---FAILED---" << endl;
+    return passed;
+}
+
+// ****************************************************************************
+// Function: verifySegments
+//
+// Purpose:
+//   Checks that every segment is sorted, stable and a permutation of its
+//   input, as verifyResult does for the whole array
+//
+// Returns:  true if the segmented sort is correct
+//
+// ****************************************************************************
+template <class K, class V>
+bool verifySegments(K *inkey, K *key, V *val, const unsigned int *offsets,
+                    int numSegments)
+{
+    bool passed = true;
+    vector<bool> seen(offsets[numSegments], false);
+
+    for (int s = 0; s < numSegments && passed; s++)
+    {
+        for (size_t i = offsets[s]; i < offsets[s+1] && passed; ++i)
+        {
+            if (val[i] < offsets[s] || val[i] >= offsets[s+1] ||
+                seen[val[i]] || inkey[val[i]] != key[i])
+            {
+                passed = false;
+            }
+            else if (i > offsets[s] && (key[i-1] > key[i] ||
+                     (key[i-1] == key[i] && val[i-1] > val[i])))
+            {
+                passed = false;
+            }
+            else
+            {
+                seen[val[i]] = true;
+            }
+        }
+    }
+    cout << "Test ";
+    if (passed)
+        cout << "Passed" << endl;
+    else
+        cout << "---FAILED---" << endl;
+    return passed;
+}
+
+// ****************************************************************************
+// Function: verifyTopK
+//
+// Purpose:
+//   Checks the k smallest pairs against a stable partial sort of the input
+//
+// Returns:  true if the top-k selection is correct
+//
+// ****************************************************************************
+template <class K>
+struct KeyIndexLess
+{
+    const K *key;
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        return key[a] < key[b] || (key[a] == key[b] && a < b);
+    }
+};
+
+template <class K, class V>
+bool verifyTopK(K *inkey, K *key, V *val, const size_t size, long k)
+{
+    vector<unsigned int> ref(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        ref[i] = i;
+    }
+    KeyIndexLess<K> less = { inkey };
+    partial_sort(ref.begin(), ref.begin() + k, ref.end(), less);
+
+    bool passed = true;
+    for (long i = 0; i < k && passed; i++)
+    {
+        passed = key[i] == inkey[ref[i]] && val[i] == ref[i];
     }
     cout << "Test ";
     if (passed)
@@ -43,14 +43,33 @@ void rearrange(T**,T**,T**,T**,T**,const size_t);
 template <class T> __declspec(target(mic))
 void scanArray(T* , T* , const size_t);
 
-template <class T> __declspec(target(mic))
-extern void sortKernel(T* , T* , T*, T*, const size_t);
+template <class K, class V> __declspec(target(mic))
+extern void sortKernel(K* , V* , K*, V*, const size_t, int, int, int, int*);
+
+template <class K, class V>
+bool verifyResult(K* , K* , V*, const size_t );
+
+template <class K, class V>
+void RunTest(string , ResultDatabase &, OptionParser &, int, int, bool,
+             string);
+
+template <class K, class V>
+void RunSegmentTest(string , ResultDatabase &, OptionParser &, int, int,
+                    string);
+
+template <class K, class V>
+void RunTopKTest(string , ResultDatabase &, OptionParser &, int, int,
+                 string);
+
+template <class K, class V>
+bool verifySegments(K* , K* , V*, const unsigned int *, int);
+
+template <class K, class V>
+bool verifyTopK(K* , K* , V*, const size_t, long);
 
-template <class T>
-bool verifyResult(T* , T*, const size_t );
+void RunScalingTest(ResultDatabase &, OptionParser &, int, string);
 
-template <class T>
-void RunTest(string , ResultDatabase &, OptionParser &);
+void RunExternalTest(ResultDatabase &, OptionParser &, int, string);
 
 #define BITS 32
 
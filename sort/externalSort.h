@@ -0,0 +1,192 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: externalSort.h
+//
+// Purpose:
+//   Host side I/O for the out-of-core sort: a buffered reader for the
+//   sorted runs and a loser tree for the k-way merge of the runs.  Runs
+//   and output are written with AsyncWriter.
+//
+// ****************************************************************************
+
+#ifndef EXTERNAL_SORT_H_
+#define EXTERNAL_SORT_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <vector>
+#include "AsyncWriter.h"
+#include "Timer.h"
+
+// ****************************************************************************
+// Class: RunReader
+//
+// Purpose:
+//   Reads one sorted run of a file sequentially, in blocks of bufKeys keys
+//
+// ****************************************************************************
+template <class K>
+class RunReader
+{
+  public:
+    RunReader() : fd(-1), next(0), end(0), pos(0), len(0) {}
+
+    bool open(int file, off_t first, off_t last, K *buffer, size_t bufKeys)
+    {
+        fd = file;
+        next = first;
+        end = last;
+        buf = buffer;
+        size = bufKeys;
+        pos = len = 0;
+        return fill();
+    }
+
+    bool done() const { return pos == len; }
+    K head() const { return buf[pos]; }
+
+    bool pop()
+    {
+        if (++pos < len)
+        {
+            return true;
+        }
+        return fill();
+    }
+
+  private:
+    bool fill()
+    {
+        pos = len = 0;
+        if (next >= end)
+        {
+            return true;
+        }
+        size_t bytes = end - next;
+        if (bytes > size * sizeof(K))
+        {
+            bytes = size * sizeof(K);
+        }
+        size_t got = 0;
+        while (got < bytes)
+        {
+            ssize_t n = pread(fd, (char*)buf + got, bytes - got, next + got);
+            if (n <= 0)
+            {
+                return false;
+            }
+            got += n;
+        }
+        next += bytes;
+        len = bytes / sizeof(K);
+        return true;
+    }
+
+    int fd;
+    off_t next, end;
+    K *buf;
+    size_t size, pos, len;
+};
+
+// ****************************************************************************
+// Class: LoserTree
+//
+// Purpose:
+//   Tournament tree over k runs.  Node 0 holds the run with the smallest
+//   head, nodes 1..k-1 the loser of the match played at that node, and
+//   run i plays from leaf k+i.  Replacing the winner replays only the
+//   log2(k) matches on its path to the root.  Ties go to the lower run.
+//
+// ****************************************************************************
+template <class K>
+class LoserTree
+{
+  public:
+    LoserTree(RunReader<K> *runs, int k) : runs(runs), k(k), tree(k)
+    {
+        std::vector<int> win(2 * k);
+        for (int i = 0; i < k; i++)
+        {
+            win[k + i] = i;
+        }
+        for (int n = k - 1; n > 0; n--)
+        {
+            int l = win[2 * n], r = win[2 * n + 1];
+            win[n]  = beats(l, r) ? l : r;
+            tree[n] = beats(l, r) ? r : l;
+        }
+        tree[0] = k > 1 ? win[1] : 0;
+    }
+
+    bool done() const { return runs[tree[0]].done(); }
+    K top() const { return runs[tree[0]].head(); }
+
+    // Advances the winning run and finds the new winner
+    bool pop()
+    {
+        int w = tree[0];
+        if (!runs[w].pop())
+        {
+            return false;
+        }
+        for (int n = (w + k) / 2; n > 0; n /= 2)
+        {
+            if (beats(tree[n], w))
+            {
+                std::swap(tree[n], w);
+            }
+        }
+        tree[0] = w;
+        return true;
+    }
+
+  private:
+    bool beats(int a, int b) const
+    {
+        if (runs[a].done()) return false;
+        if (runs[b].done()) return true;
+        return runs[a].head() < runs[b].head() ||
+               (!(runs[b].head() < runs[a].head()) && a < b);
+    }
+
+    RunReader<K> *runs;
+    int k;
+    std::vector<int> tree;
+};
+
+#endif // EXTERNAL_SORT_H_
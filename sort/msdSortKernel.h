@@ -0,0 +1,406 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: msdSortKernel.h
+//
+// Purpose:
+//   MSD radix / LSD hybrid sort.  One partition pass on the most
+//   significant varying bits splits the keys into buckets of about a
+//   thread's cache size; the buckets are then sorted independently with an
+//   in-cache LSD radix sort, so the whole array is swept about twice
+//   instead of once per LSD pass.  Buckets that come out much larger than
+//   the others (skewed keys) are sorted by all threads with the LSD
+//   kernel.  Uses the pool, barrier and radix steps of sortKernel.h.
+//
+// ****************************************************************************
+
+#ifndef MSD_SORT_KERNEL_H_
+#define MSD_SORT_KERNEL_H_
+
+#pragma offload_attribute(push,target(mic))
+
+#include "sortKernel.h"
+
+// Widest partition digit, and the bucket size below which buckets are
+// sorted by insertion
+#define MSD_MAX_BITS        12
+#define MSD_INSERTION_MAX   32
+
+// ****************************************************************************
+// Struct: MsdSort
+//
+// Purpose:
+//   State shared by the MSD sort threads
+//
+// ****************************************************************************
+template <class K, class V>
+struct MsdSort
+{
+    RadixSort<K,V> part;        // partition pass over the whole array
+    RadixSort<K,V> sub;         // cooperative sort of one large bucket
+    int shift;                  // lowest bit of the partition digit
+    int buckets;
+    unsigned int *bucketStart;  // buckets+1 offsets
+    long bucketElements;        // bucket size that fits the cache budget
+    long largeBucket;           // buckets above this are sorted by all
+    volatile int next;          // next small bucket to sort
+};
+
+// ****************************************************************************
+// Function: localRadixSort
+//
+// Purpose:
+//   Sorts n elements on bits low..high with a serial LSD radix sort of 8
+//   bit digits, using Q/Qv as scratch.  Digits that are the same for all
+//   keys are skipped.  The result is left in P/Pv.
+//
+// ****************************************************************************
+template <class Bits, class V>
+__declspec(target(mic))
+void localRadixSort(Bits *P, V *Pv, Bits *Q, V *Qv, long n, int low,
+                    int high)
+{
+    if (n <= MSD_INSERTION_MAX)
+    {
+        for (long i = 1; i < n; i++)
+        {
+            Bits k = P[i];
+            V v = Pv[i];
+            long j = i - 1;
+            for (; j >= 0 && P[j] > k; j--)
+            {
+                P[j+1] = P[j];
+                Pv[j+1] = Pv[j];
+            }
+            P[j+1] = k;
+            Pv[j+1] = v;
+        }
+        return;
+    }
+
+    unsigned int count[256];
+    Bits *src = P, *dst = Q;
+    V *vsrc = Pv, *vdst = Qv;
+    for (int shift = low; shift <= high; shift += 8)
+    {
+        memset(count, 0, sizeof(count));
+        for (long i = 0; i < n; i++)
+        {
+            count[(unsigned int)(src[i] >> shift) & 255]++;
+        }
+        unsigned int sum = 0;
+        bool constant = false;
+        for (int b = 0; b < 256; b++)
+        {
+            unsigned int c = count[b];
+            constant |= (c == n);
+            count[b] = sum;
+            sum += c;
+        }
+        if (constant)
+        {
+            continue;
+        }
+        for (long i = 0; i < n; i++)
+        {
+            unsigned int cnt = count[(unsigned int)(src[i] >> shift) & 255]++;
+            dst[cnt] = src[i];
+            vdst[cnt] = vsrc[i];
+        }
+        Bits *t = src; src = dst; dst = t;
+        V *vt = vsrc; vsrc = vdst; vdst = vt;
+    }
+    if (src != P)
+    {
+        memcpy(P, src, n*sizeof(Bits));
+        memcpy(Pv, vsrc, n*sizeof(V));
+    }
+}
+
+// ****************************************************************************
+// Function: chooseBuckets
+//
+// Purpose:
+//   Picks the partition digit: enough buckets that an average bucket and
+//   its scratch space fit in the per-thread cache budget, and at least
+//   four buckets per thread for load balance, up to MSD_MAX_BITS bits
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void chooseBuckets(MsdSort<K,V> &m)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    const int BUF = RadixSort<K,V>::BUF;
+    RadixSort<K,V> &s = m.part;
+    long elemBytes = sizeof(Bits) + sizeof(V);
+    int width = s.high - s.low + 1;
+
+    m.bucketElements = s.cacheBytes / (2 * elemBytes);
+    long buckets = s.numElements / m.bucketElements;
+    if (buckets < 4L * Thread)
+    {
+        buckets = 4L * Thread;
+    }
+    int bits = 0;
+    while ((1L << bits) < buckets && bits < MSD_MAX_BITS && bits < width)
+    {
+        bits++;
+    }
+
+    s.bits = bits;
+    s.bins = 1 << bits;
+    s.passes = (s.high < 0) ? 0 : 1;
+    s.buffered = s.bins * (3*sizeof(unsigned int) + BUF * elemBytes) <=
+                 s.cacheBytes;
+    m.shift = s.high + 1 - bits;
+    m.largeBucket = 4 * s.numElements / s.bins;
+    if (m.largeBucket < m.bucketElements)
+    {
+        m.largeBucket = m.bucketElements;
+    }
+}
+
+// ****************************************************************************
+// Function: cooperativeSort
+//
+// Purpose:
+//   Sorts one bucket on bits low..high with the parallel LSD kernel on all
+//   threads, leaving the result in P/Pv
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void cooperativeSort(MsdSort<K,V> &m, long id,
+                     typename RadixKey<K>::Bits *P, V *Pv,
+                     typename RadixKey<K>::Bits *Q, V *Qv,
+                     long n, int low, int high)
+{
+    RadixSort<K,V> &c = m.sub;
+    if (id == 0)
+    {
+        c.keys[0] = P;
+        c.keys[1] = Q;
+        c.values[0] = Pv;
+        c.values[1] = Qv;
+        c.numElements = n;
+        c.elementsPerTask = (((n + Thread - 1) / Thread) + 63) & ~63;
+        c.forceBits = m.part.forceBits;
+        c.cacheBytes = m.part.cacheBytes;
+        c.Sums = m.part.Sums;
+        c.Masks = m.part.Masks;
+        c.low = low;
+        c.high = high;
+        chooseDigits(c, high - low + 1);
+        // the bucket is not cache line aligned, so the scatter cannot
+        // write whole buffered lines
+        c.buffered = 0;
+        radixAlloc(c);
+    }
+    _BARRIER_;
+
+    long start = id * c.elementsPerTask;
+    long end = start + c.elementsPerTask;
+    if (start > n) start = n;
+    if (end > n) end = n;
+    if (radixPasses(c, id, start, end) == 1)
+    {
+        memcpy(P + start, Q + start, (end - start)*sizeof(*P));
+        memcpy(Pv + start, Qv + start, (end - start)*sizeof(V));
+    }
+    _BARRIER_;
+    if (id == 0)
+    {
+        radixFree(c);
+    }
+}
+
+template <class K, class V>
+__declspec(target(mic))
+void msdSortThread(void *arg, long id)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    MsdSort<K,V> &m = *(MsdSort<K,V> *)arg;
+    RadixSort<K,V> &s = m.part;
+
+    long start = id * s.elementsPerTask;
+    long end = start + s.elementsPerTask;
+    if (start > s.numElements) start = s.numElements;
+    if (end > s.numElements) end = s.numElements;
+    long half = (end - start) >> 1;
+
+    radixPrepare(s, id, start, end);
+    if (id == 0)
+    {
+        chooseBuckets(m);
+        radixAlloc(s);
+        m.bucketStart = (unsigned int *)my_malloc((s.bins + 1)*
+                sizeof(unsigned int));
+        m.next = 0;
+    }
+    _BARRIER_;
+
+    // Partition pass on the top s.bits varying bits
+    int src = 0;
+    if (s.passes)
+    {
+        Bits *X = s.keys[0], *Y = s.keys[1];
+        V *Z = s.values[0], *W = s.values[1];
+        unsigned int *Local_Hist = s.Hist + 2*s.bins*id;
+
+        Step1_Histogram(s, id, m.shift, X);
+        Step2_Offsets(s, id, 0);
+        if (s.skip != 1)
+        {
+            if (id == 0)
+            {
+                // thread 0's first offsets are the bucket starts
+                memcpy(m.bucketStart, s.Hist, s.bins*sizeof(unsigned int));
+                m.bucketStart[s.bins] = s.numElements;
+                m.buckets = s.bins;
+                s.passesRun = 1;
+            }
+            Step3_Scatter(s, id, m.shift, X + start, Z + start, half,
+                          Local_Hist, Y, W);
+            Step3_Scatter(s, id, m.shift, X + start + half, Z + start + half,
+                          end - start - half, Local_Hist + s.bins, Y, W);
+            src = 1;
+        }
+    }
+    int high = m.shift - 1;
+    if (src == 0 && id == 0)
+    {
+        // all keys are in one bucket
+        m.bucketStart[0] = 0;
+        m.bucketStart[1] = s.numElements;
+        m.buckets = 1;
+    }
+    if (src == 0)
+    {
+        high = s.high;
+    }
+    _BARRIER_;
+
+    Bits *P = s.keys[src], *Q = s.keys[1-src];
+    V *Pv = s.values[src], *Qv = s.values[1-src];
+
+    // Large buckets, in order, by all threads
+    for (int b = 0; b < m.buckets && high >= s.low; b++)
+    {
+        long off = m.bucketStart[b];
+        long n = m.bucketStart[b+1] - off;
+        if (n > m.largeBucket)
+        {
+            cooperativeSort(m, id, P + off, Pv + off, Q + off, Qv + off, n,
+                            s.low, high);
+        }
+    }
+
+    // Small buckets, one per thread, dynamically scheduled
+    for (;;)
+    {
+        int b = __sync_fetch_and_add(&m.next, 1);
+        if (b >= m.buckets || high < s.low)
+        {
+            break;
+        }
+        long off = m.bucketStart[b];
+        long n = m.bucketStart[b+1] - off;
+        if (n <= m.largeBucket)
+        {
+            localRadixSort(P + off, Pv + off, Q + off, Qv + off, n, s.low,
+                           high);
+        }
+    }
+    _BARRIER_;
+
+    // The sorted elements go to the output arrays
+    radixFinish(s, src, start, end);
+}
+
+// ****************************************************************************
+// Function: msdSortKernel
+//
+// Purpose:
+//   Sorts key-value pairs by key with the MSD hybrid.  Arguments as for
+//   sortKernel; info returns the partition digit width, 1 and the number
+//   of partition passes run.
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void msdSortKernel(K* hkey, V* hvalue, K* outkey, V* outvalue,
+        const size_t N, int numThreads, int digitBits, int cacheKB, int *info)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    MsdSort<K,V> m;
+    RadixSort<K,V> &s = m.part;
+
+    if (numThreads > MAX_WORKER)
+    {
+        printf("numthreads > Max Workers\n");
+        return;
+    }
+    Thread = numThreads;
+    s.elementsPerTask = (((N + Thread - 1) / Thread) + 63) & ~63;
+    s.numElements = N;
+    s.forceBits = digitBits;
+    s.cacheBytes = cacheKB * 1024L;
+
+    s.keys[0] = (Bits *)hkey;
+    s.keys[1] = (Bits *)outkey;
+    s.values[0] = hvalue;
+    s.values[1] = outvalue;
+    s.Sums = (unsigned int *)my_malloc(Thread*sizeof(unsigned int));
+    s.Masks = (Bits *)my_malloc(Thread*sizeof(Bits));
+
+    runPool(Thread, msdSortThread<K,V>, &m);
+
+    if (info)
+    {
+        info[0] = s.bits;
+        info[1] = 1;
+        info[2] = s.passesRun;
+    }
+
+    radixFree(s);
+    _mm_free(m.bucketStart);
+    _mm_free(s.Sums);
+    _mm_free(s.Masks);
+}
+
+#pragma offload_attribute(pop)
+
+#endif // MSD_SORT_KERNEL_H_
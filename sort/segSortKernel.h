@@ -0,0 +1,292 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: segSortKernel.h
+//
+// Purpose:
+//   Segmented sort: sorts each of many independent segments of an array,
+//   given by their offsets.  Segments are handled by size: short ones by a
+//   branchless bitonic sorting network, medium ones by the serial LSD sort
+//   of the MSD kernel, one segment per thread, and long ones by all
+//   threads with the parallel LSD kernel.  The sort is stable.
+//
+// ****************************************************************************
+
+#ifndef SEG_SORT_KERNEL_H_
+#define SEG_SORT_KERNEL_H_
+
+#pragma offload_attribute(push,target(mic))
+
+#include "msdSortKernel.h"
+
+// Longest segment sorted by the network; must be a power of two
+#define SEG_NETWORK_MAX     16
+
+// Segments handed to a thread at a time
+#define SEG_BATCH           64
+
+// ****************************************************************************
+// Struct: SegSort
+//
+// Purpose:
+//   State shared by the segmented sort threads
+//
+// ****************************************************************************
+template <class K, class V>
+struct SegSort
+{
+    MsdSort<K,V> m;             // m.part: whole array, m.sub: long segments
+    const unsigned int *offsets;// numSegments+1 segment starts
+    int numSegments;
+    long largeSegment;          // segments above this are sorted by all
+    volatile int next;          // next batch of segments
+    volatile long counts[3];    // network, serial and parallel segments
+};
+
+// ****************************************************************************
+// Function: networkSort
+//
+// Purpose:
+//   Sorts n <= SEG_NETWORK_MAX elements with a bitonic network over the
+//   next power of two, padding with the largest key.  Keys are compared
+//   together with their position so the network is stable and the padding
+//   goes last.  Every stage is a loop of independent compare-exchanges
+//   without branches, which vectorizes.
+//
+// ****************************************************************************
+template <class Bits, class V>
+__declspec(target(mic))
+void networkSort(Bits *P, V *Pv, int n)
+{
+    Bits k[SEG_NETWORK_MAX];
+    unsigned int p[SEG_NETWORK_MAX];
+    V v[SEG_NETWORK_MAX];
+
+    int m = 2;
+    while (m < n)
+    {
+        m *= 2;
+    }
+    for (int i = 0; i < m; i++)
+    {
+        k[i] = i < n ? P[i] : ~(Bits)0;
+        p[i] = i;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        v[i] = Pv[i];
+    }
+
+    for (int size = 2; size <= m; size *= 2)
+    {
+        for (int stride = size / 2; stride > 0; stride /= 2)
+        {
+            #pragma simd
+            for (int c = 0; c < m / 2; c++)
+            {
+                int lo = (c / stride) * 2 * stride + c % stride;
+                int hi = lo + stride;
+                Bits klo = k[lo], khi = k[hi];
+                unsigned int plo = p[lo], phi = p[hi];
+                bool up = (lo & size) == 0;
+                bool gt = klo > khi || (klo == khi && plo > phi);
+                bool swap = gt == up;
+                k[lo] = swap ? khi : klo;
+                k[hi] = swap ? klo : khi;
+                p[lo] = swap ? phi : plo;
+                p[hi] = swap ? plo : phi;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        P[i] = k[i];
+        Pv[i] = v[p[i]];
+    }
+}
+
+template <class K, class V>
+__declspec(target(mic))
+void segSortThread(void *arg, long id)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    SegSort<K,V> &g = *(SegSort<K,V> *)arg;
+    MsdSort<K,V> &m = g.m;
+    RadixSort<K,V> &s = m.part;
+
+    long start = id * s.elementsPerTask;
+    long end = start + s.elementsPerTask;
+    if (start > s.numElements) start = s.numElements;
+    if (end > s.numElements) end = s.numElements;
+
+    radixPrepare(s, id, start, end);
+
+    Bits *P = s.keys[0], *Q = s.keys[1];
+    V *Pv = s.values[0], *Qv = s.values[1];
+    long counts[3] = { 0, 0, 0 };
+
+    // Long segments, in order, by all threads
+    for (int b = 0; b < g.numSegments && s.high >= 0; b++)
+    {
+        long off = g.offsets[b];
+        long n = g.offsets[b+1] - off;
+        if (n > g.largeSegment)
+        {
+            cooperativeSort(m, id, P + off, Pv + off, Q + off, Qv + off, n,
+                            s.low, s.high);
+            counts[2]++;
+        }
+    }
+
+    // Short and medium segments, in batches, dynamically scheduled
+    for (;;)
+    {
+        int first = __sync_fetch_and_add(&g.next, SEG_BATCH);
+        if (first >= g.numSegments || s.high < 0)
+        {
+            break;
+        }
+        int last = first + SEG_BATCH;
+        if (last > g.numSegments)
+        {
+            last = g.numSegments;
+        }
+        for (int b = first; b < last; b++)
+        {
+            long off = g.offsets[b];
+            long n = g.offsets[b+1] - off;
+            if (n <= 1)
+            {
+                continue;
+            }
+            if (n <= SEG_NETWORK_MAX)
+            {
+                networkSort(P + off, Pv + off, n);
+                counts[0]++;
+            }
+            else if (n <= g.largeSegment)
+            {
+                localRadixSort(P + off, Pv + off, Q + off, Qv + off, n,
+                               s.low, s.high);
+                counts[1]++;
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        __sync_fetch_and_add(&g.counts[i], counts[i]);
+    }
+    _BARRIER_;
+
+    // The sorted elements go to the output arrays
+    radixFinish(s, 0, start, end);
+}
+
+// ****************************************************************************
+// Function: segSortKernel
+//
+// Purpose:
+//   Sorts the key-value pairs of each segment by key.  Segment i holds
+//   elements offsets[i] to offsets[i+1]-1; elements outside all segments
+//   are copied unchanged.  The input arrays are used as scratch space; the
+//   result is returned in outkey/outvalue.
+//
+// Arguments:
+//   hkey, hvalue: input keys and values
+//   outkey, outvalue: output - segment-sorted keys and values
+//   N: number of elements
+//   offsets: numSegments+1 ascending segment offsets
+//   numSegments: number of segments
+//   numThreads: number of sort threads
+//   cacheKB: per-thread cache budget, sets the serial/parallel cut-off
+//   info: output - segments sorted by network, serially and in parallel
+//         (may be NULL)
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void segSortKernel(K* hkey, V* hvalue, K* outkey, V* outvalue,
+        const size_t N, const unsigned int *offsets, int numSegments,
+        int numThreads, int cacheKB, long *info)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    SegSort<K,V> g;
+    MsdSort<K,V> &m = g.m;
+    RadixSort<K,V> &s = m.part;
+
+    if (numThreads > MAX_WORKER)
+    {
+        printf("numthreads > Max Workers\n");
+        return;
+    }
+    Thread = numThreads;
+    s.elementsPerTask = (((N + Thread - 1) / Thread) + 63) & ~63;
+    s.numElements = N;
+    s.forceBits = 0;
+    s.cacheBytes = cacheKB * 1024L;
+
+    s.keys[0] = (Bits *)hkey;
+    s.keys[1] = (Bits *)outkey;
+    s.values[0] = hvalue;
+    s.values[1] = outvalue;
+    s.Sums = (unsigned int *)my_malloc(Thread*sizeof(unsigned int));
+    s.Masks = (Bits *)my_malloc(Thread*sizeof(Bits));
+
+    // A segment is worth all threads when a share of it would still fill
+    // the cache budget of a thread
+    long elemBytes = sizeof(Bits) + sizeof(V);
+    g.largeSegment = Thread * (s.cacheBytes / (2 * elemBytes));
+    g.offsets = offsets;
+    g.numSegments = numSegments;
+    g.next = 0;
+    g.counts[0] = g.counts[1] = g.counts[2] = 0;
+
+    runPool(Thread, segSortThread<K,V>, &g);
+
+    if (info)
+    {
+        info[0] = g.counts[0];
+        info[1] = g.counts[1];
+        info[2] = g.counts[2];
+    }
+
+    _mm_free(s.Sums);
+    _mm_free(s.Masks);
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SEG_SORT_KERNEL_H_
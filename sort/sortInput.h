@@ -0,0 +1,259 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: sortInput.h
+//
+// Purpose:
+//   Key distributions for the Sort benchmark, generated in parallel on the
+//   host.  Every key is a function of its index and a seed, so generation
+//   does not depend on the number of threads.
+//
+//     uniform  - uniform over all bit patterns (integers) or [-1e6, 1e6)
+//     zipf     - ranks drawn with P(k) ~ 1/k^zipf_skew, mapped to
+//                scattered keys; a few keys are very frequent
+//     sorted   - non-decreasing keys spread over the key range
+//     reverse  - non-increasing keys
+//     almost   - sorted with swap_pct% of the elements swapped in pairs
+//     equal    - a single key
+//     few      - unique_keys distinct keys in random order
+//
+// ****************************************************************************
+
+#ifndef SORT_INPUT_H_
+#define SORT_INPUT_H_
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <math.h>
+#include "OptionParser.h"
+
+#define NUM_DISTRIBUTIONS 7
+static const char *sortDistributions[NUM_DISTRIBUTIONS] = {
+    "uniform", "zipf", "sorted", "reverse", "almost", "equal", "few"
+};
+
+// Zipf ranks are drawn from a table of at most this many ranks
+#define ZIPF_MAX_RANKS (1 << 20)
+
+// splitmix64 finalizer, used as a counter based random number generator
+inline unsigned long long sortHash(unsigned long long x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline double sortUniform(unsigned long long x)
+{
+    return (sortHash(x) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// ****************************************************************************
+// Function: keyFromBits, orderedKey
+//
+// Purpose:
+//   keyFromBits maps 64 random bits to a key uniform over the key range.
+//   orderedKey maps i in [0, n) to keys that do not decrease with i.
+//
+// ****************************************************************************
+template <class K>
+inline K keyFromBits(unsigned long long r)
+{
+    return (K)r;
+}
+
+template <>
+inline float keyFromBits<float>(unsigned long long r)
+{
+    return (float)(2e6 * ((r >> 11) * (1.0 / 9007199254740992.0)) - 1e6);
+}
+
+template <>
+inline double keyFromBits<double>(unsigned long long r)
+{
+    return 2e6 * ((r >> 11) * (1.0 / 9007199254740992.0)) - 1e6;
+}
+
+template <class K>
+inline K orderedKey(long i, long n)
+{
+    return (K)((double)i / n * (double)std::numeric_limits<K>::max());
+}
+
+template <>
+inline float orderedKey<float>(long i, long n)
+{
+    return (float)(2e6 * i / n - 1e6);
+}
+
+template <>
+inline double orderedKey<double>(long i, long n)
+{
+    return 2e6 * i / n - 1e6;
+}
+
+// ****************************************************************************
+// Function: addDistributionOptions
+//
+// Purpose:
+//   Adds the options of the key distributions
+//
+// ****************************************************************************
+inline void addDistributionOptions(OptionParser &op)
+{
+    op.addOption("distribution", OPT_STRING, "uniform", "key distribution: "
+                 "uniform, zipf, sorted, reverse, almost, equal, few, or "
+                 "all to run each");
+    op.addOption("zipf_skew", OPT_FLOAT, "1.0", "exponent of the zipf "
+                 "distribution");
+    op.addOption("swap_pct", OPT_FLOAT, "1.0", "percentage of elements "
+                 "swapped in the almost sorted distribution");
+    op.addOption("unique_keys", OPT_INT, "16", "number of distinct keys in "
+                 "the few distribution");
+    op.addOption("seed", OPT_INT, "1", "random seed of the generated keys; "
+                 "every test sorts the same keys for the same seed");
+}
+
+// ****************************************************************************
+// Function: generateKeys
+//
+// Purpose:
+//   Fills keys with n keys of the named distribution
+//
+// Arguments:
+//   keys: output - the keys
+//   n: number of keys
+//   dist: distribution name
+//   op: the options parser / parameter database
+//   seed: random seed
+//
+// Returns:  false if the distribution is unknown
+//
+// ****************************************************************************
+template <class K>
+bool generateKeys(K *keys, long n, const std::string &dist, OptionParser &op,
+                  unsigned long long seed)
+{
+    seed = sortHash(seed) << 32;
+
+    if (dist == "uniform")
+    {
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            keys[i] = keyFromBits<K>(sortHash(seed + i));
+        }
+    }
+    else if (dist == "zipf")
+    {
+        // Inverse transform sampling on the cumulative distribution of
+        // the ranks; the ranks are hashed so frequent keys are scattered
+        // over the key range
+        double s = op.getOptionFloat("zipf_skew");
+        long ranks = std::min(n, (long)ZIPF_MAX_RANKS);
+        std::vector<double> cdf(ranks);
+        double sum = 0;
+        for (long k = 0; k < ranks; k++)
+        {
+            sum += pow((double)(k + 1), -s);
+            cdf[k] = sum;
+        }
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            double u = sortUniform(seed + i) * sum;
+            long rank = std::lower_bound(cdf.begin(), cdf.end(), u) -
+                        cdf.begin();
+            keys[i] = keyFromBits<K>(sortHash(seed - 1 - rank));
+        }
+    }
+    else if (dist == "sorted" || dist == "almost")
+    {
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            keys[i] = orderedKey<K>(i, n);
+        }
+        if (dist == "almost")
+        {
+            // The swaps are few and may overlap, so they are done serially
+            long swaps = (long)(n * op.getOptionFloat("swap_pct") / 200);
+            for (long j = 0; j < swaps; j++)
+            {
+                long a = sortHash(seed + 2*j) % n;
+                long b = sortHash(seed + 2*j + 1) % n;
+                std::swap(keys[a], keys[b]);
+            }
+        }
+    }
+    else if (dist == "reverse")
+    {
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            keys[i] = orderedKey<K>(n - 1 - i, n);
+        }
+    }
+    else if (dist == "equal")
+    {
+        K k = keyFromBits<K>(sortHash(seed));
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            keys[i] = k;
+        }
+    }
+    else if (dist == "few")
+    {
+        long unique = op.getOptionInt("unique_keys");
+        if (unique < 1) unique = 1;
+        #pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            keys[i] = keyFromBits<K>(sortHash(seed - 1 -
+                                              sortHash(seed + i) % unique));
+        }
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+#endif // SORT_INPUT_H_
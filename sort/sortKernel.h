@@ -32,6 +32,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
 // THE POSSIBILITY OF SUCH DAMAGE.
 
+#ifndef SORT_KERNEL_H_
+#define SORT_KERNEL_H_
+
 #pragma offload_attribute(push,target(mic))
 
 #include <stdio.h>
@@ -47,574 +50,807 @@
 #include <sys/shm.h>
 #include <omp.h>
 
-#define MAX_THREAD  248
-#define MAX_WORKER  248
+#include "sortPool.h"
+
 unsigned int Thread; // number of threads
-int coreFreq;
 
-#include <pthread.h>
-#ifdef AFFINITIZE
-#include <pthread_affinity_np.h>
-#endif
+// Barrier of the sort threads; every step function has the thread id in id
+#define _BARRIER_ barrier(id);
+
+
+#define my_malloc(X) _mm_malloc(X, 4096)
+
 
-#include <fcntl.h>
+// Candidate digit widths of a radix sort pass; histogram bins per pass
+// are 1 << width
+#define NUM_DIGIT_BITS 3
+static const int radixDigitBits[NUM_DIGIT_BITS] = { 8, 11, 16 };
 
-#include <sys/sysctl.h>
-pthread_t th[128];
+// Size of a cache line, the unit in which the scatter writes its output
+#define LINE_BYTES 64
 
-typedef struct threadData
+// Sub-histograms per histogram, one per vector lane
+#define HIST_LANES 16
+
+// Seconds spent by the histogram and scatter steps of radixPasses since the
+// last sortKernel call
+double StepTime[2];
+
+// ****************************************************************************
+// Function: streamLines, streamFence
+//
+// Purpose:
+//   streamLines copies whole cache lines to 64 byte aligned memory with
+//   non-temporal stores, which write the line without reading it first and
+//   without keeping it in cache.  streamFence orders the streaming stores
+//   before later stores.
+//
+// ****************************************************************************
+inline void streamLines(void *dst, const void *src, int bytes)
 {
-    long tid;
-    long numElements;
+    for (int i = 0; i < bytes; i += LINE_BYTES)
+    {
+#ifdef __MIC__
+        _mm512_storenrngo_ps((char *)dst + i,
+                             _mm512_load_ps((const char *)src + i));
+#else
+        const __m128i *in = (const __m128i *)((const char *)src + i);
+        __m128i *out = (__m128i *)((char *)dst + i);
+        _mm_stream_si128(out,     _mm_load_si128(in));
+        _mm_stream_si128(out + 1, _mm_load_si128(in + 1));
+        _mm_stream_si128(out + 2, _mm_load_si128(in + 2));
+        _mm_stream_si128(out + 3, _mm_load_si128(in + 3));
+#endif
+    }
+}
 
-}THREAD_DATA_T;
-
-THREAD_DATA_T tdata;
-
-#define BARRIER(X, Y, T) pthread_barrier_wait(&X);
-volatile static int _barrier_turn_ = 0;
-volatile static int _barrier_go_1;
-volatile static int _barrier_1[256];
-volatile static int _barrier_go_2;
-volatile static int _barrier_2[256];
-#define _BARRIER_ \
-    if (_barrier_turn_ == 0) \
-{ \
-    if (id == 0) \
-    { \
-        for (int i=1; i<Thread; i++) \
-        { \
-            while(_barrier_1[i] == 0); \
-            _barrier_2[i] = 0; \
-        } \
-        _barrier_turn_ = 1; \
-        _barrier_go_2 = 0; \
-        _barrier_go_1 = 1; \
-    } \
-    else \
-    { \
-        _barrier_1[id] = 1; \
-        while(_barrier_go_1 == 0); \
-    } \
-} \
-else \
-{ \
-    if (id == 0) \
-    { \
-        for (int i=1; i<Thread; i++) \
-        { \
-            while(_barrier_2[i] == 0); \
-            _barrier_1[i] = 0; \
-        } \
-        _barrier_turn_ = 0; \
-        _barrier_go_1 = 0; \
-        _barrier_go_2 = 1; \
-    } \
-    else \
-    { \
-        _barrier_2[id] = 1; \
-        while(_barrier_go_2 == 0); \
-    } \
+inline void streamFence()
+{
+#ifdef __MIC__
+    __sync_synchronize();
+#else
+    _mm_sfence();
+#endif
 }
 
+// ****************************************************************************
+// Struct: RadixKey
+//
+// Purpose:
+//   Maps a key type onto an unsigned integer of the same width whose
+//   unsigned order is the key order, which is what the radix passes sort.
+//   Integers map to themselves.  For IEEE floats the sign bit is flipped
+//   for positive values and all bits are flipped for negative ones, so
+//   negatives sort below positives and in reverse magnitude order.
+//
+// ****************************************************************************
+template <class K> struct RadixKey;
 
-#define my_malloc(X) _mm_malloc(X, 4096)
+template <> struct RadixKey<unsigned int>
+{
+    typedef unsigned int Bits;
+    static const bool flip = false;
+    static Bits toBits(unsigned int k) { return k; }
+    static unsigned int fromBits(Bits b) { return b; }
+};
+
+template <> struct RadixKey<unsigned long long>
+{
+    typedef unsigned long long Bits;
+    static const bool flip = false;
+    static Bits toBits(unsigned long long k) { return k; }
+    static unsigned long long fromBits(Bits b) { return b; }
+};
 
+template <> struct RadixKey<float>
+{
+    typedef unsigned int Bits;
+    static const bool flip = true;
+    static Bits toBits(float k)
+    {
+        Bits b;
+        memcpy(&b, &k, sizeof(b));
+        return b ^ ((Bits)(-(int)(b >> 31)) | 0x80000000u);
+    }
+    static float fromBits(Bits b)
+    {
+        b ^= ((b >> 31) - 1) | 0x80000000u;
+        float k;
+        memcpy(&k, &b, sizeof(k));
+        return k;
+    }
+};
 
-// Number of radix bits and histogram bins per pass of radix sort
-#define LOG_HIST_BINS 8
-#define HIST_BINS 256
-#define HIST_BINS_1 255
+template <> struct RadixKey<double>
+{
+    typedef unsigned long long Bits;
+    static const bool flip = true;
+    static Bits toBits(double k)
+    {
+        Bits b;
+        memcpy(&b, &k, sizeof(b));
+        return b ^ ((Bits)(-(long long)(b >> 63)) | 0x8000000000000000ULL);
+    }
+    static double fromBits(Bits b)
+    {
+        b ^= ((b >> 63) - 1) | 0x8000000000000000ULL;
+        double k;
+        memcpy(&k, &b, sizeof(k));
+        return k;
+    }
+};
 
-// X = input key, Y = output key
-// Z = input value V = output Value
-// Hist = histogram
-// Buf = local buffer for efficiency
-unsigned int *X;
-unsigned int *Y;
-unsigned int *Z;
-unsigned int *V;
+// ****************************************************************************
+// Struct: RadixSort
+//
+// Purpose:
+//   State shared by the sort threads.  Keys are sorted as their RadixKey
+//   bit patterns, ping-ponging between the input and output arrays, one
+//   digit per pass starting from the least significant varying bit.
+//
+// ****************************************************************************
+template <class K, class V>
+struct RadixSort
+{
+    typedef typename RadixKey<K>::Bits Bits;
 
-unsigned int *pingpong;
-unsigned int *Hist;
-unsigned int *Buf;
-unsigned int *vBuf;
-unsigned int *tmp;
-unsigned int *masks;
+    // Elements buffered per radix before the scatter writes them out: one
+    // cache line of the narrower of the key and value types
+    static const int BUF = LINE_BYTES /
+        (sizeof(Bits) < sizeof(V) ? sizeof(Bits) : sizeof(V));
 
-int global_elements_per_task;
-#define LOOKUP(a,phase) ((a>>(phase*LOG_HIST_BINS))&HIST_BINS_1)
-#define BUFFER_SIZE 16
-#define BUFFER_SIZE_1 15
+    Bits *keys[2];          // input and output keys
+    V *values[2];           // input and output values
+    long numElements;
+    int elementsPerTask;
+    long cacheBytes;        // per-thread cache budget for choosing digits
+    int forceBits;          // digit width from the caller, 0 = adaptive
+
+    // Digits, chosen by thread 0 once the varying key bits are known
+    int bits;               // digit width
+    int bins;               // 1 << bits
+    int low;                // lowest varying key bit
+    int high;               // highest varying key bit
+    int passes;
+    int buffered;           // scatter through the write-combining buffers
+    int streaming;          // flush the buffers with streaming stores
+    int lanes;              // count in HIST_LANES sub-histograms
+    int passesRun;          // passes that were not skipped
+    volatile int skip;      // pass+1 if all keys share the pass' digit
+
+    // Hist holds two histograms per thread, one for each half of the
+    // thread's elements; Sums holds the per-thread partial column sums
+    // and Masks the per-thread bits in which keys differ from the first
+    unsigned int *Hist;
+    unsigned int *Sums;
+    Bits *Masks;
+    unsigned int *Sub;      // per-thread sub-histograms, bins*HIST_LANES
+    unsigned int *Start;    // per-thread first output position per radix
+    Bits *Buf;              // per-thread key buffers, bins*BUF each
+    V *vBuf;                // per-thread value buffers
+};
+
+// ****************************************************************************
+// Function: chooseDigits
+//
+// Purpose:
+//   Picks the digit width for sorting keys that vary in width bits.  Every
+//   candidate width is costed as the memory traffic of its passes.  A pass
+//   reads the elements twice and writes them once, and clears and scans
+//   2*bins counters per thread.  When the histograms and buffers of a
+//   width do not fit in the per-thread cache budget the scatter writes
+//   directly: with one open line per radix in cache that adds a read for
+//   ownership, without it every element moves whole lines.  Fewer, wider
+//   passes win for narrow key ranges.
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void chooseDigits(RadixSort<K,V> &s, int width)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    const int BUF = RadixSort<K,V>::BUF;
+    double elemBytes = sizeof(Bits) + sizeof(V);
+    double best = -1;
 
+    for (int c = 0; c < NUM_DIGIT_BITS; c++)
+    {
+        int bits = radixDigitBits[c];
+        if (s.forceBits && bits != s.forceBits)
+        {
+            continue;
+        }
+        long bins = 1L << bits;
+        int passes = (width + bits - 1) / bits;
+        int buffered = bins * (3*sizeof(unsigned int) +
+                               BUF * elemBytes) <= s.cacheBytes;
+        double bytes;
+        if (buffered)
+        {
+            bytes = 3 * elemBytes;
+        }
+        else if (bins * 2 * LINE_BYTES <= s.cacheBytes)
+        {
+            bytes = 4 * elemBytes;
+        }
+        else
+        {
+            bytes = 2 * elemBytes + 2 * LINE_BYTES;
+        }
+        double cost = passes * (s.numElements * bytes + 16.0*Thread*bins);
+        if (best < 0 || cost < best)
+        {
+            best = cost;
+            s.bits = bits;
+            s.passes = passes;
+            s.buffered = buffered;
+        }
+    }
+    if (best < 0)
+    {
+        // an unsupported forced width is used as is
+        s.bits = s.forceBits;
+        s.passes = (width + s.bits - 1) / s.bits;
+        s.buffered = 0;
+    }
+    s.bins = 1 << s.bits;
+}
 
-// The code below only implements one phase of radix sort dealing with 8 bits
+// The code below implements one pass of radix sort over one digit.
 // Radix sort has three steps:
 
-// Step1 : histogram computation for each of the HIST_BINS radices
+// Step1 : histogram computation for each of the radices
 // Step2 : prefix sum of the radices
 // Step3 : scatter to proper locations
 
-#define L2DIST 64
-    __declspec(target(mic))
-void Step1_Phase1(long id, int phase)
+// Counts the digits of n keys with each vector lane counting into its own
+// sub-histogram, so the lanes of a vector never increment the same counter
+// and the loop vectorizes without conflict detection.  Lane l's counter of
+// bin b is Sub[b*HIST_LANES + l]: one line holds a bin of every lane.
+template <class Bits>
+__declspec(target(mic))
+void histogramLanes(const Bits *X, long n, int shift, int bins,
+                    unsigned int *Sub, unsigned int *Hist)
 {
-    int index, index2;
-    long N = tdata.numElements;
-
-    int starting_element_id = id*global_elements_per_task;
-    int ending_element_id = starting_element_id + global_elements_per_task;
-    if (ending_element_id > N) ending_element_id = N;
-    int i;
-    unsigned int *Local_Hist = Hist + 2*(HIST_BINS)*id;
-    unsigned int *Local_Hist2 = Hist + 2*(HIST_BINS)*id+HIST_BINS;
-
-    _BARRIER_;
-    unsigned int *X_start = X + starting_element_id;
-    unsigned int *X_start_2 = X + starting_element_id +
-        ((ending_element_id - starting_element_id)>>1);
-    for (i=0; i< (((ending_element_id-starting_element_id)>>1)); i+=32)
-    {
-        #pragma unroll (16)
-        for (unsigned j = 0; j < 16; j++){
-            unsigned int in0 = X_start[i+j];
-            unsigned int in1 = X_start_2[i+j];
-            unsigned int index0 = LOOKUP(in0,phase); //LOOKUP1(in0);
-            unsigned int index1 = LOOKUP(in1,phase); //LOOKUP1(in1);
-            unsigned int tmp0 = Local_Hist[index0];
-            unsigned int tmp1 = Local_Hist2[index1];
-            tmp0++;
-            tmp1++;
-            Local_Hist[index0] = tmp0;
-            Local_Hist2[index1] = tmp1;
+    const unsigned int mask = bins - 1;
+    memset(Sub, 0, bins*HIST_LANES*sizeof(unsigned int));
+    long full = n - n % HIST_LANES;
+    for (long i = 0; i < full; i += HIST_LANES)
+    {
+        #pragma simd
+        for (int l = 0; l < HIST_LANES; l++)
+        {
+            unsigned int b = (unsigned int)(X[i+l] >> shift) & mask;
+            Sub[b*HIST_LANES + l]++;
         }
-
-        #pragma unroll (16)
-        for (unsigned j = 0; j < 16; j++){
-            unsigned int in0 = X_start[i+j+16];
-            unsigned int in1 = X_start_2[i+j+16];
-            unsigned int index0 = LOOKUP(in0,phase); //LOOKUP1(in0);
-            unsigned int index1 = LOOKUP(in1,phase); //LOOKUP1(in1);
-
-            unsigned int tmp0 = Local_Hist[index0];
-            unsigned int tmp1 = Local_Hist2[index1];
-            tmp0++;
-            tmp1++;
-            Local_Hist[index0] = tmp0;
-            Local_Hist2[index1] = tmp1;
+    }
+    for (long i = full; i < n; i++)
+    {
+        Sub[((unsigned int)(X[i] >> shift) & mask)*HIST_LANES]++;
+    }
+    for (int b = 0; b < bins; b++)
+    {
+        unsigned int c = 0;
+        #pragma simd reduction(+:c)
+        for (int l = 0; l < HIST_LANES; l++)
+        {
+            c += Sub[b*HIST_LANES + l];
         }
+        Hist[b] = c;
     }
-    _BARRIER_;
-
 }
 
+template <class K, class V>
 __declspec(target(mic))
-void Step2_Phase1(long id, int phase)
+void Step1_Histogram(RadixSort<K,V> &s, long id, int shift,
+                     const typename RadixKey<K>::Bits *X)
 {
-    int index, index2;
+    long start = id * s.elementsPerTask;
+    long end = start + s.elementsPerTask;
+    if (start > s.numElements) start = s.numElements;
+    if (end > s.numElements) end = s.numElements;
+
+    const int bins = s.bins;
+    const unsigned int mask = bins - 1;
+    unsigned int *Local_Hist = s.Hist + 2*bins*id;
+    unsigned int *Local_Hist2 = Local_Hist + bins;
+    long half = (end - start) >> 1;
+
+    if (s.lanes)
+    {
+        unsigned int *Sub = s.Sub + (long)bins*HIST_LANES*id;
+        histogramLanes(X + start, half, shift, bins, Sub, Local_Hist);
+        histogramLanes(X + start + half, end - start - half, shift, bins,
+                       Sub, Local_Hist2);
+        _BARRIER_;
+        return;
+    }
 
-    long N = tdata.numElements;
+    // Sub-histograms too large for the cache: two independent histograms
+    // over the two halves of the range hide the latency of the
+    // read-modify-write of each counter
+    for (int i = 0; i < 2*bins; i++)
+    {
+        Local_Hist[i] = 0;
+    }
+    const typename RadixKey<K>::Bits *X_start = X + start;
+    const typename RadixKey<K>::Bits *X_start_2 = X + start + half;
+    #pragma unroll (16)
+    for (long i = 0; i < half; i++)
+    {
+        unsigned int index0 = (unsigned int)(X_start[i] >> shift) & mask;
+        unsigned int index1 = (unsigned int)(X_start_2[i] >> shift) & mask;
+        Local_Hist[index0]++;
+        Local_Hist2[index1]++;
+    }
+    if ((end - start) & 1)
+    {
+        Local_Hist2[(unsigned int)(X[end-1] >> shift) & mask]++;
+    }
+    _BARRIER_;
+}
 
-    int total_hists = HIST_BINS*Thread*2;
-    int num_columns = HIST_BINS/Thread;
-    if ((HIST_BINS%Thread) != 0) num_columns++;
+// Step2 turns the histograms into the output offsets of each thread's
+// elements of each radix.  The bins are split in columns over the threads.
+// A column holding every element means all keys share this digit and the
+// pass is skipped.
+template <class K, class V>
+__declspec(target(mic))
+void Step2_Offsets(RadixSort<K,V> &s, long id, int pass)
+{
+    unsigned int *Hist = s.Hist;
+    const int bins = s.bins;
+    int num_columns = bins/Thread;
+    if ((bins%Thread) != 0) num_columns++;
     int start_col = id*num_columns;
     int end_col = start_col + num_columns;
-    if (end_col > HIST_BINS) {end_col = HIST_BINS;}
-
-    _BARRIER_;
-    int prev_counter = 0;
-    int curr_counter;
+    if (start_col > bins) {start_col = bins;}
+    if (end_col > bins) {end_col = bins;}
 
+    unsigned int prev_counter = 0;
     for (int i=start_col; i<end_col; i++)
     {
+        unsigned int col_start = prev_counter;
         for (int j=0; j<Thread*2; j++)
         {
-            curr_counter = Hist[j*(HIST_BINS)+i];
-            Hist[j*(HIST_BINS)+i] = prev_counter;
+            unsigned int curr_counter = Hist[j*bins+i];
+            Hist[j*bins+i] = prev_counter;
             prev_counter += curr_counter;
         }
+        if (prev_counter - col_start == s.numElements)
+        {
+            s.skip = pass + 1;
+        }
     }
-    if (start_col < HIST_BINS) Hist[start_col] = prev_counter;
+    s.Sums[id] = prev_counter;
     _BARRIER_;
+    if (s.skip == pass + 1)
+    {
+        return;
+    }
     if (id == 0)
     {
-        int prev_counter = 0, curr_counter;
+        unsigned int prev_counter = 0;
         for (int i=0; i < Thread; i++)
         {
-            if (i*num_columns < HIST_BINS)
-            {
-                curr_counter = Hist[i*num_columns];
-                Hist[i*num_columns] = prev_counter;
-                prev_counter += curr_counter;
-            }
+            unsigned int curr_counter = s.Sums[i];
+            s.Sums[i] = prev_counter;
+            prev_counter += curr_counter;
         }
     }
     _BARRIER_;
-    for (int j=1; j<Thread*2; j++)
-    {
-        Hist[j*HIST_BINS+start_col] += Hist[start_col];
-    }
-    for (int i=(start_col+1); i < end_col; i++)
+    unsigned int offset = s.Sums[id];
+    for (int i=start_col; i < end_col; i++)
     {
         for (int j=0; j<Thread*2; j++)
         {
-            Hist[j*HIST_BINS + i] += Hist[start_col];
+            Hist[j*bins + i] += offset;
         }
     }
     _BARRIER_;
 }
 
-// Step3 is scatter step
-// uses buffer to speed up scatter
+// Step3 scatters the elements of one half of a thread's range.  It uses a
+// buffer to speed up the scatter: elements are put in a buffer of BUF
+// entries per radix, and as soon as the buffer of a radix is full it is
+// written out to memory as whole cache lines, with streaming stores when
+// the output does not fit in cache.  Digits too wide for the buffers to
+// stay in cache are scattered directly.
+template <class K, class V>
 __declspec(target(mic))
-void Step3_Buffer_Phase1(long id, int phase)
+void Step3_Scatter(RadixSort<K,V> &s, long id, int shift,
+                   const typename RadixKey<K>::Bits *X_start,
+                   const V *Z_start, long n, unsigned int *Local_Hist,
+                   typename RadixKey<K>::Bits *Y, V *W)
 {
-    // The logic is the following:
-    // Read elements 16 at a time, put them into appropriate positions in
-    // the buffer. The buffer is an array of HIST_BINS * BUFFER_SIZE, and
-    // buffers BUFFER_SIZE entries per radix. As soon as a buffer line
-    // corresponding to a radix gets full, it is written out to memory.
-
-    const int L2_DIST = 10;
-    int index, index2;
-    long N = tdata.numElements;
-
-    _BARRIER_;
-    int starting_element_id = id*global_elements_per_task;
-    int ending_element_id = starting_element_id + global_elements_per_task;
-    if (ending_element_id > N) ending_element_id = N;
-    int i;
+    typedef typename RadixKey<K>::Bits Bits;
+    const int BUF = RadixSort<K,V>::BUF;
+    const int bins = s.bins;
+    const unsigned int mask = bins - 1;
 
-    unsigned int *Local_Hist = Hist + (HIST_BINS)*id*2;
-    unsigned int *Local_Hist2 = Hist + (HIST_BINS)*id*2 + HIST_BINS;
-    unsigned int *tmpLocal = tmp + id*32;
-
-    unsigned int *Dest = Buf + BUFFER_SIZE*HIST_BINS*id;
-    unsigned int *vDest = vBuf + BUFFER_SIZE*HIST_BINS*id;
+    if (!s.buffered)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            Bits in = X_start[i];
+            unsigned int index = (unsigned int)(in >> shift) & mask;
+            unsigned int cnt = Local_Hist[index]++;
+            Y[cnt] = in;
+            W[cnt] = Z_start[i];
+        }
+        return;
+    }
 
-    unsigned char steady_state[HIST_BINS];
-    unsigned int start_cnt[HIST_BINS];
+    Bits *Dest = s.Buf + BUF*bins*id;
+    V *vDest = s.vBuf + BUF*bins*id;
 
-    for (unsigned i = 0; i < HIST_BINS; i++)
+    // The first line written for a radix may start in the middle of a
+    // buffer line; the part before start_cnt belongs to another thread
+    unsigned int *start_cnt = s.Start + bins*id;
+    for (int i = 0; i < bins; i++)
     {
-        steady_state[i] = 0;
         start_cnt[i] = Local_Hist[i];
     }
 
-    // Set up masks for buffer management
-    unsigned int m0 = 0xFFFF;
-    unsigned int mask_constants[16] = {
-        0xFFFF, 0xFFFE, 0xFFFC, 0xFFF8,
-        0xFFF0, 0xFFE0, 0xFFC0, 0xFF80,
-        0xFF00, 0xFE00, 0xFC00, 0xF800,
-        0xF000, 0xE000, 0xC000, 0x8000
-    };
-
-    unsigned int *X_start = X + starting_element_id;
-    unsigned int *X_start_2 = X + starting_element_id +
-        ((ending_element_id - starting_element_id)>>1);
-
-    unsigned int *Z_start = Z + starting_element_id;
-    unsigned int *Z_start_2 = Z + starting_element_id +
-        ((ending_element_id - starting_element_id)>>1);
-
-    unsigned int log_hist_bins = LOG_HIST_BINS;
-    unsigned int and_mask = HIST_BINS_1;
-    unsigned int buf_size = BUFFER_SIZE;
-
-    _BARRIER_;
-
-#define STEP_SIZE 32
-
-    for (i = 0; i < ((ending_element_id - starting_element_id)>>1);
-                    i += STEP_SIZE)
+    for (long i = 0; i < n; i++)
     {
-        tmpLocal[0:16] = (X_start[i:16]>>(phase*LOG_HIST_BINS))&and_mask;
-        tmpLocal[16:16] = (X_start[i+16:16]>>(phase*LOG_HIST_BINS))&and_mask;
+        Bits in = X_start[i];
+        unsigned int index = (unsigned int)(in >> shift) & mask;
+        unsigned int cnt = Local_Hist[index]++;
+        unsigned int slot = cnt % BUF;
 
-        // For each element, do scalar computation to find the buffer position
-        // to write to. This is done with a histogram update followed by a write
-        // to local buffer
+        // write to buffer
+        Dest[index*BUF + slot] = in;
+        vDest[index*BUF + slot] = Z_start[i];
 
-        for (unsigned j = 0; j < STEP_SIZE; j++)
+        // detect if buffer line is full
+        if (slot == BUF - 1)
         {
-            unsigned int in = X_start[i+j];
-            unsigned int vin = Z_start[i+j];
-
-            unsigned int index = tmpLocal[j]; // computed radix
-            unsigned int cnt = Local_Hist[index]++;
-
-            // write to buffer
-            Dest[index*BUFFER_SIZE + cnt%BUFFER_SIZE] = in;
-            vDest[index*BUFFER_SIZE + cnt%BUFFER_SIZE] = vin;
-
-            // detect if buffer line is full
-            if (cnt%BUFFER_SIZE == BUFFER_SIZE_1)
+            unsigned int base = cnt - (BUF - 1);
+            if (base >= start_cnt[index])
             {
-                // if so, write out the line
-                //   this has two special cases: the first time we write a
-                //   line correpsonding to a radix, and the last time we
-                //   flush buffer values in a line.
-
-                //   For the first time, we may start with an unaligned
-                //   address: then we compute the start of the cache line
-                //   corresponding to the write value, and write only
-                //   the correct subset of the elements using a masked store.
-                //   The last flush is handled separately.
-                unsigned int * Y_start = Y + cnt - BUFFER_SIZE_1;
-                unsigned int * V_start = V + cnt - BUFFER_SIZE_1;
-
-                if (steady_state[index])
+                // This is the normal case, when we write the entire line
+                Bits *Y_start = Y + base;
+                V *W_start = W + base;
+                if (s.streaming)
                 {
-                    // This is the normal case, when we write the entire
-                    // buffer line.
-                    // There is a loss in perf here in moving from intirin->C.
-                    #pragma vector aligned
-                    Y_start[0:16] = Dest[index*BUFFER_SIZE:16];
-                    V_start[0:16] = vDest[index*BUFFER_SIZE:16];
+                    streamLines(Y_start, Dest + index*BUF,
+                                BUF*sizeof(Bits));
+                    streamLines(W_start, vDest + index*BUF, BUF*sizeof(V));
+                    continue;
                 }
-                else
+                #pragma vector aligned
+                for (int k = 0; k < BUF; k++)
                 {
-                    // special case for first write
-                    steady_state[index] = 1;
-                    unsigned int m1 =
-                            mask_constants[start_cnt[index]%BUFFER_SIZE];
-                    #pragma unroll(16)
-                    for (int k=0;k<16;k++)
-                    {
-                        if ((m1&(1<<k)))
-                        {
-                            Y_start[k] = Dest[k+index*BUFFER_SIZE];
-                            V_start[k] = vDest[k+index*BUFFER_SIZE];
-                        }
-                    }
+                    Y_start[k] = Dest[index*BUF + k];
+                    W_start[k] = vDest[index*BUF + k];
+                }
+            }
+            else
+            {
+                // special case for the first write of a radix
+                for (int k = start_cnt[index] - base; k < BUF; k++)
+                {
+                    Y[base+k] = Dest[index*BUF + k];
+                    W[base+k] = vDest[index*BUF + k];
                 }
             }
         }
     }
 
-    // this handles the last flush of remaining buffer elements to memory:
-    // This is scalar for now. Can also be LRBized - but is not a
-    // bottleneck for large input sets.
-    for (unsigned i = 0; i < HIST_BINS; i++)
+    if (s.streaming)
     {
-        int cnt = Local_Hist[i];
-        int cnt2 = cnt - cnt%BUFFER_SIZE;
-        for (unsigned j = 0; j < BUFFER_SIZE; j++)
+        streamFence();
+    }
+
+    // this handles the last flush of remaining buffer elements to memory
+    for (int i = 0; i < bins; i++)
+    {
+        unsigned int cnt = Local_Hist[i];
+        unsigned int cnt2 = cnt - cnt%BUF;
+        if (cnt2 < start_cnt[i]) cnt2 = start_cnt[i];
+        for (unsigned int j = cnt2; j < cnt; j++)
         {
-            if (cnt > (cnt2+j) && ((cnt2 + j) >= start_cnt[i]))
-            {
-                Y[cnt2+j] = Dest[i*BUFFER_SIZE + j];
-                V[cnt2+j] = vDest[i*BUFFER_SIZE + j];
-            }
+            Y[j] = Dest[i*BUF + j%BUF];
+            W[j] = vDest[i*BUF + j%BUF];
         }
     }
+}
 
-    // All code below is a repetition of the code above to handle a different
-    // element in a thread: as in Step1, we use 1 thread to work on two
-    // different blocks of inputs to improve Step1
-    for (unsigned i = 0; i < HIST_BINS; i++)
+// ****************************************************************************
+// Function: radixPrepare
+//
+// Purpose:
+//   Converts floating point keys to their order-preserving bit patterns
+//   and finds the bits in which keys differ from the first key; only those
+//   need sorting.  Sets s.low and s.high to the lowest and highest varying
+//   bit (s.high < 0 if all keys are equal).
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void radixPrepare(RadixSort<K,V> &s, long id, long start, long end)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    Bits first = RadixKey<K>::toBits(*(K *)s.keys[0]);
+    Bits diff = 0;
+    _BARRIER_;
+    if (RadixKey<K>::flip)
     {
-        steady_state[i] = 0;
-        start_cnt[i] = Local_Hist2[i];
+        K *in = (K *)s.keys[0];
+        for (long i = start; i < end; i++)
+        {
+            Bits b = RadixKey<K>::toBits(in[i]);
+            s.keys[0][i] = b;
+            diff |= b ^ first;
+        }
     }
-
-    for (i=0; i < ((ending_element_id - starting_element_id)>>1); i+=STEP_SIZE)
+    else
     {
-        tmpLocal[0:16] = (X_start_2[i:16]>>(phase*LOG_HIST_BINS))&and_mask;
-        tmpLocal[16:16] = (X_start_2[i+16:16]>>(phase*LOG_HIST_BINS))&and_mask;
-
-
-        for (unsigned j = 0; j < STEP_SIZE; j++)
+        for (long i = start; i < end; i++)
         {
-            unsigned int in = X_start_2[i+j];
-            unsigned int vin = Z_start_2[i+j];
-            unsigned int index = tmpLocal[j];//LOOKUP(in);
-            unsigned int cnt = Local_Hist2[index]++;
-            Dest[index*BUFFER_SIZE + cnt%BUFFER_SIZE] = in;
-            vDest[index*BUFFER_SIZE + cnt%BUFFER_SIZE] = vin;
-
-            if (cnt%BUFFER_SIZE == BUFFER_SIZE_1)
-            {
-                unsigned int * Y_start = Y + cnt - BUFFER_SIZE_1;
-                unsigned int * V_start = V + cnt - BUFFER_SIZE_1;
-
-                if (steady_state[index])
-                {
-                    Y_start[0:16]= Dest[index*BUFFER_SIZE:16];
-                    V_start[0:16]= vDest[index*BUFFER_SIZE:16];
-                }
-                else
-                {
-                    steady_state[index] = 1;
-
-                    unsigned int m1 =
-                            mask_constants[start_cnt[index]%BUFFER_SIZE];
-
-                    #pragma unroll(16)
-                    for (int k=0;k<16;k++)
-                    {
-                        if ((m1&(1<<k)))
-                        {
-                            Y_start[k] = Dest[k+index*BUFFER_SIZE];
-                            V_start[k] = vDest[k+index*BUFFER_SIZE];
-                        }
-                    }
-                }
-            }
+            diff |= s.keys[0][i] ^ first;
         }
     }
+    s.Masks[id] = diff;
+    _BARRIER_;
 
-
-
-    for (unsigned i = 0; i < HIST_BINS; i++)
+    if (id == 0)
     {
-        int cnt = Local_Hist2[i];
-        int cnt2 = cnt - cnt%BUFFER_SIZE;
-        for (unsigned j = 0; j < BUFFER_SIZE; j++)
+        diff = 0;
+        for (int i = 0; i < Thread; i++)
         {
-            if (cnt > (cnt2+j) && ((cnt2 + j) >= start_cnt[i]))
+            diff |= s.Masks[i];
+        }
+        s.low = 0;
+        s.high = -1;
+        for (int b = 0; b < (int)sizeof(Bits)*8; b++)
+        {
+            if ((diff >> b) & 1)
             {
-                Y[cnt2+j] = Dest[i*BUFFER_SIZE + j];
-                V[cnt2+j] = vDest[i*BUFFER_SIZE + j];
+                if (s.high < 0) s.low = b;
+                s.high = b;
             }
         }
     }
     _BARRIER_;
+}
 
-#ifdef DEBUG
-    if (id==0)
+// ****************************************************************************
+// Function: radixAlloc, radixFree
+//
+// Purpose:
+//   Allocate and free the histograms and scatter buffers for the digit
+//   width in s; called by one thread
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void radixAlloc(RadixSort<K,V> &s)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    const int BUF = RadixSort<K,V>::BUF;
+    s.passesRun = 0;
+    s.skip = 0;
+    s.Hist = (unsigned int *)my_malloc(Thread*2*s.bins*
+            sizeof(unsigned int));
+
+    // The sub-histograms are used while they take at most half of the cache
+    // budget
+    s.lanes = s.bins*HIST_LANES*sizeof(unsigned int) <= s.cacheBytes / 2;
+    if (s.lanes)
     {
-        printf("PHASE3: OUTPUT1\n");fflush(0);
-        for (i=0;i<128;i++){
-            printf("%u ", Y[i]);fflush(0);}
-        printf("\n");fflush(0);
+        s.Sub = (unsigned int *)my_malloc((long)Thread*s.bins*HIST_LANES*
+                sizeof(unsigned int));
     }
-#endif
 
+    // Streaming stores pay off when the output is larger than the caches of
+    // all threads, and need line aligned arrays
+    long bytes = s.numElements * (sizeof(Bits) + sizeof(V));
+    s.streaming = s.buffered && bytes > Thread * s.cacheBytes &&
+                  ((size_t)s.keys[0] | (size_t)s.keys[1] |
+                   (size_t)s.values[0] | (size_t)s.values[1]) %
+                  LINE_BYTES == 0;
+    if (s.buffered)
+    {
+        s.Start = (unsigned int *)my_malloc(Thread*s.bins*
+                sizeof(unsigned int));
+        s.Buf = (Bits *)my_malloc(Thread*s.bins*BUF*sizeof(Bits));
+        s.vBuf = (V *)my_malloc(Thread*s.bins*BUF*sizeof(V));
+    }
 }
 
-int ntasks;
-int ntasks_per_thread;
+template <class K, class V>
+__declspec(target(mic))
+void radixFree(RadixSort<K,V> &s)
+{
+    _mm_free(s.Hist);
+    if (s.lanes)
+    {
+        _mm_free(s.Sub);
+    }
+    if (s.buffered)
+    {
+        _mm_free(s.Start);
+        _mm_free(s.Buf);
+        _mm_free(s.vBuf);
+    }
+}
 
+// ****************************************************************************
+// Function: radixPasses
+//
+// Purpose:
+//   Runs the s.passes LSD passes from bit s.low, skipping passes whose
+//   digit is the same for all keys
+//
+// Returns:  index in s.keys/s.values of the array holding the result
+//
+// ****************************************************************************
+template <class K, class V>
 __declspec(target(mic))
-void *sort(void *id)
+int radixPasses(RadixSort<K,V> &s, long id, long start, long end)
 {
-    for (int phase=0;phase<4;phase++)
+    typedef typename RadixKey<K>::Bits Bits;
+    long half = (end - start) >> 1;
+    int src = 0;
+    for (int pass = 0; pass < s.passes; pass++)
     {
-        if (id==0)
+        int shift = s.low + pass * s.bits;
+        Bits *X = s.keys[src], *Y = s.keys[1-src];
+        V *Z = s.values[src], *W = s.values[1-src];
+        unsigned int *Local_Hist = s.Hist + 2*s.bins*id;
+
+        // The steps end in barriers, so thread 0 times the whole step
+        double t = omp_get_wtime();
+        Step1_Histogram(s, id, shift, X);
+        if (id == 0) StepTime[0] += omp_get_wtime() - t;
+        Step2_Offsets(s, id, pass);
+        if (s.skip == pass + 1)
         {
-            for (int i = 0; i < (HIST_BINS)*ntasks*2; i++)
-            {
-                Hist[i] = 0;
-            }
-        }
-        // NB: There is a bug in the code. Only works for phase 0
-        Step1_Phase1((long)id, phase);
-        Step2_Phase1((long)id, phase);
-        Step3_Buffer_Phase1((long)id, phase);
-        if (id==0)
-        {
-            pingpong=X; X=Y; Y=pingpong;
-            pingpong=Z; Z=V; V=pingpong;
+            continue;
         }
+        t = omp_get_wtime();
+        Step3_Scatter(s, id, shift, X + start, Z + start, half,
+                      Local_Hist, Y, W);
+        Step3_Scatter(s, id, shift, X + start + half, Z + start + half,
+                      end - start - half, Local_Hist + s.bins, Y, W);
+        _BARRIER_;
+        if (id == 0) StepTime[1] += omp_get_wtime() - t;
+        src = 1 - src;
+        if (id == 0) s.passesRun++;
     }
-    pthread_exit(NULL);
+    return src;
 }
 
-template <class T>
+// ****************************************************************************
+// Function: radixFinish
+//
+// Purpose:
+//   Moves a thread's range of the sorted elements from s.keys[src] to the
+//   output arrays s.keys[1], converting floating point keys back
+//
+// ****************************************************************************
+template <class K, class V>
 __declspec(target(mic))
-extern void sortKernelMIC(T* hkey, T* hvalue, T* outkey, T* outvalue,
-        const size_t N, int numThreads)
+void radixFinish(RadixSort<K,V> &s, int src, long start, long end)
 {
-    tdata.numElements = N;
-
-    ntasks = Thread = numThreads;
-    if (Thread > MAX_WORKER) {
-        printf("Cannot create more than %d threads\n", MAX_WORKER);
-        exit(1);
-    }
-    // read in tasks_per_thread for taskQ
-    // The +64 is for alignment reasons to ensure that L1 bank conflicts dont occur
-    if ( (N/ntasks)%64 != 0)
+    typedef typename RadixKey<K>::Bits Bits;
+    Bits *R = s.keys[src];
+    if (RadixKey<K>::flip)
     {
-        global_elements_per_task = ((N/ntasks)/64)*64 + 64 + 64;
+        K *out = (K *)s.keys[1];
+        for (long i = start; i < end; i++)
+        {
+            out[i] = RadixKey<K>::fromBits(R[i]);
+        }
     }
-    else
+    else if (src == 0)
     {
-        global_elements_per_task = (N/ntasks) + 64;
+        memcpy(s.keys[1] + start, R + start, (end - start)*sizeof(Bits));
     }
-    // For affinity
-
-    // Allocate data
-    X =  hkey;
-    Y =  outkey;
-    Z =  hvalue;
-    V = outvalue; //(unsigned int *)my_malloc(N*sizeof(unsigned int));
-    Hist = (unsigned int *)my_malloc(ntasks*2*(HIST_BINS)*sizeof(unsigned int));
-    Buf = (unsigned int *)my_malloc(Thread*HIST_BINS*BUFFER_SIZE*
-            sizeof(unsigned int));
-    vBuf = (unsigned int *)my_malloc(Thread*HIST_BINS*BUFFER_SIZE*
-            sizeof(unsigned int));
-    tmp = (unsigned int *)my_malloc(Thread*32*sizeof(unsigned int));
-    masks = (unsigned int *)my_malloc(16*sizeof(unsigned int));
-
-    // Initialize data
-    for (unsigned i = 0; i < 16; i++)
+    if (src == 0)
     {
-        masks[i] = (1<<i);
+        memcpy(s.values[1] + start, s.values[0] + start,
+               (end - start)*sizeof(V));
     }
+}
 
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-#ifdef AFFINITIZE
-    pthread_aff_mask_t aff_mask;
-    pthread_aff_mask_initialize_np(&aff_mask, 0);
-#endif
+template <class K, class V>
+__declspec(target(mic))
+void sortThread(void *arg, long id)
+{
+    RadixSort<K,V> &s = *(RadixSort<K,V> *)arg;
 
+    long start = id * s.elementsPerTask;
+    long end = start + s.elementsPerTask;
+    if (start > s.numElements) start = s.numElements;
+    if (end > s.numElements) end = s.numElements;
+
+    radixPrepare(s, id, start, end);
+    if (id == 0)
     {
-        for (int i = 0; i < (HIST_BINS)*ntasks*2; i++)
+        if (s.high < 0)
         {
-            Hist[i] = 0;
+            s.bits = 0;
+            s.bins = 1;
+            s.passes = 0;
+            s.buffered = 0;
         }
-        for (long i=1; i<Thread; i++)
+        else
         {
-#ifdef AFFINITIZE
-            pthread_aff_mask_set_np(&aff_mask, 0, i+(MAX_THREAD-MAX_WORKER));
-            pthread_attr_aff_set_np(&attr, aff_mask);
-#endif
-            tdata.tid = i;
-            pthread_create(&th[i], &attr, (void *(*)(void *))sort, (void *) i);
-#ifdef AFFINITIZE
-            pthread_aff_mask_clear_np(&aff_mask, 0, i+(MAX_THREAD-MAX_WORKER));
-#endif
+            chooseDigits(s, s.high - s.low + 1);
         }
-#ifdef AFFINITIZE
-        pthread_aff_mask_set_np(&aff_mask, 0, (MAX_THREAD-MAX_WORKER));
-        pthread_attr_aff_set_np(&attr, aff_mask);
-#endif
-        tdata.tid = 0;
-        tdata.numElements=N;
-        pthread_create(&th[0], &attr, (void *(*)(void *))sort, (void *) 0);
-#ifdef AFFINITIZE
-        pthread_aff_mask_clear_np(&aff_mask, 0, (MAX_THREAD-MAX_WORKER));
-#endif
+        radixAlloc(s);
+    }
+    _BARRIER_;
+
+    int src = radixPasses(s, id, start, end);
+
+    // The sorted elements go to the output arrays
+    radixFinish(s, src, start, end);
+}
+
+// ****************************************************************************
+// Function: sortKernelMIC
+//
+// Purpose:
+//   Sorts key-value pairs by key with LSD radix sort.  Only the key bits
+//   that vary are sorted, with the digit width chosen by chooseDigits
+//   unless digitBits is given, and passes whose digit is the same for all
+//   keys are skipped.  The input arrays are used as scratch space; the
+//   sorted pairs are returned in outkey/outvalue.
+//
+// Arguments:
+//   hkey, hvalue: input keys and values
+//   outkey, outvalue: output - sorted keys and values
+//   N: number of elements
+//   numThreads: number of sort threads
+//   digitBits: digit width, 0 to choose adaptively
+//   cacheKB: per-thread cache budget for the histograms and buffers
+//   info: output - digit width, passes and passes run (may be NULL)
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void sortKernelMIC(K* hkey, V* hvalue, K* outkey, V* outvalue,
+        const size_t N, int numThreads, int digitBits, int cacheKB, int *info)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    RadixSort<K,V> s;
+
+    Thread = numThreads;
+    if (Thread > MAX_WORKER) {
+        printf("Cannot create more than %d threads\n", MAX_WORKER);
+        exit(1);
     }
-    for (int i=1; i<Thread; i++)
+    // Ranges are multiples of 64 elements so that each thread starts on a
+    // cache line
+    s.elementsPerTask = (((N + Thread - 1) / Thread) + 63) & ~63;
+    s.numElements = N;
+    s.forceBits = digitBits;
+    s.cacheBytes = cacheKB * 1024L;
+
+    s.keys[0] = (Bits *)hkey;
+    s.keys[1] = (Bits *)outkey;
+    s.values[0] = hvalue;
+    s.values[1] = outvalue;
+    s.Sums = (unsigned int *)my_malloc(Thread*sizeof(unsigned int));
+    s.Masks = (Bits *)my_malloc(Thread*sizeof(Bits));
+    StepTime[0] = StepTime[1] = 0;
+
+    runPool(Thread, sortThread<K,V>, &s);
+
+    if (info)
     {
-        int ret;
-        pthread_join(th[i], (void **)&ret);
+        info[0] = s.bits;
+        info[1] = s.passes;
+        info[2] = s.passesRun;
     }
-    int ret;
-    pthread_join(th[0], (void**)&ret);
-
-    memcpy(hkey,Y,N*sizeof(T));
 
-    _mm_free(Hist);
-    _mm_free(Buf);
-    _mm_free(tmp);
-    _mm_free(masks);
+    radixFree(s);
+    _mm_free(s.Sums);
+    _mm_free(s.Masks);
 
     return;
 }
@@ -622,18 +858,21 @@ extern void sortKernelMIC(T* hkey, T* hvalue, T* outkey, T* outvalue,
 #pragma offload_attribute(pop)
 
 
-template <class T>
+template <class K, class V>
 __declspec(target(mic))
-extern void sortKernel(T* hkey, T* hvalue, T* outkey, T* outvalue,
-        const size_t n, int numThreads)
+extern void sortKernel(K* hkey, V* hvalue, K* outkey, V* outvalue,
+        const size_t n, int numThreads, int digitBits, int cacheKB,
+        int *info)
 {
     if (numThreads > MAX_WORKER)
     {
         printf("numthreads > Max Workers\n");
         return;
     }
-    // sorted output placed in hvalue
-    sortKernelMIC(hkey,  hvalue, outkey, outvalue, n, numThreads);
+    // sorted output placed in outkey and outvalue
+    sortKernelMIC(hkey,  hvalue, outkey, outvalue, n, numThreads, digitBits,
+                  cacheKB, info);
     return;
 }
 
+#endif // SORT_KERNEL_H_
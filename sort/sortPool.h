@@ -0,0 +1,346 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: sortPool.h
+//
+// Purpose:
+//   Persistent, pinned worker pool and dissemination barrier used by the
+//   sort kernels.  The workers are created once and reused by every sort
+//   with the same thread count; the calling thread is worker 0.  The
+//   barrier takes log2(threads) rounds in which every thread signals one
+//   partner and waits for another, each flag on its own cache line, so no
+//   thread polls all the others and waiting threads do not share lines.
+//
+// ****************************************************************************
+
+#ifndef SORT_POOL_H_
+#define SORT_POOL_H_
+
+#pragma offload_attribute(push,target(mic))
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include <omp.h>
+
+#define MAX_WORKER      512
+#define MAX_ROUNDS      10      // ceil(log2(MAX_WORKER)) + 1
+#define CACHE_LINE      64
+
+// Spins before a waiting thread backs off to the scheduler, so that
+// oversubscribed or idle threads give up their hardware thread
+#define SPIN_YIELD      64
+#define SPIN_MAX_DELAY  64
+
+#ifdef __MIC__
+#define SPIN_PAUSE(n) _mm_delay_32(n)
+#else
+#define SPIN_PAUSE(n) for (int _p = 0; _p < (n); _p++) _mm_pause()
+#endif
+
+// One barrier flag per cache line
+struct BarrierFlag
+{
+    volatile unsigned int epoch;
+    char pad[CACHE_LINE - sizeof(unsigned int)];
+};
+
+// Per-thread barrier state: the flags the thread's partners set in each
+// round, and the number of barriers the thread has passed
+struct BarrierThread
+{
+    BarrierFlag flag[MAX_ROUNDS];
+    unsigned int epoch;
+    char pad[CACHE_LINE - sizeof(unsigned int)];
+};
+
+__declspec(align(64)) BarrierThread barrierState[MAX_WORKER];
+int barrierThreads = 0;
+int barrierRounds = 0;
+
+// ****************************************************************************
+// Function: spinWait
+//
+// Purpose:
+//   Waits until *flag reaches epoch with exponential backoff between
+//   polls, yielding the processor after SPIN_YIELD polls
+//
+// ****************************************************************************
+inline void spinWait(volatile unsigned int *flag, unsigned int epoch)
+{
+    int delay = 1;
+    for (int spins = 0; (int)(*flag - epoch) < 0; spins++)
+    {
+        if (spins >= SPIN_YIELD)
+        {
+            sched_yield();
+        }
+        else
+        {
+            SPIN_PAUSE(delay);
+            if (delay < SPIN_MAX_DELAY) delay <<= 1;
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: barrierInit
+//
+// Purpose:
+//   Resets the barrier for a team of numThreads threads
+//
+// ****************************************************************************
+inline void barrierInit(int numThreads)
+{
+    barrierThreads = numThreads;
+    barrierRounds = 0;
+    while ((1 << barrierRounds) < numThreads)
+    {
+        barrierRounds++;
+    }
+    for (int i = 0; i < MAX_WORKER; i++)
+    {
+        barrierState[i].epoch = 0;
+        for (int r = 0; r < MAX_ROUNDS; r++)
+        {
+            barrierState[i].flag[r].epoch = 0;
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: barrier
+//
+// Purpose:
+//   Dissemination barrier.  In round r thread id signals thread
+//   id + 2^r and waits for thread id - 2^r; after the last round every
+//   thread has transitively heard from all the others.  Epochs only grow,
+//   so a partner that is already in the next barrier cannot be missed.
+//
+// ****************************************************************************
+inline void barrier(long id)
+{
+    unsigned int epoch = ++barrierState[id].epoch;
+    for (int r = 0; r < barrierRounds; r++)
+    {
+        long partner = (id + (1L << r)) % barrierThreads;
+        __sync_synchronize();
+        barrierState[partner].flag[r].epoch = epoch;
+        spinWait(&barrierState[id].flag[r].epoch, epoch);
+    }
+    __sync_synchronize();
+}
+
+// ****************************************************************************
+// Struct: SortPool
+//
+// Purpose:
+//   The worker pool.  A job is published by bumping generation under the
+//   lock; idle workers sleep on the condition variable.  Every job ends
+//   with a barrier, so when runPool returns all workers are done.
+//
+// ****************************************************************************
+typedef void (*PoolJob)(void *arg, long id);
+
+struct SortPool
+{
+    int size;
+    pthread_t th[MAX_WORKER];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    unsigned int generation;
+    PoolJob job;
+    void *arg;
+    int quit;
+};
+
+SortPool sortPool = { 0 };
+
+// ****************************************************************************
+// Function: pinThread
+//
+// Purpose:
+//   Pins worker id of a pool of size threads, spreading the pool evenly
+//   over the online processors and leaving processor 0 to the OS
+//
+// ****************************************************************************
+inline void pinThread(long id, int size)
+{
+#ifdef CPU_SET
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 2)
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(1 + (id * (ncpu - 1)) / size, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+inline void *poolWorker(void *arg)
+{
+    long id = (long)arg;
+    unsigned int seen = 0;
+    pinThread(id, sortPool.size);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&sortPool.lock);
+        while (sortPool.generation == seen && !sortPool.quit)
+        {
+            pthread_cond_wait(&sortPool.wake, &sortPool.lock);
+        }
+        seen = sortPool.generation;
+        PoolJob job = sortPool.job;
+        void *jobArg = sortPool.arg;
+        int quit = sortPool.quit;
+        pthread_mutex_unlock(&sortPool.lock);
+
+        if (quit)
+        {
+            return NULL;
+        }
+        job(jobArg, id);
+        barrier(id);
+    }
+}
+
+// ****************************************************************************
+// Function: poolStop
+//
+// Purpose:
+//   Joins the workers of the pool
+//
+// ****************************************************************************
+inline void poolStop()
+{
+    if (sortPool.size == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&sortPool.lock);
+    sortPool.quit = 1;
+    pthread_cond_broadcast(&sortPool.wake);
+    pthread_mutex_unlock(&sortPool.lock);
+    for (int i = 1; i < sortPool.size; i++)
+    {
+        pthread_join(sortPool.th[i], NULL);
+    }
+    pthread_mutex_destroy(&sortPool.lock);
+    pthread_cond_destroy(&sortPool.wake);
+    sortPool.size = 0;
+}
+
+// ****************************************************************************
+// Function: runPool
+//
+// Purpose:
+//   Runs job(arg, id) on numThreads threads, the caller being thread 0,
+//   and returns when all of them are done.  The pool is created on first
+//   use and recreated when the thread count changes.
+//
+// ****************************************************************************
+inline void runPool(int numThreads, PoolJob job, void *arg)
+{
+    if (sortPool.size != numThreads)
+    {
+        poolStop();
+        barrierInit(numThreads);
+        pthread_mutex_init(&sortPool.lock, NULL);
+        pthread_cond_init(&sortPool.wake, NULL);
+        sortPool.generation = 0;
+        sortPool.quit = 0;
+        sortPool.size = numThreads;
+        for (long i = 1; i < numThreads; i++)
+        {
+            pthread_create(&sortPool.th[i], NULL, poolWorker, (void *)i);
+        }
+    }
+
+    pthread_mutex_lock(&sortPool.lock);
+    sortPool.job = job;
+    sortPool.arg = arg;
+    sortPool.generation++;
+    pthread_cond_broadcast(&sortPool.wake);
+    pthread_mutex_unlock(&sortPool.lock);
+
+    job(arg, 0);
+    barrier(0);
+}
+
+// ****************************************************************************
+// Function: barrierLatency
+//
+// Purpose:
+//   Measures the average time of one barrier on a pool of numThreads
+//   threads, in microseconds
+//
+// ****************************************************************************
+struct LatencyJob
+{
+    int iters;
+    double seconds;
+};
+
+inline void latencyJob(void *arg, long id)
+{
+    LatencyJob *l = (LatencyJob *)arg;
+    barrier(id);
+    double start = omp_get_wtime();
+    for (int i = 0; i < l->iters; i++)
+    {
+        barrier(id);
+    }
+    if (id == 0)
+    {
+        l->seconds = omp_get_wtime() - start;
+    }
+}
+
+inline double barrierLatency(int numThreads, int iters)
+{
+    LatencyJob l;
+    l.iters = iters;
+    l.seconds = 0;
+    runPool(numThreads, latencyJob, &l);
+    return l.seconds / iters * 1e6;
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SORT_POOL_H_
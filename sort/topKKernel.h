@@ -0,0 +1,378 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC,
+//    nor the names of its contributors may be used to endorse or promote
+//    products derived from this software without specific prior written
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: topKKernel.h
+//
+// Purpose:
+//   Top-k / partial sort: returns the k smallest key-value pairs in sorted
+//   order without sorting the whole array.  A radix select finds the k-th
+//   smallest key one digit at a time from the most significant varying
+//   bit; after each digit only the keys that share the selected prefix
+//   are kept, so later digits read few keys.  The keys below the k-th are
+//   then compacted, in input order, and sorted, and enough keys equal to
+//   it are appended to make k.  Ties keep their input order.
+//
+// ****************************************************************************
+
+#ifndef TOPK_KERNEL_H_
+#define TOPK_KERNEL_H_
+
+#pragma offload_attribute(push,target(mic))
+
+#include "msdSortKernel.h"
+
+// Digit width of the radix select
+#define SELECT_BITS         11
+
+// ****************************************************************************
+// Struct: TopK
+//
+// Purpose:
+//   State shared by the top-k threads
+//
+// ****************************************************************************
+template <class K, class V>
+struct TopK
+{
+    typedef typename RadixKey<K>::Bits Bits;
+
+    MsdSort<K,V> m;             // m.part: whole array, m.sub: final sort
+    long k;
+    int bits;                   // select digit width
+    int passesRun;
+    unsigned int *Hist;         // per-thread select histograms
+    long *Offset;               // per-thread output offsets
+    Bits *cand[2];              // keys sharing the selected prefix
+    long candN;
+    long firstCand;             // candidates after the first step
+    Bits kth;                   // the k-th smallest key
+    long below;                 // keys smaller than kth
+};
+
+// ****************************************************************************
+// Function: selectDigit
+//
+// Purpose:
+//   One radix select step on bits shift..shift+width-1 of the n candidate
+//   keys X: finds the digit of the k-th smallest candidate and keeps the
+//   candidates with that digit in t.cand[c], in order
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void selectDigit(TopK<K,V> &t, long id, int shift, int width,
+                 const typename RadixKey<K>::Bits *X, long n,
+                 int c)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    const int bins = 1 << width;
+    const unsigned int mask = bins - 1;
+    long per = (n + Thread - 1) / Thread;
+    long start = id * per;
+    long end = start + per;
+    if (start > n) start = n;
+    if (end > n) end = n;
+
+    unsigned int *Local_Hist = t.Hist + (long)id * (1 << t.bits);
+    memset(Local_Hist, 0, bins * sizeof(unsigned int));
+    for (long i = start; i < end; i++)
+    {
+        Local_Hist[(unsigned int)(X[i] >> shift) & mask]++;
+    }
+    _BARRIER_;
+
+    if (id == 0)
+    {
+        // Find the digit of the k-th smallest candidate; the keys before
+        // it in digit order are all below the k-th smallest key
+        long rank = t.k - t.below;
+        long sum = 0;
+        int digit = 0;
+        for (; digit < bins; digit++)
+        {
+            long c = 0;
+            for (int j = 0; j < Thread; j++)
+            {
+                c += t.Hist[(long)j * (1 << t.bits) + digit];
+            }
+            if (sum + c >= rank)
+            {
+                break;
+            }
+            sum += c;
+        }
+        t.below += sum;
+        long off = 0;
+        for (int j = 0; j < Thread; j++)
+        {
+            t.Offset[j] = off;
+            off += t.Hist[(long)j * (1 << t.bits) + digit];
+        }
+        t.Offset[Thread] = digit;
+        t.candN = off;
+        if (t.passesRun++ == 0)
+        {
+            // the first step bounds the candidates of all later steps
+            t.firstCand = off;
+            t.cand[0] = (Bits *)my_malloc(off * sizeof(Bits));
+            t.cand[1] = (Bits *)my_malloc(off * sizeof(Bits));
+        }
+    }
+    _BARRIER_;
+
+    Bits *Y = t.cand[c];
+    unsigned int digit = t.Offset[Thread];
+    long pos = t.Offset[id];
+    for (long i = start; i < end; i++)
+    {
+        Bits x = X[i];
+        if (((unsigned int)(x >> shift) & mask) == digit)
+        {
+            Y[pos++] = x;
+        }
+    }
+    _BARRIER_;
+}
+
+template <class K, class V>
+__declspec(target(mic))
+void topKThread(void *arg, long id)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    TopK<K,V> &t = *(TopK<K,V> *)arg;
+    MsdSort<K,V> &m = t.m;
+    RadixSort<K,V> &s = m.part;
+
+    long start = id * s.elementsPerTask;
+    long end = start + s.elementsPerTask;
+    if (start > s.numElements) start = s.numElements;
+    if (end > s.numElements) end = s.numElements;
+
+    radixPrepare(s, id, start, end);
+
+    // Select the k-th smallest key from the most significant varying digit
+    // down.  The first step reads the whole array, the next ones only the
+    // keys with the selected prefix.
+    const Bits *X = s.keys[0];
+    long n = s.numElements;
+    int c = 0;
+    for (int top = s.high; top >= s.low; top -= t.bits)
+    {
+        int shift = top + 1 - t.bits;
+        if (shift < s.low)
+        {
+            shift = s.low;
+        }
+        selectDigit(t, id, shift, top - shift + 1, X, n, c);
+        X = t.cand[c];
+        n = t.candN;
+        c = 1 - c;
+    }
+    if (id == 0)
+    {
+        t.kth = (s.high < 0 || n == 0) ? s.keys[0][0] : X[0];
+    }
+    _BARRIER_;
+
+    // Compact the keys below the k-th smallest, in input order, and the
+    // first k - below keys equal to it
+    Bits kth = t.kth;
+    long lt = 0, eq = 0;
+    const Bits *In = s.keys[0];
+    for (long i = start; i < end; i++)
+    {
+        lt += In[i] < kth;
+        eq += In[i] == kth;
+    }
+    t.Offset[2*id] = lt;
+    t.Offset[2*id+1] = eq;
+    _BARRIER_;
+    if (id == 0)
+    {
+        long ltSum = 0, eqSum = 0;
+        for (int j = 0; j < Thread; j++)
+        {
+            long l = t.Offset[2*j], e = t.Offset[2*j+1];
+            t.Offset[2*j] = ltSum;
+            t.Offset[2*j+1] = eqSum;
+            ltSum += l;
+            eqSum += e;
+        }
+        t.below = ltSum;
+    }
+    _BARRIER_;
+    Bits *Out = s.keys[1];
+    V *Outv = s.values[1];
+    const V *Inv = s.values[0];
+    long ltPos = t.Offset[2*id];
+    long eqPos = t.Offset[2*id+1];
+    for (long i = start; i < end; i++)
+    {
+        Bits x = In[i];
+        if (x < kth)
+        {
+            Out[ltPos] = x;
+            Outv[ltPos++] = Inv[i];
+        }
+        else if (x == kth && eqPos < t.k - t.below)
+        {
+            Out[t.below + eqPos] = x;
+            Outv[t.below + eqPos++] = Inv[i];
+        }
+        else if (x == kth)
+        {
+            eqPos++;
+        }
+    }
+    _BARRIER_;
+
+    // Sort the keys below the k-th, using the input as scratch; the keys
+    // equal to it are already in input order
+    long below = t.below;
+    if (below > m.largeBucket)
+    {
+        cooperativeSort(m, id, Out, Outv, s.keys[0], s.values[0], below,
+                        s.low, s.high);
+    }
+    else if (id == 0 && s.high >= 0)
+    {
+        localRadixSort(Out, Outv, s.keys[0], s.values[0], below, s.low,
+                       s.high);
+    }
+    _BARRIER_;
+
+    // Floating point keys are converted back in place
+    long per = (((t.k + Thread - 1) / Thread) + 63) & ~63;
+    long kstart = id * per;
+    long kend = kstart + per;
+    if (kstart > t.k) kstart = t.k;
+    if (kend > t.k) kend = t.k;
+    radixFinish(s, 1, kstart, kend);
+}
+
+// ****************************************************************************
+// Function: topKKernel
+//
+// Purpose:
+//   Returns the k smallest key-value pairs, sorted by key, in the first k
+//   elements of outkey/outvalue.  The input arrays are used as scratch
+//   space.
+//
+// Arguments:
+//   hkey, hvalue: input keys and values
+//   outkey, outvalue: output - the k smallest pairs in sorted order
+//   N: number of elements
+//   k: number of elements to return, at most N
+//   numThreads: number of threads
+//   cacheKB: per-thread cache budget, sets the serial/parallel cut-off of
+//            the final sort
+//   info: output - select digit width, select steps run, candidates
+//         after the first step (may be NULL)
+//
+// ****************************************************************************
+template <class K, class V>
+__declspec(target(mic))
+void topKKernel(K* hkey, V* hvalue, K* outkey, V* outvalue,
+        const size_t N, long k, int numThreads, int cacheKB, long *info)
+{
+    typedef typename RadixKey<K>::Bits Bits;
+    TopK<K,V> t;
+    MsdSort<K,V> &m = t.m;
+    RadixSort<K,V> &s = m.part;
+
+    if (numThreads > MAX_WORKER)
+    {
+        printf("numthreads > Max Workers\n");
+        return;
+    }
+    if (k <= 0 || N == 0)
+    {
+        return;
+    }
+    if (k > (long)N)
+    {
+        k = N;
+    }
+    Thread = numThreads;
+    s.elementsPerTask = (((N + Thread - 1) / Thread) + 63) & ~63;
+    s.numElements = N;
+    s.forceBits = 0;
+    s.cacheBytes = cacheKB * 1024L;
+
+    s.keys[0] = (Bits *)hkey;
+    s.keys[1] = (Bits *)outkey;
+    s.values[0] = hvalue;
+    s.values[1] = outvalue;
+    s.Sums = (unsigned int *)my_malloc(Thread*sizeof(unsigned int));
+    s.Masks = (Bits *)my_malloc(Thread*sizeof(Bits));
+
+    // The final sort runs on all threads when it does not fit in the
+    // cache budget of one
+    long elemBytes = sizeof(Bits) + sizeof(V);
+    m.largeBucket = s.cacheBytes / (2 * elemBytes);
+
+    t.k = k;
+    t.bits = SELECT_BITS;
+    t.passesRun = 0;
+    t.below = 0;
+    t.candN = 0;
+    t.firstCand = 0;
+    t.Hist = (unsigned int *)my_malloc((long)Thread * (1 << t.bits) *
+                                       sizeof(unsigned int));
+    t.Offset = (long *)my_malloc((2*Thread + 1) * sizeof(long));
+
+    runPool(Thread, topKThread<K,V>, &t);
+
+    if (info)
+    {
+        info[0] = t.bits;
+        info[1] = t.passesRun;
+        info[2] = t.firstCand;
+    }
+
+    if (t.passesRun)
+    {
+        _mm_free(t.cand[0]);
+        _mm_free(t.cand[1]);
+    }
+    _mm_free(t.Hist);
+    _mm_free(t.Offset);
+    _mm_free(s.Sums);
+    _mm_free(s.Masks);
+}
+
+#pragma offload_attribute(pop)
+
+#endif // TOPK_KERNEL_H_
@@ -0,0 +1,338 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_BLOCK_CSR_H_
+#define SPMV_BLOCK_CSR_H_
+
+// ****************************************************************************
+// File:  BlockCSR.h
+//
+// Purpose:
+//   Register blocked CSR (BCSR) storage for the Spmv benchmark.  The matrix
+//   is tiled into dense BxB blocks; only blocks holding at least one
+//   nonzero are stored, row-major within the block, with one column index
+//   per block.  Explicit zeros are stored to fill partially occupied
+//   blocks, the ratio of stored to true nonzeros is the fill ratio.
+//
+//   All routines assume the column indices within a CSR row are sorted,
+//   which holds for readMatrix and the generators in util.h.
+//
+// ****************************************************************************
+
+#pragma offload_attribute(push,target(mic))
+
+#include <string.h>
+
+// largest block size with a specialized kernel
+#define BCSR_MAX_BLOCK 4
+
+// ****************************************************************************
+// Function: bcsrCountBlocks
+//
+// Purpose:
+//   Counts the distinct BxB blocks touched by one block row by merging the
+//   (sorted) column lists of its rows.
+//
+// Arguments:
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   blockRow: index of the block row
+//   B: block size
+//   blockCols: optional output - block column of every block found
+//
+// Returns:  number of blocks in the block row
+//
+// ****************************************************************************
+inline int bcsrCountBlocks(const int *cols, const int *rowDelimiters, int dim,
+                           int blockRow, int B, int *blockCols = NULL)
+{
+    int pos[BCSR_MAX_BLOCK], end[BCSR_MAX_BLOCK];
+    int nRows = (blockRow*B + B <= dim) ? B : dim - blockRow*B;
+    for (int r=0; r<nRows; r++)
+    {
+        pos[r] = rowDelimiters[blockRow*B + r];
+        end[r] = rowDelimiters[blockRow*B + r + 1];
+    }
+
+    int nBlocks = 0;
+    while (true)
+    {
+        // smallest block column not yet consumed in any of the rows
+        int bc = -1;
+        for (int r=0; r<nRows; r++)
+        {
+            if (pos[r] < end[r] && (bc < 0 || cols[pos[r]] / B < bc))
+            {
+                bc = cols[pos[r]] / B;
+            }
+        }
+        if (bc < 0)
+        {
+            break;
+        }
+        for (int r=0; r<nRows; r++)
+        {
+            while (pos[r] < end[r] && cols[pos[r]] / B == bc)
+            {
+                pos[r]++;
+            }
+        }
+        if (blockCols)
+        {
+            blockCols[nBlocks] = bc;
+        }
+        nBlocks++;
+    }
+    return nBlocks;
+}
+
+// ****************************************************************************
+// Function: bcsrEstimateFill
+//
+// Purpose:
+//   Estimates the fill ratio (stored values / true nonzeros) for block
+//   size B by converting every sampleStride-th block row.
+//
+// Arguments:
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   B: block size
+//   sampleStride: take one block row out of sampleStride
+//
+// Returns:  estimated fill ratio (>= 1)
+//
+// ****************************************************************************
+inline double bcsrEstimateFill(const int *cols, const int *rowDelimiters,
+                               int dim, int B, int sampleStride)
+{
+    int nBlockRows = (dim + B - 1) / B;
+    long nnz = 0, stored = 0;
+
+    #pragma omp parallel for reduction(+:nnz,stored)
+    for (int ib=0; ib<nBlockRows; ib+=sampleStride)
+    {
+        int last = (ib*B + B <= dim) ? ib*B + B : dim;
+        nnz += rowDelimiters[last] - rowDelimiters[ib*B];
+        stored += (long)B * B * bcsrCountBlocks(cols, rowDelimiters, dim,
+                                                ib, B);
+    }
+    return (nnz > 0) ? (double)stored / (double)nnz : 1.0;
+}
+
+// ****************************************************************************
+// Function: bcsrChooseBlock
+//
+// Purpose:
+//   Picks the block size (1 = stay with CSR) that minimizes the estimated
+//   matrix traffic per true nonzero, fill * (value bytes + index bytes per
+//   stored value).  SpMV is bandwidth bound so this is a fair proxy for
+//   run time.
+//
+// Arguments:
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   valSize: size in bytes of a stored value
+//   fill: output - estimated fill ratio of the chosen block size
+//
+// Returns:  block size between 1 and BCSR_MAX_BLOCK
+//
+// ****************************************************************************
+inline int bcsrChooseBlock(const int *cols, const int *rowDelimiters, int dim,
+                           int valSize, double *fill)
+{
+    // sample about 1 in 16 block rows, all of them for small matrices
+    int sampleStride = (dim > 16384) ? 16 : 1;
+
+    int best = 1;
+    double bestBytes = valSize + sizeof(int);
+    *fill = 1.0;
+    for (int B=2; B<=BCSR_MAX_BLOCK; B++)
+    {
+        double f = bcsrEstimateFill(cols, rowDelimiters, dim, B,
+                                    sampleStride);
+        double bytes = f * (valSize + (double)sizeof(int) / (B * B));
+        if (bytes < bestBytes)
+        {
+            best = B;
+            bestBytes = bytes;
+            *fill = f;
+        }
+    }
+    return best;
+}
+
+// ****************************************************************************
+// Function: convertToBlocked
+//
+// Purpose:
+//   Converts a CSR matrix into BCSR format with BxB blocks.
+//
+// Arguments:
+//   A: array holding the non-zero values for the matrix
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   newA_ptr: output - pointer to the block values, B*B per block
+//   blockCols_ptr: output - pointer to the block column of every block
+//   blockRowDelimiters: input - buffer of size ceil(dim/B)+1
+//                       output - indices to the first block of every
+//                       block row
+//   nBlocks: output - number of stored blocks
+//
+// Returns:  nothing directly
+//           allocates and returns *newA_ptr and *blockCols_ptr
+// ****************************************************************************
+template <typename floatType, int B>
+void convertToBlocked(const floatType *A, const int *cols,
+                      const int *rowDelimiters, int dim, floatType **newA_ptr,
+                      int **blockCols_ptr, int *blockRowDelimiters,
+                      int *nBlocks)
+{
+    int nBlockRows = (dim + B - 1) / B;
+
+    #pragma omp parallel for
+    for (int ib=0; ib<nBlockRows; ib++)
+    {
+        blockRowDelimiters[ib+1] = bcsrCountBlocks(cols, rowDelimiters, dim,
+                                                   ib, B);
+    }
+    blockRowDelimiters[0] = 0;
+    for (int ib=0; ib<nBlockRows; ib++)
+    {
+        blockRowDelimiters[ib+1] += blockRowDelimiters[ib];
+    }
+    *nBlocks = blockRowDelimiters[nBlockRows];
+
+    *newA_ptr = ALLOC(floatType, (size_t)*nBlocks * B * B);
+    *blockCols_ptr = ALLOC(int, *nBlocks);
+    floatType *newA = *newA_ptr;
+    int *blockCols = *blockCols_ptr;
+
+    #pragma omp parallel for
+    for (int ib=0; ib<nBlockRows; ib++)
+    {
+        int first = blockRowDelimiters[ib];
+        int n = bcsrCountBlocks(cols, rowDelimiters, dim, ib, B,
+                                blockCols + first);
+        memset(newA + (size_t)first * B * B, 0,
+               (size_t)n * B * B * sizeof(floatType));
+
+        // block columns are sorted, walk each row along them
+        for (int r=0; r<B && ib*B + r < dim; r++)
+        {
+            int k = first;
+            for (int j=rowDelimiters[ib*B + r];
+                 j<rowDelimiters[ib*B + r + 1]; j++)
+            {
+                while (blockCols[k] != cols[j] / B)
+                {
+                    k++;
+                }
+                newA[(size_t)k*B*B + r*B + cols[j] % B] = A[j];
+            }
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: spmvBlocked
+//
+// Purpose:
+//   Sparse matrix vector multiplication on a BCSR matrix.  The block size
+//   is a template parameter so the block loop is fully unrolled: each
+//   block is multiplied as one B*B wide vector operation against the
+//   matching slice of vec (for 4x4 in single precision exactly one 512 bit
+//   vector), and the per-row sums are formed once per block row.
+//
+// Arguments:
+//   val: block values, B*B per block, row-major within the block
+//   blockCols: block column of every block
+//   blockRowDelimiters: array of size nBlockRows+1 holding indices to the
+//                       first block of every block row
+//   vec: dense vector padded to nBlockRows*B with zeros
+//   nBlockRows: number of block rows
+//   out: output - result padded to nBlockRows*B
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType, int B>
+void spmvBlocked(const floatType *val, const int *blockCols,
+                 const int *blockRowDelimiters, const floatType *vec,
+                 int nBlockRows, floatType *out)
+{
+    #pragma omp parallel for
+    for (int ib=0; ib<nBlockRows; ib++)
+    {
+        __declspec(align(64)) floatType acc[B*B];
+
+        #pragma simd
+        for (int e=0; e<B*B; e++)
+        {
+            acc[e] = 0;
+        }
+
+        for (int k=blockRowDelimiters[ib]; k<blockRowDelimiters[ib+1]; k++)
+        {
+            const floatType *a = val + (size_t)k * B * B;
+            const floatType *x = vec + blockCols[k] * B;
+
+            #pragma unroll
+            #pragma simd
+            for (int e=0; e<B*B; e++)
+            {
+                acc[e] += a[e] * x[e % B];
+            }
+        }
+
+        #pragma unroll
+        for (int r=0; r<B; r++)
+        {
+            floatType t = 0;
+            #pragma unroll
+            for (int c=0; c<B; c++)
+            {
+                t += acc[r*B + c];
+            }
+            out[ib*B + r] = t;
+        }
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SPMV_BLOCK_CSR_H_
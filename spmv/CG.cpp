@@ -0,0 +1,551 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+// ****************************************************************************
+// File: CG.cpp
+//
+// Purpose:
+//   Conjugate gradient solver benchmark built on the Spmv CSR kernels and
+//   matrix loaders.  SpMV is interleaved with the dot products and vector
+//   updates of an actual solve, which re-read the vectors every iteration.
+//   The solver is run twice: once with every operation as its own sweep,
+//   and once with the operations fused (SpMV with the p'Ap dot product,
+//   both AXPYs with the r'r dot product) to measure the saved traffic.
+//
+// ****************************************************************************
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "omp.h"
+
+#include "OptionParser.h"
+#include "ResultDatabase.h"
+#include "Timer.h"
+#include "util.h"
+#include "SpmvKernel.h"
+#include "SymmetricCSR.h"
+
+using namespace std;
+
+// ****************************************************************************
+// Function: addBenchmarkSpecOptions
+//
+// Purpose:
+//   Add benchmark specific options parsing.
+//
+// Arguments:
+//   op: the options parser / parameter database
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+void addBenchmarkSpecOptions(OptionParser &op)
+{
+    op.addOption("iterations", OPT_INT, "500", "Maximum number of CG "
+                 "iterations per solve");
+    op.addOption("tolerance", OPT_FLOAT, "1e-6", "Relative residual at "
+                 "which the solve stops");
+    op.addOption("mm_filename", OPT_STRING, "random", "Name of file "
+                 "which stores the matrix in Matrix Market format");
+    op.addOption("maxval", OPT_FLOAT, "10", "Maximum value for random "
+                 "matrices");
+    addMatrixOptions(op);
+    op.addOption("spd_input", OPT_BOOL, "", "Use the Matrix Market matrix "
+                 "as is (it must be symmetric positive definite)");
+    op.addOption("padded", OPT_BOOL, "", "Use the padded CSR layout");
+}
+
+// ****************************************************************************
+// Function: makeSPD
+//
+// Purpose:
+//   Turns a CSR matrix into a symmetric positive definite one: the strict
+//   upper triangle is mirrored into the lower triangle and the diagonal is
+//   set to the absolute off-diagonal row sum plus one, which makes the
+//   matrix strictly diagonally dominant.
+//
+// Arguments:
+//   val_ptr, cols_ptr, rowDelimiters_ptr: input - the CSR matrix
+//                                         output - the SPD matrix, the input
+//                                         arrays are freed
+//   nItems: output - number of non-zero elements of the new matrix
+//   dim: number of rows/columns in the matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void makeSPD(floatType **val_ptr, int **cols_ptr, int **rowDelimiters_ptr,
+             int *nItems, int dim)
+{
+    floatType *val = *val_ptr;
+    int *cols = *cols_ptr;
+    int *rowDelimiters = *rowDelimiters_ptr;
+
+    // strict upper triangle, with a diagonal slot at the front of each row
+    int *upperDelimiters = ALLOC(int, dim+1);
+    int nUpper = 0;
+    for (int i=0; i<dim; i++)
+    {
+        upperDelimiters[i] = nUpper++;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] > i)
+            {
+                nUpper++;
+            }
+        }
+    }
+    upperDelimiters[dim] = nUpper;
+
+    floatType *upperVal = ALLOC(floatType, nUpper);
+    int *upperCols = ALLOC(int, nUpper);
+    for (int i=0; i<dim; i++)
+    {
+        int k = upperDelimiters[i];
+        upperVal[k] = 0;
+        upperCols[k++] = i;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] > i)
+            {
+                upperVal[k] = val[j];
+                upperCols[k++] = cols[j];
+            }
+        }
+    }
+    FREE(val);
+    FREE(cols);
+    FREE(rowDelimiters);
+
+    rowDelimiters = ALLOC(int, dim+1);
+    convertUpperToFull(upperVal, upperCols, upperDelimiters, dim, &val,
+                       &cols, rowDelimiters, nItems);
+    FREE(upperVal);
+    FREE(upperCols);
+    FREE(upperDelimiters);
+
+    for (int i=0; i<dim; i++)
+    {
+        int diag = -1;
+        double sum = 1.0;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] == i)
+            {
+                diag = j;
+            }
+            else
+            {
+                sum += fabs(val[j]);
+            }
+        }
+        val[diag] = (floatType)sum;
+    }
+
+    *val_ptr = val;
+    *cols_ptr = cols;
+    *rowDelimiters_ptr = rowDelimiters;
+}
+
+// ****************************************************************************
+// Function: dotMic, axpyMic, xpayMic
+//
+// Purpose:
+//   Vector kernels of the unfused solver: x'y, y = y + a*x and
+//   y = x + a*y, each one sweep over its vectors
+// ****************************************************************************
+template <typename floatType>
+__declspec(target(mic)) floatType dotMic(const floatType *x,
+        const floatType *y, int dim)
+{
+    floatType dot = 0;
+    #pragma omp parallel for reduction(+:dot)
+    for (int i=0; i<dim; i++)
+    {
+        dot += x[i] * y[i];
+    }
+    return dot;
+}
+
+template <typename floatType>
+__declspec(target(mic)) void axpyMic(floatType a, const floatType *x,
+        floatType *y, int dim)
+{
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+template <typename floatType>
+__declspec(target(mic)) void xpayMic(const floatType *x, floatType a,
+        floatType *y, int dim)
+{
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        y[i] = x[i] + a * y[i];
+    }
+}
+
+// ****************************************************************************
+// Function: cgMic
+//
+// Purpose:
+//   Solves A*x = b with unpreconditioned conjugate gradient, starting from
+//   x = 0.  Every operation is a separate sweep.
+//
+// Arguments:
+//   val, cols, rowDelimiters: the SPD matrix in (padded) CSR format
+//   b: right hand side
+//   dim: number of rows/columns in the matrix
+//   x: output - solution
+//   r, p, q: scratch vectors of size dim
+//   maxIters: iteration limit
+//   tol: relative residual at which to stop
+//   residual: output - relative residual of the last iteration
+//
+// Returns:  number of iterations done
+//
+// ****************************************************************************
+template <typename floatType>
+__declspec(target(mic)) int cgMic(const floatType *val, const int *cols,
+        const int *rowDelimiters, const floatType *b, int dim, floatType *x,
+        floatType *r, floatType *p, floatType *q, int maxIters, double tol,
+        double *residual)
+{
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        x[i] = 0;
+        r[i] = b[i];
+        p[i] = b[i];
+    }
+    floatType rr = dotMic(r, r, dim);
+    double bb = rr;
+
+    int it;
+    for (it = 0; it < maxIters && rr > tol * tol * bb; it++)
+    {
+        spmvMic(val, cols, rowDelimiters, p, dim, q);
+        floatType alpha = rr / dotMic(p, q, dim);
+        axpyMic(alpha, p, x, dim);
+        axpyMic(-alpha, q, r, dim);
+        floatType rrNew = dotMic(r, r, dim);
+        xpayMic(r, rrNew / rr, p, dim);
+        rr = rrNew;
+    }
+    *residual = sqrt(rr / bb);
+    return it;
+}
+
+// ****************************************************************************
+// Function: cgFusedMic
+//
+// Purpose:
+//   Same solve as cgMic with the vector operations fused: the SpMV sweep
+//   also forms p'Ap, and one sweep updates x and r and forms r'r.
+//
+// Arguments:
+//   see cgMic
+//
+// Returns:  number of iterations done
+//
+// ****************************************************************************
+template <typename floatType>
+__declspec(target(mic)) int cgFusedMic(const floatType *val, const int *cols,
+        const int *rowDelimiters, const floatType *b, int dim, floatType *x,
+        floatType *r, floatType *p, floatType *q, int maxIters, double tol,
+        double *residual)
+{
+    floatType rr = 0;
+    #pragma omp parallel for reduction(+:rr)
+    for (int i=0; i<dim; i++)
+    {
+        x[i] = 0;
+        r[i] = b[i];
+        p[i] = b[i];
+        rr += b[i] * b[i];
+    }
+    double bb = rr;
+
+    int it;
+    for (it = 0; it < maxIters && rr > tol * tol * bb; it++)
+    {
+        floatType alpha = rr / spmvDotMic(val, cols, rowDelimiters, p, dim,
+                                          q);
+        floatType rrNew = 0;
+        #pragma omp parallel for reduction(+:rrNew)
+        for (int i=0; i<dim; i++)
+        {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            rrNew += r[i] * r[i];
+        }
+        xpayMic(r, rrNew / rr, p, dim);
+        rr = rrNew;
+    }
+    *residual = sqrt(rr / bb);
+    return it;
+}
+
+// ****************************************************************************
+// Function: trueResidual
+//
+// Purpose:
+//   Computes ||b - A*x|| / ||b|| on the host in double precision to verify
+//   the solution independent of the recurrence used by the solver.
+//
+// ****************************************************************************
+template <typename floatType>
+double trueResidual(const floatType *val, const int *cols,
+                    const int *rowDelimiters, const floatType *b,
+                    const floatType *x, int dim)
+{
+    double rr = 0, bb = 0;
+    for (int i=0; i<dim; i++)
+    {
+        double t = 0;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            t += (double)val[j] * x[cols[j]];
+        }
+        rr += (b[i] - t) * (b[i] - t);
+        bb += (double)b[i] * b[i];
+    }
+    return sqrt(rr / bb);
+}
+
+// ****************************************************************************
+// Function: RunTest
+//
+// Purpose:
+//   Runs the unfused and fused CG solvers on the MIC card and reports time
+//   per iteration, achieved bandwidth, iterations and final residual.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunTest(ResultDatabase &resultDB, OptionParser &op, int nRows)
+{
+    __declspec(target(mic)) static floatType *h_val, *h_b, *h_x;
+    __declspec(target(mic)) static floatType *h_r, *h_p, *h_q;
+    __declspec(target(mic)) static int *h_cols, *h_rowDelimiters;
+    __declspec(target(mic)) static int nItems, numRows;
+
+    initMatrix(op, nRows, &h_val, &h_cols, &h_rowDelimiters, &nItems,
+               &numRows);
+    if (!op.getOptionBool("spd_input") ||
+        op.getOptionString("mm_filename") == "random")
+    {
+        makeSPD(&h_val, &h_cols, &h_rowDelimiters, &nItems, numRows);
+    }
+
+    const char *format = "csr";
+    if (op.getOptionBool("padded"))
+    {
+        floatType *valPad;
+        int *colsPad;
+        int *rowDelimitersPad = ALLOC(int, numRows+1);
+        int nItemsPadded;
+        convertToPadded(h_val, h_cols, numRows, h_rowDelimiters, &valPad,
+                        &colsPad, rowDelimitersPad, &nItemsPadded);
+        FREE(h_val);
+        FREE(h_cols);
+        FREE(h_rowDelimiters);
+        h_val = valPad;
+        h_cols = colsPad;
+        h_rowDelimiters = rowDelimitersPad;
+        nItems = nItemsPadded;
+        format = "padded";
+    }
+
+    h_b = ALLOC(floatType, numRows);
+    h_x = ALLOC(floatType, numRows);
+    h_r = ALLOC(floatType, numRows);
+    h_p = ALLOC(floatType, numRows);
+    h_q = ALLOC(floatType, numRows);
+    fill(h_b, numRows, op.getOptionFloat("maxval"));
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int maxIters = op.getOptionInt("iterations");
+    double tol = op.getOptionFloat("tolerance");
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows_%s", nItems, numRows, format);
+
+    // Memory traffic of one iteration: the matrix once, plus the vector
+    // sweeps (in units of one vector) of each solver
+    double matrixBytes = (sizeof(floatType) + sizeof(int)) * (double)nItems +
+                         sizeof(int) * (numRows + 1.0);
+    double vecBytes = sizeof(floatType) * (double)numRows;
+    // spmv 2, p'q 2, x 3, r 3, r'r 1, p 3
+    double gbUnfused = (matrixBytes + 14 * vecBytes) / 1e9;
+    // spmv+p'q 2, x/r/r'r 6, p 3
+    double gbFused = (matrixBytes + 11 * vecBytes) / 1e9;
+
+    cout << "CG-" << (dpTest ? "DP" : "SP") << " Test (" << format << ")\n";
+
+    #pragma offload target(mic:micdev) \
+        in(h_cols:length(nItems)              free_if(0)) \
+        in(h_rowDelimiters:length(numRows+1)  free_if(0)) \
+        in(h_val:length(nItems)               free_if(0)) \
+        in(h_b:length(numRows)                free_if(0)) \
+        nocopy(h_x:length(numRows)            free_if(0)) \
+        nocopy(h_r:length(numRows)            free_if(0)) \
+        nocopy(h_p:length(numRows)            free_if(0)) \
+        nocopy(h_q:length(numRows)            free_if(0))
+    { }
+
+    for (int k = 0; k < passes; k++)
+    {
+        for (int fused = 0; fused < 2; fused++)
+        {
+            int iters = 0;
+            double residual = 0;
+
+            double solveTime = curr_second();
+            #pragma offload target(mic:micdev) \
+                in(numRows, maxIters, tol, fused) out(iters, residual) \
+                nocopy(h_cols:length(nItems)             alloc_if(0) free_if(0)) \
+                nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+                nocopy(h_val:length(nItems)              alloc_if(0) free_if(0)) \
+                nocopy(h_b:length(numRows)               alloc_if(0) free_if(0)) \
+                nocopy(h_x:length(numRows)               alloc_if(0) free_if(0)) \
+                nocopy(h_r:length(numRows)               alloc_if(0) free_if(0)) \
+                nocopy(h_p:length(numRows)               alloc_if(0) free_if(0)) \
+                nocopy(h_q:length(numRows)               alloc_if(0) free_if(0))
+            {
+                if (fused)
+                {
+                    iters = cgFusedMic(h_val, h_cols, h_rowDelimiters, h_b,
+                                       numRows, h_x, h_r, h_p, h_q, maxIters,
+                                       tol, &residual);
+                }
+                else
+                {
+                    iters = cgMic(h_val, h_cols, h_rowDelimiters, h_b,
+                                  numRows, h_x, h_r, h_p, h_q, maxIters, tol,
+                                  &residual);
+                }
+            }
+            solveTime = curr_second() - solveTime;
+
+            #pragma offload target(mic:micdev) \
+                out(h_x:length(numRows) alloc_if(0) free_if(0))
+            { }
+
+            double trueRes = trueResidual(h_val, h_cols, h_rowDelimiters,
+                                          h_b, h_x, numRows);
+            cout << "Pass " << k << (fused ? " fused: " : ": ") << iters
+                 << " iterations, residual " << residual << ", true "
+                 << "residual " << trueRes << ": ";
+            if (iters == 0 || trueRes > 100 * tol)
+            {
+                cout << "---FAILED---" << endl;
+                continue;
+            }
+            cout << "Passed" << endl;
+
+            string name = string(fused ? "CGfused-" : "CG-") +
+                          (dpTest ? "DP" : "SP");
+            double iterTime = solveTime / iters;
+            resultDB.AddResult(name, atts, "ms/iter", iterTime * 1e3);
+            resultDB.AddResult(name + "_Bandwidth", atts, "GB/s",
+                               (fused ? gbFused : gbUnfused) / iterTime);
+            resultDB.AddResult(name + "_Iterations", atts, "N", iters);
+            resultDB.AddResult(name + "_Residual", atts, "rel", trueRes);
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(h_cols:length(nItems)             alloc_if(0) free_if(1)) \
+        nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(h_val:length(nItems)              alloc_if(0) free_if(1)) \
+        nocopy(h_b:length(numRows)               alloc_if(0) free_if(1)) \
+        nocopy(h_x:length(numRows)               alloc_if(0) free_if(1)) \
+        nocopy(h_r:length(numRows)               alloc_if(0) free_if(1)) \
+        nocopy(h_p:length(numRows)               alloc_if(0) free_if(1)) \
+        nocopy(h_q:length(numRows)               alloc_if(0) free_if(1))
+    { }
+
+    FREE(h_val);
+    FREE(h_cols);
+    FREE(h_rowDelimiters);
+    FREE(h_b);
+    FREE(h_x);
+    FREE(h_r);
+    FREE(h_p);
+    FREE(h_q);
+}
+
+// ****************************************************************************
+// Function: RunBenchmark
+//
+// Purpose:
+//   Executes the conjugate gradient benchmark
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+void
+RunBenchmark(OptionParser &op, ResultDatabase &resultDB)
+{
+    // Same problem sizes as Spmv
+    int probSizes[4] = {1024, 8192, 12288, 16384};
+    int sizeClass = op.getOptionInt("size") - 1;
+
+    cout << "Single precision tests:\n";
+    RunTest<float> (resultDB, op, probSizes[sizeClass]);
+
+    cout << "Double precision tests:\n";
+    RunTest<double> (resultDB, op, probSizes[sizeClass]);
+}
@@ -0,0 +1,365 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_COMPRESSED_CSR_H_
+#define SPMV_COMPRESSED_CSR_H_
+
+// ****************************************************************************
+// File:  CompressedCSR.h
+//
+// Purpose:
+//   Index and value compressed CSR (CCSR) storage for the Spmv benchmark.
+//   Column indices are delta encoded within each row into 8 or 16 bit
+//   deltas.  A delta that does not fit is replaced by an escape code (the
+//   largest representable delta) and its full value is kept in a separate
+//   escape stream, so the delta stream stays fixed width.  Values can be
+//   kept in full precision or reduced to fp16 / bf16, which are expanded
+//   back to fp32 in registers by the kernel.
+//
+// ****************************************************************************
+
+#pragma offload_attribute(push,target(mic))
+
+#include <string.h>
+
+// number of nonzeros decoded per block in the CCSR kernel (one 512 bit
+// vector of fp32)
+#define CCSR_BLOCK 16
+
+// IEEE 754 binary16 storage
+struct half_t
+{
+    unsigned short bits;
+};
+
+// bfloat16 storage (upper half of an IEEE 754 binary32)
+struct bfloat16_t
+{
+    unsigned short bits;
+};
+
+union floatBits
+{
+    float f;
+    unsigned int u;
+};
+
+// ****************************************************************************
+// Function: toFloat
+//
+// Purpose:
+//   Expands a stored matrix value to the accumulation type.  The fp16 path
+//   is branch free so that it vectorizes: the exponent/mantissa bits are
+//   moved into place and rebiased with a single multiply, which also
+//   normalizes fp16 subnormals.
+//
+// ****************************************************************************
+inline float toFloat(float v)   { return v; }
+inline double toFloat(double v) { return v; }
+
+inline float toFloat(bfloat16_t v)
+{
+    floatBits b;
+    b.u = ((unsigned int)v.bits) << 16;
+    return b.f;
+}
+
+inline float toFloat(half_t v)
+{
+    floatBits b;
+    unsigned int em = v.bits & 0x7fff;
+    b.u = em << 13;
+    b.f *= 5.192296858534828e+33f;  // 2^(127-15)
+    b.u |= (em >= 0x7c00) ? (255u << 23) : 0;  // inf / nan
+    b.u |= ((unsigned int)(v.bits & 0x8000)) << 16;
+    return b.f;
+}
+
+// ****************************************************************************
+// Function: fromFloat
+//
+// Purpose:
+//   Rounds a value to the storage type (round to nearest even).
+//
+// ****************************************************************************
+inline void fromFloat(double v, float *out)  { *out = (float)v; }
+inline void fromFloat(double v, double *out) { *out = v; }
+
+inline void fromFloat(double v, bfloat16_t *out)
+{
+    floatBits b;
+    b.f = (float)v;
+    if ((b.u & 0x7fffffff) > 0x7f800000)
+    {
+        // keep nans quiet rather than rounding them to infinity
+        out->bits = (unsigned short)((b.u >> 16) | 0x40);
+        return;
+    }
+    b.u += 0x7fff + ((b.u >> 16) & 1);
+    out->bits = (unsigned short)(b.u >> 16);
+}
+
+inline void fromFloat(double v, half_t *out)
+{
+    floatBits b;
+    b.f = (float)v;
+    unsigned int sign = (b.u >> 16) & 0x8000;
+    unsigned int absu = b.u & 0x7fffffff;
+    unsigned short h;
+
+    if (absu >= 0x7f800000)
+    {
+        // inf or nan
+        h = (absu > 0x7f800000) ? 0x7e00 : 0x7c00;
+    }
+    else if (absu >= 0x477ff000)
+    {
+        // rounds beyond the largest half, saturate to infinity
+        h = 0x7c00;
+    }
+    else if (absu < 0x38800000)
+    {
+        // fp16 subnormal: let the fp32 adder do the rounding by adding
+        // 0.5, which aligns the mantissa to the fp16 subnormal grid
+        floatBits t;
+        t.u = absu;
+        t.f += 0.5f;
+        h = (unsigned short)(t.u - 0x3f000000);
+    }
+    else
+    {
+        unsigned int odd = (absu >> 13) & 1;
+        absu += 0xc8000fff + odd;  // rebias exponent and round
+        h = (unsigned short)(absu >> 13);
+    }
+    out->bits = (unsigned short)(h | sign);
+}
+
+// ****************************************************************************
+// Function: ccsrCountEscapes
+//
+// Purpose:
+//   Counts the number of deltas in a CSR matrix that do not fit in an
+//   index of the given width, used to pick the delta width and to size
+//   the escape stream.
+//
+// Arguments:
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   bits: width of the encoded deltas (8 or 16)
+//
+// Returns:  number of escaped deltas
+//
+// ****************************************************************************
+inline long ccsrCountEscapes(const int *cols, const int *rowDelimiters,
+                             int dim, int bits)
+{
+    const int escape = (1 << bits) - 1;
+    long nEscapes = 0;
+
+    #pragma omp parallel for reduction(+:nEscapes)
+    for (int i=0; i<dim; i++)
+    {
+        int prev = 0;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] - prev >= escape)
+            {
+                nEscapes++;
+            }
+            prev = cols[j];
+        }
+    }
+    return nEscapes;
+}
+
+// ****************************************************************************
+// Function: ccsrChooseBits
+//
+// Purpose:
+//   Picks the delta width (8 or 16 bits) that gives the smaller index
+//   stream, counting 4 bytes for every escaped delta.
+//
+// Returns:  8 or 16
+//
+// ****************************************************************************
+inline int ccsrChooseBits(const int *cols, const int *rowDelimiters, int dim)
+{
+    long nItems = rowDelimiters[dim];
+    long bytes8  = nItems * 1 + 4 * ccsrCountEscapes(cols, rowDelimiters,
+                                                     dim, 8);
+    long bytes16 = nItems * 2 + 4 * ccsrCountEscapes(cols, rowDelimiters,
+                                                     dim, 16);
+    return (bytes8 <= bytes16) ? 8 : 16;
+}
+
+// ****************************************************************************
+// Function: convertToCompressed
+//
+// Purpose:
+//   Converts a CSR matrix into CCSR format.  Row delimiters are shared with
+//   the CSR matrix, only the column and value arrays are replaced.
+//
+// Arguments:
+//   A: array holding the non-zero values for the matrix
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   newA: output - buffer of size rowDelimiters[dim], values in storage
+//         precision
+//   deltas: output - buffer of size rowDelimiters[dim], encoded deltas
+//   escapes: output - buffer sized by ccsrCountEscapes, full deltas for
+//            every escape code in deltas
+//   escDelimiters: output - buffer of size dim+1 holding indices to the
+//                  first escape of each row
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType, typename valType, typename deltaType>
+void convertToCompressed(const floatType *A, const int *cols,
+                         const int *rowDelimiters, int dim, valType *newA,
+                         deltaType *deltas, int *escapes, int *escDelimiters)
+{
+    const int escape = (1 << (8 * sizeof(deltaType))) - 1;
+
+    // escape offsets per row; serial scan over the row counts
+    escDelimiters[0] = 0;
+    for (int i=0; i<dim; i++)
+    {
+        int prev = 0, nEsc = 0;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] - prev >= escape)
+            {
+                nEsc++;
+            }
+            prev = cols[j];
+        }
+        escDelimiters[i+1] = escDelimiters[i] + nEsc;
+    }
+
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        int prev = 0;
+        int e = escDelimiters[i];
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            int delta = cols[j] - prev;
+            if (delta >= escape)
+            {
+                deltas[j] = (deltaType)escape;
+                escapes[e++] = delta;
+            }
+            else
+            {
+                deltas[j] = (deltaType)delta;
+            }
+            prev = cols[j];
+            fromFloat(A[j], &newA[j]);
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: spmvCompressed
+//
+// Purpose:
+//   Sparse matrix vector multiplication on a CCSR matrix.  Each row is
+//   processed in blocks of CCSR_BLOCK nonzeros: the deltas of a block are
+//   decoded to absolute columns in a small aligned buffer, then a vector
+//   loop expands the stored values and does the gather and multiply-add.
+//
+// Arguments:
+//   val: non-zero values in storage precision
+//   deltas: encoded column deltas
+//   escapes: full deltas for escaped entries
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   escDelimiters: array of size dim+1 holding indices into escapes
+//   vec: dense vector of size dim to be used for multiplication
+//   dim: number of rows in the matrix
+//   out: output - result from the spmv calculation
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType, typename valType, typename deltaType>
+void spmvCompressed(const valType *val, const deltaType *deltas,
+                    const int *escapes, const int *rowDelimiters,
+                    const int *escDelimiters, const floatType *vec, int dim,
+                    floatType *out)
+{
+    const int escape = (1 << (8 * sizeof(deltaType))) - 1;
+
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        __declspec(align(64)) int col[CCSR_BLOCK];
+        floatType t = 0;
+        int crnt = 0;
+        int e = escDelimiters[i];
+        int end = rowDelimiters[i+1];
+
+        for (int j=rowDelimiters[i]; j<end; j+=CCSR_BLOCK)
+        {
+            int n = (end - j < CCSR_BLOCK) ? end - j : CCSR_BLOCK;
+
+            // decode: running sum of the deltas, scalar but register bound
+            #pragma novector
+            for (int k=0; k<n; k++)
+            {
+                int d = deltas[j+k];
+                if (d == escape)
+                {
+                    d = escapes[e++];
+                }
+                crnt += d;
+                col[k] = crnt;
+            }
+
+            #pragma simd reduction(+:t)
+            for (int k=0; k<n; k++)
+            {
+                t += toFloat(val[j+k]) * vec[col[k]];
+            }
+        }
+        out[i] = t;
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SPMV_COMPRESSED_CSR_H_
@@ -0,0 +1,436 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_NUMA_CSR_H_
+#define SPMV_NUMA_CSR_H_
+
+// ****************************************************************************
+// File:  NumaCSR.h
+//
+// Purpose:
+//   NUMA aware CSR layout for the host SpMV.  The rows are split across the
+//   NUMA nodes in blocks of equal nonzero count, and every node gets its
+//   own copy of its block, first touched by threads running on that node
+//   so the pages are allocated there.  The threads of a node split the
+//   node's block again by nonzero count.  The input vector can be
+//   replicated per node: every product first copies it into each node's
+//   replica, so the random reads of the vector stay local.
+//
+//   The nodes and their processors are read from /sys; without it, or
+//   when a node count is forced, the online processors are split evenly.
+//
+//   Pinning a thread to its node lasts for one parallel region only: the
+//   thread's previous affinity is restored at the end of the region, so
+//   OpenMP threads reused by later tests are not left pinned, and which
+//   OS thread runs OpenMP thread t does not matter.  spmvNuma runs all of
+//   its products in one region, so a thread is pinned once per call.
+//
+// ****************************************************************************
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <omp.h>
+
+#define NUMA_MAX_NODES 64
+
+// ****************************************************************************
+// Struct: NumaPin
+//
+// Purpose:
+//   Restricts the calling thread to a node's processors for its lifetime
+//   and restores the thread's previous affinity when destroyed
+//
+// ****************************************************************************
+struct NumaPin
+{
+#ifdef CPU_SET
+    cpu_set_t saved;
+    bool pinned;
+
+    NumaPin(const std::vector<int> &cpus, bool pin) : pinned(false)
+    {
+        if (pin && sched_getaffinity(0, sizeof(saved), &saved) == 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (size_t i=0; i<cpus.size(); i++)
+            {
+                CPU_SET(cpus[i], &set);
+            }
+            pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+        }
+    }
+
+    ~NumaPin()
+    {
+        if (pinned)
+        {
+            sched_setaffinity(0, sizeof(saved), &saved);
+        }
+    }
+#else
+    NumaPin(const std::vector<int> &, bool) {}
+#endif
+};
+
+// Seconds a thread spent in the products, alone on its cache line
+struct NumaTime
+{
+    double seconds;
+    char pad[64 - sizeof(double)];
+};
+
+// ****************************************************************************
+// Function: numaTopology
+//
+// Purpose:
+//   Finds the processors of every NUMA node.
+//
+// Arguments:
+//   forceNodes: number of nodes to split the processors into evenly, 0 to
+//               read the topology from /sys
+//   nodeCpus: output - the processors of every node
+//
+// Returns:  the number of nodes
+//
+// ****************************************************************************
+inline int numaTopology(int forceNodes,
+                        std::vector< std::vector<int> > &nodeCpus)
+{
+    nodeCpus.clear();
+    for (int n=0; forceNodes <= 0 && n<NUMA_MAX_NODES; n++)
+    {
+        char name[128];
+        sprintf(name, "/sys/devices/system/node/node%d/cpulist", n);
+        FILE *f = fopen(name, "r");
+        if (f == NULL)
+        {
+            continue;
+        }
+        // a list of ranges such as 0-7,16-23
+        std::vector<int> cpus;
+        int a, b;
+        while (fscanf(f, "%d", &a) == 1)
+        {
+            b = a;
+            int c = fgetc(f);
+            if (c == '-')
+            {
+                if (fscanf(f, "%d", &b) != 1)
+                {
+                    break;
+                }
+                c = fgetc(f);
+            }
+            for (int i=a; i<=b; i++)
+            {
+                cpus.push_back(i);
+            }
+            if (c != ',')
+            {
+                break;
+            }
+        }
+        fclose(f);
+        if (!cpus.empty())
+        {
+            nodeCpus.push_back(cpus);
+        }
+    }
+
+    if (nodeCpus.empty())
+    {
+        int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        int nodes = (forceNodes > 0) ? forceNodes : 1;
+        nodeCpus.resize(nodes);
+        for (int i=0; i<ncpu || i<nodes; i++)
+        {
+            nodeCpus[(long)i * nodes / (ncpu > nodes ? ncpu : nodes)]
+                .push_back(i % ncpu);
+        }
+    }
+    return nodeCpus.size();
+}
+
+// ****************************************************************************
+// Struct: NumaPart
+//
+// Purpose:
+//   The rows of one node, in memory first touched on the node
+//
+// ****************************************************************************
+template <typename floatType>
+struct NumaPart
+{
+    int row0, row1;             // rows of the block
+    floatType *val;
+    int *cols;
+    int *rowDelimiters;         // rebased to the block's first element
+    floatType *vec;             // replica of the input vector, or NULL
+    int nThreads;               // threads running on the node
+    int *threadRow;             // nThreads+1 row split within the block
+};
+
+// ****************************************************************************
+// Struct: NumaCSR
+//
+// Purpose:
+//   The matrix split over the nodes, and the thread to node map
+//
+// ****************************************************************************
+template <typename floatType>
+struct NumaCSR
+{
+    int nNodes;
+    int nThreads;
+    int numRows;
+    bool replicate;
+    bool pin;
+    std::vector< std::vector<int> > nodeCpus;
+    std::vector< NumaPart<floatType> > part;
+    std::vector<int> threadNode;    // node of every thread
+    std::vector<int> threadIndex;   // index of every thread on its node
+    NumaTime *threadTime;           // one line per thread
+    floatType *out;                 // result, rows first touched by node
+};
+
+// Clears the per-thread product times
+template <typename floatType>
+void numaResetTime(NumaCSR<floatType> &m)
+{
+    for (int t=0; t<m.nThreads; t++)
+    {
+        m.threadTime[t].seconds = 0;
+    }
+}
+
+// ****************************************************************************
+// Function: numaBuild
+//
+// Purpose:
+//   Splits a CSR matrix over the nodes and copies every node's block into
+//   memory first touched by the node's threads.
+//
+// Arguments:
+//   m: output - the NUMA layout
+//   val, cols, rowDelimiters: the matrix in CSR format
+//   numRows: number of rows in the matrix
+//   nodeCpus: the processors of every node, from numaTopology
+//   nThreads: total number of threads, spread evenly over the nodes
+//   replicate: keep a copy of the input vector on every node
+//   pin: restrict every thread to the processors of its node while it
+//        first touches its block here and while it multiplies in spmvNuma
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void numaBuild(NumaCSR<floatType> &m, const floatType *val, const int *cols,
+               const int *rowDelimiters, int numRows,
+               const std::vector< std::vector<int> > &nodeCpus,
+               int nThreads, bool replicate, bool pin)
+{
+    int nNodes = nodeCpus.size();
+    if (nThreads < nNodes)
+    {
+        nNodes = nThreads;
+    }
+    m.nNodes = nNodes;
+    m.nThreads = nThreads;
+    m.numRows = numRows;
+    m.replicate = replicate;
+    m.pin = pin;
+    m.nodeCpus = nodeCpus;
+    m.part.resize(nNodes);
+    m.threadNode.resize(nThreads);
+    m.threadIndex.resize(nThreads);
+    m.threadTime = ALLOC(NumaTime, nThreads);
+    numaResetTime(m);
+    m.out = ALLOC(floatType, numRows);
+
+    std::vector<int> nodeRow(nNodes+1);
+    partitionRows(rowDelimiters, numRows, nNodes, &nodeRow[0]);
+    for (int n=0; n<nNodes; n++)
+    {
+        m.part[n].row0 = nodeRow[n];
+        m.part[n].row1 = nodeRow[n+1];
+        m.part[n].nThreads = 0;
+    }
+    for (int t=0; t<nThreads; t++)
+    {
+        int n = (long)t * nNodes / nThreads;
+        m.threadNode[t] = n;
+        m.threadIndex[t] = m.part[n].nThreads++;
+    }
+
+    omp_set_dynamic(0);
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int t = omp_get_thread_num();
+        NumaPart<floatType> &p = m.part[m.threadNode[t]];
+        int lt = m.threadIndex[t];
+        NumaPin pinned(nodeCpus[m.threadNode[t]], pin);
+
+        // The first thread of a node allocates the block and splits it
+        // over the node's threads
+        int rows = p.row1 - p.row0;
+        int base = rowDelimiters[p.row0];
+        if (lt == 0)
+        {
+            int nnz = rowDelimiters[p.row1] - base;
+            p.val = ALLOC(floatType, nnz);
+            p.cols = ALLOC(int, nnz);
+            p.rowDelimiters = ALLOC(int, rows+1);
+            p.vec = replicate ? ALLOC(floatType, numRows) : NULL;
+            p.threadRow = ALLOC(int, p.nThreads+1);
+            for (int i=0; i<=rows; i++)
+            {
+                p.rowDelimiters[i] = rowDelimiters[p.row0 + i] - base;
+            }
+            partitionRows(p.rowDelimiters, rows, p.nThreads, p.threadRow);
+        }
+        #pragma omp barrier
+
+        // Every thread first touches what it will use
+        int r0 = p.threadRow[lt], r1 = p.threadRow[lt+1];
+        int j0 = p.rowDelimiters[r0], j1 = p.rowDelimiters[r1];
+        memcpy(p.val + j0, val + base + j0, (j1 - j0) * sizeof(floatType));
+        memcpy(p.cols + j0, cols + base + j0, (j1 - j0) * sizeof(int));
+        for (int i=r0; i<r1; i++)
+        {
+            m.out[p.row0 + i] = 0;
+        }
+        if (replicate)
+        {
+            int v0 = (long)numRows * lt / p.nThreads;
+            int v1 = (long)numRows * (lt + 1) / p.nThreads;
+            for (int i=v0; i<v1; i++)
+            {
+                p.vec[i] = 0;
+            }
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: numaFree
+//
+// Purpose:
+//   Frees the blocks and the timers of a NUMA layout
+//
+// ****************************************************************************
+template <typename floatType>
+void numaFree(NumaCSR<floatType> &m)
+{
+    for (int n=0; n<m.nNodes; n++)
+    {
+        FREE(m.part[n].val);
+        FREE(m.part[n].cols);
+        FREE(m.part[n].rowDelimiters);
+        FREE(m.part[n].threadRow);
+        if (m.part[n].vec)
+        {
+            FREE(m.part[n].vec);
+        }
+    }
+    FREE(m.out);
+    FREE(m.threadTime);
+}
+
+// ****************************************************************************
+// Function: spmvNuma
+//
+// Purpose:
+//   iters sparse matrix vector multiplications on the NUMA layout, in one
+//   parallel region so the threads are pinned once; the result is left in
+//   m.out.  Every thread adds the time it spends refreshing its part of
+//   the replica and on its rows to m.threadTime, cleared by numaResetTime.
+//
+// Arguments:
+//   m: the NUMA layout from numaBuild
+//   vec: dense vector of size numRows to be used for multiplication
+//   iters: number of products
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void spmvNuma(NumaCSR<floatType> &m, const floatType *vec, int iters)
+{
+    #pragma omp parallel num_threads(m.nThreads)
+    {
+        int t = omp_get_thread_num();
+        NumaPart<floatType> &p = m.part[m.threadNode[t]];
+        int lt = m.threadIndex[t];
+        NumaPin pinned(m.nodeCpus[m.threadNode[t]], m.pin);
+        const floatType *x = m.replicate ? p.vec : vec;
+        const floatType *val = p.val;
+        const int *cols = p.cols;
+        const int *rowDelimiters = p.rowDelimiters;
+        floatType *out = m.out + p.row0;
+
+        for (int k=0; k<iters; k++)
+        {
+            double start = omp_get_wtime();
+            if (m.replicate)
+            {
+                // the threads of a node copy the vector into its replica
+                int v0 = (long)m.numRows * lt / p.nThreads;
+                int v1 = (long)m.numRows * (lt + 1) / p.nThreads;
+                memcpy(p.vec + v0, vec + v0, (v1 - v0) * sizeof(floatType));
+                #pragma omp barrier
+            }
+
+            for (int i=p.threadRow[lt]; i<p.threadRow[lt+1]; i++)
+            {
+                floatType s = 0;
+                #pragma simd reduction(+:s)
+                for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+                {
+                    s += val[j] * x[cols[j]];
+                }
+                out[i] = s;
+            }
+            m.threadTime[t].seconds += omp_get_wtime() - start;
+
+            // the next product may overwrite the replica
+            #pragma omp barrier
+        }
+    }
+}
+
+#endif // SPMV_NUMA_CSR_H_
@@ -44,6 +44,12 @@
 #include "ResultDatabase.h"
 #include "Timer.h"
 #include "util.h"
+#include "SpmvKernel.h"
+#include "CompressedCSR.h"
+#include "BlockCSR.h"
+#include "SymmetricCSR.h"
+#include "TransposeCSR.h"
+#include "NumaCSR.h"
 
 using namespace std; 
 
@@ -72,74 +78,24 @@ void addBenchmarkSpecOptions(OptionParser &op)
                  "which stores the matrix in Matrix Market format"); 
     op.addOption("maxval", OPT_FLOAT, "10", "Maximum value for random "
                  "matrices");
-}
-
-// ****************************************************************************
-// Function: spmvCpu
-//
-// Purpose: 
-//   Runs sparse matrix vector multiplication on the CPU 
-//
-// Arguements: 
-//   val: array holding the non-zero values for the matrix
-//   cols: array of column indices for each element of A
-//   rowDelimiters: array of size dim+1 holding indices to rows of A; 
-//                  last element is the index one past the last
-//                  element of A
-//   vec: dense vector of size dim to be used for multiplication
-//   dim: number of rows/columns in the matrix
-//   out: input - buffer of size dim
-//        output - result from the spmv calculation 
-// 
-// Programmer: Lukasz Wesolowski
-// Creation: June 23, 2010
-// Returns:
-//   nothing directly
-//   out indirectly through a pointer
-// ****************************************************************************
-template <typename floatType>
-void spmvCpu(const floatType *val, const int *cols, const int *rowDelimiters, 
-         const floatType *vec, int dim, floatType *out) 
-{
-
-    for (int i=0; i<dim; i++) 
-    {
-        floatType t = 0; 
-        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++) 
-        {
-            int col = cols[j]; 
-            t += val[j] * vec[col];
-        }    
-        out[i] = t; 
-    }
-
-}
-
-// *******************************************************************
-// Function: spmvMic
-//
-// Purpose:
-//   Runs sparse matrix vector multiplication on the MIC accelerator
-// *******************************************************************
-
-template <typename floatType>
-__declspec(target(mic)) void spmvMic(const floatType *val, const int *cols,
-        const int *rowDelimiters, const floatType *vec, int dim, 
-        floatType *out) 
-{
-    #pragma omp parallel for
-    #pragma ivdep
-    for (int i=0; i<dim; i++) 
-    {
-        floatType t = 0; 
-        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++) 
-        {
-            int col = cols[j]; 
-            t += val[j] * vec[col];
-        }    
-        out[i] = t; 
-    }
-
+    addMatrixOptions(op);
+    op.addOption("ccsr_bits", OPT_INT, "0", "Width of the column deltas "
+                 "in compressed CSR (8, 16, or 0 to choose automatically)");
+    op.addOption("bcsr_block", OPT_INT, "0", "Block size for block CSR "
+                 "(2, 3, 4, or 0 to run all sizes and choose automatically)");
+    op.addOption("transpose_mode", OPT_STRING, "auto", "Conflict "
+                 "resolution of the transposed SpMV reported as CSRT "
+                 "(private, atomic, or auto to choose by matrix shape)");
+    op.addOption("transpose_mb", OPT_INT, "512", "Memory budget in MB "
+                 "of the private partial vectors of the transposed SpMV, "
+                 "and of the per block column counts of the explicit "
+                 "transpose");
+    op.addOption("numa_nodes", OPT_INT, "0", "NUMA nodes to split the "
+                 "host SpMV over (0 to read the topology from /sys)");
+    op.addOption("numa_replicate", OPT_INT, "1", "Replicate the input "
+                 "vector on every NUMA node (0 or 1)");
+    op.addOption("numa_pin", OPT_INT, "1", "Pin the host threads to the "
+                 "processors of their NUMA node (0 or 1)");
 }
 
 // *******************************************************************
@@ -261,28 +217,8 @@ void RunTest( ResultDatabase &resultDB, OptionParser &op, enum spmv_target
     __declspec(target(mic)) static int nItemsPadded;
     __declspec(target(mic)) static int numRows;
 
-    // This benchmark either reads in a matrix market input file or
-    // generates a random matrix
-    string inFileName = op.getOptionString("mm_filename");
-    if (inFileName == "random")
-    {
-        // If we're not opening a file, the dimension of the matrix
-        // has been passed in as an argument
-        numRows = nRows; 
-        nItems = numRows * numRows / 100; // 1% of entries will be non-zero
-        float maxval = op.getOptionFloat("maxval"); 
-        h_val = ALLOC(floatType, nItems);
-        h_cols = ALLOC(int, nItems);
-        h_rowDelimiters = ALLOC(int, (nRows+1)); 
-        fill(h_val, nItems, maxval); 
-        initRandomMatrix(h_cols, h_rowDelimiters, nItems, numRows); 
-    }
-    else 
-    {   char filename[FIELD_LENGTH];
-        strcpy(filename, inFileName.c_str());
-        readMatrix(filename, &h_val, &h_cols, &h_rowDelimiters,
-                &nItems, &numRows);
-    }
+    initMatrix(op, nRows, &h_val, &h_cols, &h_rowDelimiters, &nItems,
+            &numRows);
 
     // Set up remaining host data
     h_vec = ALLOC(floatType, numRows);
@@ -458,6 +394,1144 @@ void RunTest( ResultDatabase &resultDB, OptionParser &op, enum spmv_target
     FREE(h_rowDelimitersPad);
 }
 
+// ****************************************************************************
+// Function: timeSpmvMic
+//
+// Purpose:
+//   Times the CSR spmvMic kernel on the MIC card.  This is the baseline the
+//   alternative storage formats are compared against.
+//
+// Arguments:
+//   val, cols, rowDelimiters: the matrix in CSR format
+//   vec: dense vector of size numRows to be used for multiplication
+//   nItems: number of non-zero elements in the matrix
+//   numRows: number of rows in the matrix
+//   out: output - result from the spmv calculation
+//   iters: number of SpMV iterations to time
+//   micdev: MIC target device number
+//
+// Returns:  average kernel time per iteration in seconds
+//
+// ****************************************************************************
+template <typename floatType>
+double timeSpmvMic(floatType *val, int *cols, int *rowDelimiters,
+                   floatType *vec, int nItems, int numRows, floatType *out,
+                   int iters, int micdev)
+{
+    __declspec(target(mic)) static floatType *h_val, *h_vec, *h_out;
+    __declspec(target(mic)) static int *h_cols, *h_rowDelimiters;
+    h_val = val; h_cols = cols; h_rowDelimiters = rowDelimiters;
+    h_vec = vec; h_out = out;
+
+    #pragma offload target(mic:micdev) \
+        in(h_cols:length(nItems)              free_if(0)) \
+        in(h_rowDelimiters:length(numRows+1)  free_if(0)) \
+        in(h_vec:length(numRows)              free_if(0)) \
+        in(h_val:length(nItems)               free_if(0)) \
+        nocopy(h_out:length(numRows)          free_if(0))
+    { }
+
+    double kernelTime = curr_second();
+    #pragma offload target(mic:micdev) in(numRows, iters) \
+        nocopy(h_cols:length(nItems)             alloc_if(0) free_if(0)) \
+        nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+        nocopy(h_vec:length(numRows)             alloc_if(0) free_if(0)) \
+        nocopy(h_val:length(nItems)              alloc_if(0) free_if(0)) \
+        nocopy(h_out:length(numRows)             alloc_if(0) free_if(0))
+    for (int i=0; i<iters; i++)
+    {
+        spmvMic(h_val, h_cols, h_rowDelimiters, h_vec, numRows, h_out);
+    }
+    kernelTime = curr_second() - kernelTime;
+
+    #pragma offload target(mic:micdev) \
+        nocopy(h_cols:length(nItems)             alloc_if(0) free_if(1)) \
+        nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(h_vec:length(numRows)             alloc_if(0) free_if(1)) \
+        nocopy(h_val:length(nItems)              alloc_if(0) free_if(1)) \
+        out(h_out:length(numRows)                alloc_if(0) free_if(1))
+    { }
+
+    return kernelTime / (double)iters;
+}
+
+// ****************************************************************************
+// Function: RunCompressedVariant
+//
+// Purpose:
+//   Converts the matrix to compressed CSR with the given value storage and
+//   delta width, runs spmvCompressed on the MIC card and reports Gflop/s,
+//   bytes per nonzero and the speedup over CSR
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   valName: name of the value storage format, used in the test name
+//   val, cols, rowDelimiters: the matrix in CSR format
+//   vec: dense vector used for multiplication
+//   refOut: reference solution computed by cpu
+//   nItems: number of non-zero elements in the matrix
+//   numRows: number of rows in the matrix
+//   csrTime: CSR kernel time of every pass
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType, typename valType, typename deltaType>
+void RunCompressedVariant(ResultDatabase &resultDB, OptionParser &op,
+        const char *valName, floatType *val, int *cols, int *rowDelimiters,
+        floatType *vec, floatType *refOut, int nItems, int numRows,
+        const double *csrTime)
+{
+    __declspec(target(mic)) static valType *c_val;
+    __declspec(target(mic)) static deltaType *c_deltas;
+    __declspec(target(mic)) static int *c_escapes, *c_escDelimiters;
+    __declspec(target(mic)) static int *h_rowDelimiters;
+    __declspec(target(mic)) static floatType *h_vec, *h_out;
+    __declspec(target(mic)) static int nEscapes;
+
+    const int bits = 8 * sizeof(deltaType);
+    nEscapes = ccsrCountEscapes(cols, rowDelimiters, numRows, bits);
+
+    c_val = ALLOC(valType, nItems);
+    c_deltas = ALLOC(deltaType, nItems);
+    // keep at least one entry so the offload always has a buffer
+    c_escapes = ALLOC(int, nEscapes + 1);
+    c_escDelimiters = ALLOC(int, numRows+1);
+    h_rowDelimiters = rowDelimiters;
+    h_vec = vec;
+    h_out = ALLOC(floatType, numRows);
+
+    convertToCompressed(val, cols, rowDelimiters, numRows, c_val, c_deltas,
+                        c_escapes, c_escDelimiters);
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows_%dbit", nItems, numRows, bits);
+    sprintf(benchName, "CCSR_MIC-%s-%s", dpTest ? "DP":"SP", valName);
+
+    // Bytes per nonzero streamed by the kernel, row and escape delimiters
+    // included (the input and output vectors are not counted)
+    double bytesPerNnz = ((double)(sizeof(valType) + sizeof(deltaType)) *
+            nItems + sizeof(int) * (nEscapes + 2.0 * (numRows+1))) /
+            (double)nItems;
+
+    cout << benchName << " Test (" << bits << " bit deltas, " << nEscapes
+         << " escapes)\n";
+
+    #pragma offload target(mic:micdev) \
+        in(c_val:length(nItems)               free_if(0)) \
+        in(c_deltas:length(nItems)            free_if(0)) \
+        in(c_escapes:length(nEscapes+1)       free_if(0)) \
+        in(c_escDelimiters:length(numRows+1)  free_if(0)) \
+        in(h_rowDelimiters:length(numRows+1)  free_if(0)) \
+        in(h_vec:length(numRows)              free_if(0)) \
+        nocopy(h_out:length(numRows)          free_if(0))
+    { }
+
+    for (int k = 0; k < passes; k++)
+    {
+        double kernelTime = curr_second();
+        #pragma offload target(mic:micdev) in(numRows, iters) \
+            nocopy(c_val:length(nItems)              alloc_if(0) free_if(0)) \
+            nocopy(c_deltas:length(nItems)           alloc_if(0) free_if(0)) \
+            nocopy(c_escapes:length(nEscapes+1)      alloc_if(0) free_if(0)) \
+            nocopy(c_escDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+            nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+            nocopy(h_vec:length(numRows)             alloc_if(0) free_if(0)) \
+            nocopy(h_out:length(numRows)             alloc_if(0) free_if(0))
+        for (int i=0; i<iters; i++)
+        {
+            spmvCompressed(c_val, c_deltas, c_escapes, h_rowDelimiters,
+                           c_escDelimiters, h_vec, numRows, h_out);
+        }
+        kernelTime = curr_second() - kernelTime;
+
+        #pragma offload target(mic:micdev) \
+            out(h_out:length(numRows) alloc_if(0) free_if(0))
+        { }
+
+        if (!verifyResults(refOut, h_out, numRows, k))
+        {
+            continue;
+        }
+
+        double avgTime = kernelTime / (double)iters;
+        double gflop = 2 * (double) nItems / 1e9;
+        string name(benchName);
+        resultDB.AddResult(name, atts, "Gflop/s", gflop/avgTime);
+        resultDB.AddResult(name + "_Bytes", atts, "B/nnz", bytesPerNnz);
+        resultDB.AddResult(name + "_Speedup", atts, "x", csrTime[k]/avgTime);
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(c_val:length(nItems)              alloc_if(0) free_if(1)) \
+        nocopy(c_deltas:length(nItems)           alloc_if(0) free_if(1)) \
+        nocopy(c_escapes:length(nEscapes+1)      alloc_if(0) free_if(1)) \
+        nocopy(c_escDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(h_vec:length(numRows)             alloc_if(0) free_if(1)) \
+        nocopy(h_out:length(numRows)             alloc_if(0) free_if(1))
+    { }
+
+    FREE(c_val);
+    FREE(c_deltas);
+    FREE(c_escapes);
+    FREE(c_escDelimiters);
+    FREE(h_out);
+}
+
+// ****************************************************************************
+// Function: RunCompressedTest
+//
+// Purpose:
+//   Compares index and value compressed CSR against plain CSR on the MIC
+//   card.  Values are tested in full precision, bf16 and fp16.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunCompressedTest(ResultDatabase &resultDB, OptionParser &op,
+                       int nRows=0)
+{
+    floatType *val, *vec, *out, *refOut;
+    int *cols, *rowDelimiters;
+    int nItems, numRows;
+
+    initMatrix(op, nRows, &val, &cols, &rowDelimiters, &nItems, &numRows);
+    vec = ALLOC(floatType, numRows);
+    out = ALLOC(floatType, numRows);
+    refOut = ALLOC(floatType, numRows);
+    fill(vec, numRows, op.getOptionFloat("maxval"));
+    spmvCpu(val, cols, rowDelimiters, vec, numRows, refOut);
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows", nItems, numRows);
+    sprintf(benchName, "CSR_MIC-%s", dpTest ? "DP":"SP");
+    double csrBytesPerNnz = ((double)(sizeof(floatType) + sizeof(int)) *
+            nItems + sizeof(int) * (numRows+1.0)) / (double)nItems;
+
+    // CSR baseline
+    cout << benchName << " Test\n";
+    double *csrTime = new double[passes];
+    for (int k = 0; k < passes; k++)
+    {
+        csrTime[k] = timeSpmvMic(val, cols, rowDelimiters, vec, nItems,
+                                 numRows, out, iters, micdev);
+        verifyResults(refOut, out, numRows, k);
+        double gflop = 2 * (double) nItems / 1e9;
+        resultDB.AddResult(benchName, atts, "Gflop/s", gflop/csrTime[k]);
+        resultDB.AddResult(string(benchName) + "_Bytes", atts, "B/nnz",
+                           csrBytesPerNnz);
+    }
+
+    int bits = op.getOptionInt("ccsr_bits");
+    if (bits != 8 && bits != 16)
+    {
+        bits = ccsrChooseBits(cols, rowDelimiters, numRows);
+    }
+
+    if (bits == 8)
+    {
+        RunCompressedVariant<floatType, floatType, unsigned char>(resultDB,
+                op, dpTest ? "fp64" : "fp32", val, cols, rowDelimiters, vec,
+                refOut, nItems, numRows, csrTime);
+        RunCompressedVariant<floatType, bfloat16_t, unsigned char>(resultDB,
+                op, "bf16", val, cols, rowDelimiters, vec, refOut, nItems,
+                numRows, csrTime);
+        RunCompressedVariant<floatType, half_t, unsigned char>(resultDB,
+                op, "fp16", val, cols, rowDelimiters, vec, refOut, nItems,
+                numRows, csrTime);
+    }
+    else
+    {
+        RunCompressedVariant<floatType, floatType, unsigned short>(resultDB,
+                op, dpTest ? "fp64" : "fp32", val, cols, rowDelimiters, vec,
+                refOut, nItems, numRows, csrTime);
+        RunCompressedVariant<floatType, bfloat16_t, unsigned short>(resultDB,
+                op, "bf16", val, cols, rowDelimiters, vec, refOut, nItems,
+                numRows, csrTime);
+        RunCompressedVariant<floatType, half_t, unsigned short>(resultDB,
+                op, "fp16", val, cols, rowDelimiters, vec, refOut, nItems,
+                numRows, csrTime);
+    }
+
+    delete[] csrTime;
+    FREE(val);
+    FREE(cols);
+    FREE(rowDelimiters);
+    FREE(vec);
+    FREE(out);
+    FREE(refOut);
+}
+
+// ****************************************************************************
+// Function: RunBlockedVariant
+//
+// Purpose:
+//   Converts the matrix to BxB block CSR, runs spmvBlocked on the MIC card
+//   and reports Gflop/s (true nonzeros only), fill ratio, bytes per
+//   nonzero and the speedup over CSR
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   val, cols, rowDelimiters: the matrix in CSR format
+//   vec: dense vector used for multiplication
+//   refOut: reference solution computed by cpu
+//   nItems: number of non-zero elements in the matrix
+//   numRows: number of rows in the matrix
+//   csrTime: CSR kernel time of every pass
+//   autoChoice: also report the results as the automatically chosen format
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType, int B>
+void RunBlockedVariant(ResultDatabase &resultDB, OptionParser &op,
+        floatType *val, int *cols, int *rowDelimiters, floatType *vec,
+        floatType *refOut, int nItems, int numRows, const double *csrTime,
+        bool autoChoice)
+{
+    __declspec(target(mic)) static floatType *b_val, *b_vec, *b_out;
+    __declspec(target(mic)) static int *b_cols, *b_rowDelimiters;
+    __declspec(target(mic)) static int nBlocks, nBlockRows, nValues;
+
+    nBlockRows = (numRows + B - 1) / B;
+    b_rowDelimiters = ALLOC(int, nBlockRows+1);
+    convertToBlocked<floatType, B>(val, cols, rowDelimiters, numRows, &b_val,
+                                   &b_cols, b_rowDelimiters, &nBlocks);
+    nValues = nBlocks * B * B;
+
+    // Vectors are padded to whole blocks, the padding must be zero so the
+    // explicit zeros of the last block row do not pick up garbage
+    b_vec = ALLOC(floatType, nBlockRows*B);
+    b_out = ALLOC(floatType, nBlockRows*B);
+    memset(b_vec, 0, nBlockRows * B * sizeof(floatType));
+    memcpy(b_vec, vec, numRows * sizeof(floatType));
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows", nItems, numRows);
+    sprintf(benchName, "BCSR%dx%d_MIC-%s", B, B, dpTest ? "DP":"SP");
+
+    double fill = (double)nValues / (double)nItems;
+    double bytesPerNnz = ((double)nValues * sizeof(floatType) +
+            sizeof(int) * (nBlocks + nBlockRows + 1.0)) / (double)nItems;
+
+    cout << benchName << " Test (" << nBlocks << " blocks, fill " << fill
+         << ")\n";
+
+    #pragma offload target(mic:micdev) \
+        in(b_val:length(nValues)                free_if(0)) \
+        in(b_cols:length(nBlocks)               free_if(0)) \
+        in(b_rowDelimiters:length(nBlockRows+1) free_if(0)) \
+        in(b_vec:length(nBlockRows*B)           free_if(0)) \
+        nocopy(b_out:length(nBlockRows*B)       free_if(0))
+    { }
+
+    for (int k = 0; k < passes; k++)
+    {
+        double kernelTime = curr_second();
+        #pragma offload target(mic:micdev) in(nBlockRows, iters) \
+            nocopy(b_val:length(nValues)                alloc_if(0) free_if(0)) \
+            nocopy(b_cols:length(nBlocks)               alloc_if(0) free_if(0)) \
+            nocopy(b_rowDelimiters:length(nBlockRows+1) alloc_if(0) free_if(0)) \
+            nocopy(b_vec:length(nBlockRows*B)           alloc_if(0) free_if(0)) \
+            nocopy(b_out:length(nBlockRows*B)           alloc_if(0) free_if(0))
+        for (int i=0; i<iters; i++)
+        {
+            spmvBlocked<floatType, B>(b_val, b_cols, b_rowDelimiters, b_vec,
+                                      nBlockRows, b_out);
+        }
+        kernelTime = curr_second() - kernelTime;
+
+        #pragma offload target(mic:micdev) \
+            out(b_out:length(nBlockRows*B) alloc_if(0) free_if(0))
+        { }
+
+        if (!verifyResults(refOut, b_out, numRows, k))
+        {
+            continue;
+        }
+
+        double avgTime = kernelTime / (double)iters;
+        double gflop = 2 * (double) nItems / 1e9;
+        string name(benchName);
+        resultDB.AddResult(name, atts, "Gflop/s", gflop/avgTime);
+        resultDB.AddResult(name + "_Fill", atts, "ratio", fill);
+        resultDB.AddResult(name + "_Bytes", atts, "B/nnz", bytesPerNnz);
+        resultDB.AddResult(name + "_Speedup", atts, "x", csrTime[k]/avgTime);
+        if (autoChoice)
+        {
+            sprintf(benchName, "BCSRauto_MIC-%s", dpTest ? "DP":"SP");
+            resultDB.AddResult(benchName, atts, "Gflop/s", gflop/avgTime);
+            resultDB.AddResult(string(benchName) + "_Speedup", atts, "x",
+                               csrTime[k]/avgTime);
+            sprintf(benchName, "BCSR%dx%d_MIC-%s", B, B, dpTest ? "DP":"SP");
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(b_val:length(nValues)                alloc_if(0) free_if(1)) \
+        nocopy(b_cols:length(nBlocks)               alloc_if(0) free_if(1)) \
+        nocopy(b_rowDelimiters:length(nBlockRows+1) alloc_if(0) free_if(1)) \
+        nocopy(b_vec:length(nBlockRows*B)           alloc_if(0) free_if(1)) \
+        nocopy(b_out:length(nBlockRows*B)           alloc_if(0) free_if(1))
+    { }
+
+    FREE(b_val);
+    FREE(b_cols);
+    FREE(b_rowDelimiters);
+    FREE(b_vec);
+    FREE(b_out);
+}
+
+// ****************************************************************************
+// Function: RunBlockedTest
+//
+// Purpose:
+//   Compares register blocked CSR against plain CSR on the MIC card.  With
+//   --bcsr_block 0 the 2x2, 3x3 and 4x4 kernels are all run, and the block
+//   size picked from the sampled fill ratio is reported as BCSRauto.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunBlockedTest(ResultDatabase &resultDB, OptionParser &op, int nRows=0)
+{
+    floatType *val, *vec, *out, *refOut;
+    int *cols, *rowDelimiters;
+    int nItems, numRows;
+
+    initMatrix(op, nRows, &val, &cols, &rowDelimiters, &nItems, &numRows);
+    vec = ALLOC(floatType, numRows);
+    out = ALLOC(floatType, numRows);
+    refOut = ALLOC(floatType, numRows);
+    fill(vec, numRows, op.getOptionFloat("maxval"));
+    spmvCpu(val, cols, rowDelimiters, vec, numRows, refOut);
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows", nItems, numRows);
+
+    double estFill;
+    int autoBlock = bcsrChooseBlock(cols, rowDelimiters, numRows,
+                                    sizeof(floatType), &estFill);
+    cout << "BCSR automatic block size: " << autoBlock << "x" << autoBlock
+         << " (estimated fill " << estFill << ")\n";
+
+    // CSR baseline
+    sprintf(benchName, "CSR_MIC-%s", dpTest ? "DP":"SP");
+    cout << benchName << " Test\n";
+    double *csrTime = new double[passes];
+    for (int k = 0; k < passes; k++)
+    {
+        csrTime[k] = timeSpmvMic(val, cols, rowDelimiters, vec, nItems,
+                                 numRows, out, iters, micdev);
+        verifyResults(refOut, out, numRows, k);
+        double gflop = 2 * (double) nItems / 1e9;
+        resultDB.AddResult(benchName, atts, "Gflop/s", gflop/csrTime[k]);
+        if (autoBlock == 1)
+        {
+            sprintf(benchName, "BCSRauto_MIC-%s", dpTest ? "DP":"SP");
+            resultDB.AddResult(benchName, atts, "Gflop/s", gflop/csrTime[k]);
+            resultDB.AddResult(string(benchName) + "_Speedup", atts, "x", 1.0);
+            sprintf(benchName, "CSR_MIC-%s", dpTest ? "DP":"SP");
+        }
+    }
+
+    int block = op.getOptionInt("bcsr_block");
+    if (block == 0 || block == 2)
+    {
+        RunBlockedVariant<floatType, 2>(resultDB, op, val, cols,
+                rowDelimiters, vec, refOut, nItems, numRows, csrTime,
+                autoBlock == 2);
+    }
+    if (block == 0 || block == 3)
+    {
+        RunBlockedVariant<floatType, 3>(resultDB, op, val, cols,
+                rowDelimiters, vec, refOut, nItems, numRows, csrTime,
+                autoBlock == 3);
+    }
+    if (block == 0 || block == 4)
+    {
+        RunBlockedVariant<floatType, 4>(resultDB, op, val, cols,
+                rowDelimiters, vec, refOut, nItems, numRows, csrTime,
+                autoBlock == 4);
+    }
+
+    delete[] csrTime;
+    FREE(val);
+    FREE(cols);
+    FREE(rowDelimiters);
+    FREE(vec);
+    FREE(out);
+    FREE(refOut);
+}
+
+// ****************************************************************************
+// Function: RunSymmetricTest
+//
+// Purpose:
+//   Compares symmetric (upper triangle) storage against full CSR on the MIC
+//   card.  The test matrix is the symmetric matrix defined by the upper
+//   triangle of the input, which is the input itself for symmetric Matrix
+//   Market files.  Gflop/s counts the flops of the full matrix for both
+//   formats; the bytes moved include the matrix, the vectors and, for the
+//   symmetric kernel, the per-thread partial result vectors.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunSymmetricTest(ResultDatabase &resultDB, OptionParser &op,
+                      int nRows=0)
+{
+    __declspec(target(mic)) static floatType *s_val, *h_vec, *h_out;
+    __declspec(target(mic)) static floatType *s_work;
+    __declspec(target(mic)) static int *s_cols, *s_rowDelimiters;
+    __declspec(target(mic)) static int *s_rowStart, *s_colEnd;
+    __declspec(target(mic)) static int nUpper, numRows, nParts;
+    __declspec(target(mic)) static long *s_workStart;
+    floatType *val, *fullVal, *out, *refOut;
+    int *cols, *rowDelimiters, *fullCols, *fullRowDelimiters;
+    int nItems, nFull;
+
+    initMatrix(op, nRows, &val, &cols, &rowDelimiters, &nItems, &numRows);
+    s_rowDelimiters = ALLOC(int, numRows+1);
+    convertToUpper(val, cols, rowDelimiters, numRows, &s_val, &s_cols,
+                   s_rowDelimiters, &nUpper);
+    FREE(val);
+    FREE(cols);
+    FREE(rowDelimiters);
+
+    fullRowDelimiters = ALLOC(int, numRows+1);
+    convertUpperToFull(s_val, s_cols, s_rowDelimiters, numRows, &fullVal,
+                       &fullCols, fullRowDelimiters, &nFull);
+
+    h_vec = ALLOC(floatType, numRows);
+    h_out = ALLOC(floatType, numRows);
+    out = ALLOC(floatType, numRows);
+    refOut = ALLOC(floatType, numRows);
+    fill(h_vec, numRows, op.getOptionFloat("maxval"));
+    spmvCpu(fullVal, fullCols, fullRowDelimiters, h_vec, numRows, refOut);
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    // One row block per MIC thread
+    nParts = 240;
+    #pragma offload target(mic:micdev) inout(nParts)
+    {
+        nParts = omp_get_max_threads();
+    }
+    s_rowStart = ALLOC(int, nParts+1);
+    s_colEnd = ALLOC(int, nParts);
+    s_workStart = ALLOC(long, nParts+1);
+    symmetricPartition(s_cols, s_rowDelimiters, numRows, nParts, s_rowStart,
+                       s_colEnd, s_workStart);
+    // Only touched on the card, the host pages are never used
+    long nWork = s_workStart[nParts];
+    s_work = ALLOC(floatType, nWork > 0 ? nWork : 1);
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows", nFull, numRows);
+
+    double workElements = nWork;
+    double vecBytes = 2.0 * numRows * sizeof(floatType);
+    double csrMB = ((sizeof(floatType) + sizeof(int)) * (double)nFull +
+                    sizeof(int) * (numRows+1.0) + vecBytes) / 1e6;
+    // partial vectors are zeroed, accumulated and read back once
+    double symMB = ((sizeof(floatType) + sizeof(int)) * (double)nUpper +
+                    sizeof(int) * (numRows+1.0) + vecBytes +
+                    3.0 * sizeof(floatType) * workElements) / 1e6;
+    double gflop = 2 * (double) nFull / 1e9;
+
+    // CSR baseline on the full matrix
+    sprintf(benchName, "CSR_MIC-%s", dpTest ? "DP":"SP");
+    cout << benchName << " Test\n";
+    double *csrTime = new double[passes];
+    for (int k = 0; k < passes; k++)
+    {
+        csrTime[k] = timeSpmvMic(fullVal, fullCols, fullRowDelimiters, h_vec,
+                                 nFull, numRows, out, iters, micdev);
+        verifyResults(refOut, out, numRows, k);
+        resultDB.AddResult(benchName, atts, "Gflop/s", gflop/csrTime[k]);
+        resultDB.AddResult(string(benchName) + "_Traffic", atts, "MB",
+                           csrMB);
+    }
+
+    sprintf(benchName, "SYM_MIC-%s", dpTest ? "DP":"SP");
+    cout << benchName << " Test (" << nUpper << " of " << nFull
+         << " elements stored, " << nParts << " row blocks)\n";
+
+    #pragma offload target(mic:micdev) \
+        in(s_val:length(nUpper)               free_if(0)) \
+        in(s_cols:length(nUpper)              free_if(0)) \
+        in(s_rowDelimiters:length(numRows+1)  free_if(0)) \
+        in(s_rowStart:length(nParts+1)        free_if(0)) \
+        in(s_colEnd:length(nParts)            free_if(0)) \
+        in(s_workStart:length(nParts+1)       free_if(0)) \
+        in(h_vec:length(numRows)              free_if(0)) \
+        nocopy(h_out:length(numRows)          free_if(0)) \
+        nocopy(s_work:length(nWork)           free_if(0))
+    { }
+
+    for (int k = 0; k < passes; k++)
+    {
+        double kernelTime = curr_second();
+        #pragma offload target(mic:micdev) in(nParts, iters) \
+            nocopy(s_val:length(nUpper)              alloc_if(0) free_if(0)) \
+            nocopy(s_cols:length(nUpper)             alloc_if(0) free_if(0)) \
+            nocopy(s_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+            nocopy(s_rowStart:length(nParts+1)       alloc_if(0) free_if(0)) \
+            nocopy(s_colEnd:length(nParts)           alloc_if(0) free_if(0)) \
+            nocopy(s_workStart:length(nParts+1)      alloc_if(0) free_if(0)) \
+            nocopy(h_vec:length(numRows)             alloc_if(0) free_if(0)) \
+            nocopy(h_out:length(numRows)             alloc_if(0) free_if(0)) \
+            nocopy(s_work:length(nWork)              alloc_if(0) free_if(0))
+        for (int i=0; i<iters; i++)
+        {
+            spmvSymmetric(s_val, s_cols, s_rowDelimiters, s_rowStart,
+                          s_colEnd, s_workStart, nParts, h_vec, h_out,
+                          s_work);
+        }
+        kernelTime = curr_second() - kernelTime;
+
+        #pragma offload target(mic:micdev) \
+            out(h_out:length(numRows) alloc_if(0) free_if(0))
+        { }
+
+        if (!verifyResults(refOut, h_out, numRows, k))
+        {
+            continue;
+        }
+
+        double avgTime = kernelTime / (double)iters;
+        string name(benchName);
+        resultDB.AddResult(name, atts, "Gflop/s", gflop/avgTime);
+        resultDB.AddResult(name + "_Traffic", atts, "MB", symMB);
+        resultDB.AddResult(name + "_TrafficRatio", atts, "ratio",
+                           symMB/csrMB);
+        resultDB.AddResult(name + "_Speedup", atts, "x", csrTime[k]/avgTime);
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(s_val:length(nUpper)              alloc_if(0) free_if(1)) \
+        nocopy(s_cols:length(nUpper)             alloc_if(0) free_if(1)) \
+        nocopy(s_rowDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(s_rowStart:length(nParts+1)       alloc_if(0) free_if(1)) \
+        nocopy(s_colEnd:length(nParts)           alloc_if(0) free_if(1)) \
+        nocopy(s_workStart:length(nParts+1)      alloc_if(0) free_if(1)) \
+        nocopy(h_vec:length(numRows)             alloc_if(0) free_if(1)) \
+        nocopy(h_out:length(numRows)             alloc_if(0) free_if(1)) \
+        nocopy(s_work:length(nWork)              alloc_if(0) free_if(1))
+    { }
+
+    delete[] csrTime;
+    FREE(s_val);
+    FREE(s_cols);
+    FREE(s_rowDelimiters);
+    FREE(s_rowStart);
+    FREE(s_colEnd);
+    FREE(s_workStart);
+    FREE(s_work);
+    FREE(fullVal);
+    FREE(fullCols);
+    FREE(fullRowDelimiters);
+    FREE(h_vec);
+    FREE(h_out);
+    FREE(out);
+    FREE(refOut);
+}
+
+// ****************************************************************************
+// Function: RunTransposeTest
+//
+// Purpose:
+//   Computes y = A'x on the MIC card from the CSR form of A with private
+//   partial vectors and with atomics, and compares both against building
+//   A' explicitly and running the CSR kernel on it.  The explicit result
+//   is reported with the transpose counted once per pass of iterations
+//   products, and without it.
+//
+//   The partial vectors of the private mode span the columns every block
+//   touches, up to nParts * numCols elements for scattered columns; the
+//   private mode is skipped when they exceed transpose_mb MB.  The
+//   explicit transpose counts per block and column the same way, and
+//   halves its number of blocks until the counts fit the budget.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunTransposeTest(ResultDatabase &resultDB, OptionParser &op,
+                      int nRows=0)
+{
+    __declspec(target(mic)) static floatType *h_val, *h_vec, *h_out;
+    __declspec(target(mic)) static floatType *t_val, *t_work;
+    __declspec(target(mic)) static int *h_cols, *h_rowDelimiters;
+    __declspec(target(mic)) static int *t_cols, *t_rowDelimiters, *t_counts;
+    __declspec(target(mic)) static int *t_rowStart, *t_colMin, *t_colMax;
+    __declspec(target(mic)) static int *t_colOwner;
+    __declspec(target(mic)) static long *t_workStart;
+    __declspec(target(mic)) static int *x_rowStart, *x_colMin, *x_colMax;
+    __declspec(target(mic)) static long *x_workStart;
+    int nItems, numRows;
+    floatType *refOut;
+
+    initMatrix(op, nRows, &h_val, &h_cols, &h_rowDelimiters, &nItems,
+               &numRows);
+    // The generated and Matrix Market matrices are square
+    int numCols = numRows;
+
+    h_vec = ALLOC(floatType, numRows);
+    h_out = ALLOC(floatType, numCols);
+    refOut = ALLOC(floatType, numCols);
+    fill(h_vec, numRows, op.getOptionFloat("maxval"));
+    spmvTransposedCpu(h_val, h_cols, h_rowDelimiters, h_vec, numRows,
+                      numCols, refOut);
+
+    int micdev = op.getOptionInt("target");
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+
+    // One row block per MIC thread
+    int nParts = 240;
+    #pragma offload target(mic:micdev) inout(nParts)
+    {
+        nParts = omp_get_max_threads();
+    }
+    t_rowStart = ALLOC(int, nParts+1);
+    t_colMin = ALLOC(int, nParts);
+    t_colMax = ALLOC(int, nParts);
+    t_workStart = ALLOC(long, nParts+1);
+    t_colOwner = ALLOC(int, numCols);
+    long shared = transposePartition(h_cols, h_rowDelimiters, numRows,
+                                     numCols, nParts, t_rowStart, t_colMin,
+                                     t_colMax, t_workStart, t_colOwner);
+    long nWork = t_workStart[nParts];
+    long budget = (long)op.getOptionInt("transpose_mb") * 1024 * 1024;
+    bool runPrivate = nWork * (long)sizeof(floatType) <= budget;
+    int autoMode = chooseTransposeMode(nWork, shared);
+    string modeOpt = op.getOptionString("transpose_mode");
+    if (modeOpt == "private") autoMode = TRANSPOSE_PRIVATE;
+    if (modeOpt == "atomic") autoMode = TRANSPOSE_ATOMIC;
+    if (!runPrivate)
+    {
+        autoMode = TRANSPOSE_ATOMIC;
+    }
+
+    // The explicit transpose's own blocks, as many as fit the budget
+    int xParts = nParts;
+    x_rowStart = ALLOC(int, nParts+1);
+    x_colMin = ALLOC(int, nParts);
+    x_colMax = ALLOC(int, nParts);
+    x_workStart = ALLOC(long, nParts+1);
+    for (;;)
+    {
+        transposeRanges(h_cols, h_rowDelimiters, numRows, numCols, xParts,
+                        x_rowStart, x_colMin, x_colMax, x_workStart);
+        if (xParts == 1 || x_workStart[xParts] * (long)sizeof(int) <= budget)
+        {
+            break;
+        }
+        xParts /= 2;
+    }
+    // Scratch lengths on the card, never zero
+    long workLen = (runPrivate && nWork > 0) ? nWork : 1;
+    long countLen = (x_workStart[xParts] > 0) ? x_workStart[xParts] : 1;
+
+    // Only touched on the card, the host pages are never used
+    t_work = ALLOC(floatType, workLen);
+    t_val = ALLOC(floatType, nItems);
+    t_cols = ALLOC(int, nItems);
+    t_rowDelimiters = ALLOC(int, numCols+1);
+    t_counts = ALLOC(int, countLen);
+
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows", nItems, numRows);
+    double gflop = 2 * (double) nItems / 1e9;
+    const char *prec = dpTest ? "DP" : "SP";
+    cout << "Transposed SpMV: " << shared << " of " << nItems
+         << " elements in shared columns, " << nWork
+         << " partial vector elements, "
+         << (autoMode == TRANSPOSE_ATOMIC ? "atomic" : "private")
+         << " mode chosen\n";
+    if (!runPrivate)
+    {
+        cout << "Transposed SpMV: private mode skipped, its partial "
+             << "vectors exceed transpose_mb\n";
+    }
+    if (xParts < nParts)
+    {
+        cout << "Transposed SpMV: explicit transpose in " << xParts
+             << " blocks to fit its counts in transpose_mb\n";
+    }
+
+    #pragma offload target(mic:micdev) \
+        in(h_val:length(nItems)               free_if(0)) \
+        in(h_cols:length(nItems)              free_if(0)) \
+        in(h_rowDelimiters:length(numRows+1)  free_if(0)) \
+        in(h_vec:length(numRows)              free_if(0)) \
+        nocopy(h_out:length(numCols)          free_if(0)) \
+        in(t_rowStart:length(nParts+1)        free_if(0)) \
+        in(t_colMin:length(nParts)            free_if(0)) \
+        in(t_colMax:length(nParts)            free_if(0)) \
+        in(t_workStart:length(nParts+1)       free_if(0)) \
+        in(t_colOwner:length(numCols)         free_if(0)) \
+        in(x_rowStart:length(xParts+1)        free_if(0)) \
+        in(x_colMin:length(xParts)            free_if(0)) \
+        in(x_colMax:length(xParts)            free_if(0)) \
+        in(x_workStart:length(xParts+1)       free_if(0)) \
+        nocopy(t_work:length(workLen)         free_if(0)) \
+        nocopy(t_val:length(nItems)           free_if(0)) \
+        nocopy(t_cols:length(nItems)          free_if(0)) \
+        nocopy(t_rowDelimiters:length(numCols+1) free_if(0)) \
+        nocopy(t_counts:length(countLen)      free_if(0))
+    { }
+
+    // Implicit transpose, both modes
+    double *modeTime[2] = { new double[passes], new double[passes] };
+    for (int k = 0; k < passes; k++)
+    {
+        modeTime[TRANSPOSE_PRIVATE][k] = 0;
+    }
+    for (int mode = runPrivate ? TRANSPOSE_PRIVATE : TRANSPOSE_ATOMIC;
+         mode <= TRANSPOSE_ATOMIC; mode++)
+    {
+        sprintf(benchName, "CSRT_%s_MIC-%s",
+                mode == TRANSPOSE_ATOMIC ? "Atomic" : "Private", prec);
+        cout << benchName << " Test\n";
+        for (int k = 0; k < passes; k++)
+        {
+            double kernelTime = curr_second();
+            #pragma offload target(mic:micdev) \
+                in(numCols, nParts, mode, iters) \
+                nocopy(h_val:length(nItems)            alloc_if(0) free_if(0)) \
+                nocopy(h_cols:length(nItems)           alloc_if(0) free_if(0)) \
+                nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+                nocopy(h_vec:length(numRows)           alloc_if(0) free_if(0)) \
+                nocopy(h_out:length(numCols)           alloc_if(0) free_if(0)) \
+                nocopy(t_rowStart:length(nParts+1)     alloc_if(0) free_if(0)) \
+                nocopy(t_colMin:length(nParts)         alloc_if(0) free_if(0)) \
+                nocopy(t_colMax:length(nParts)         alloc_if(0) free_if(0)) \
+                nocopy(t_workStart:length(nParts+1)    alloc_if(0) free_if(0)) \
+                nocopy(t_colOwner:length(numCols)      alloc_if(0) free_if(0)) \
+                nocopy(t_work:length(workLen)          alloc_if(0) free_if(0))
+            for (int i=0; i<iters; i++)
+            {
+                spmvTransposed(h_val, h_cols, h_rowDelimiters, t_rowStart,
+                               t_colMin, t_colMax, t_workStart, t_colOwner,
+                               nParts, mode, h_vec, numCols, h_out, t_work);
+            }
+            kernelTime = curr_second() - kernelTime;
+            modeTime[mode][k] = kernelTime / (double)iters;
+
+            #pragma offload target(mic:micdev) \
+                out(h_out:length(numCols) alloc_if(0) free_if(0))
+            { }
+            if (!verifyResults(refOut, h_out, numCols, k))
+            {
+                modeTime[mode][k] = 0;
+                continue;
+            }
+            resultDB.AddResult(benchName, atts, "Gflop/s",
+                               gflop/modeTime[mode][k]);
+        }
+    }
+
+    // Explicit transpose, then CSR on A'
+    string name = string("CSRTX_MIC-") + prec;
+    cout << name << " Test\n";
+    for (int k = 0; k < passes; k++)
+    {
+        double transposeTime = curr_second();
+        #pragma offload target(mic:micdev) in(numCols, xParts) \
+            nocopy(h_val:length(nItems)              alloc_if(0) free_if(0)) \
+            nocopy(h_cols:length(nItems)             alloc_if(0) free_if(0)) \
+            nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(0)) \
+            nocopy(x_rowStart:length(xParts+1)       alloc_if(0) free_if(0)) \
+            nocopy(x_colMin:length(xParts)           alloc_if(0) free_if(0)) \
+            nocopy(x_colMax:length(xParts)           alloc_if(0) free_if(0)) \
+            nocopy(x_workStart:length(xParts+1)      alloc_if(0) free_if(0)) \
+            nocopy(t_val:length(nItems)              alloc_if(0) free_if(0)) \
+            nocopy(t_cols:length(nItems)             alloc_if(0) free_if(0)) \
+            nocopy(t_rowDelimiters:length(numCols+1) alloc_if(0) free_if(0)) \
+            nocopy(t_counts:length(countLen)         alloc_if(0) free_if(0))
+        {
+            transposeCSR(h_val, h_cols, h_rowDelimiters, x_rowStart,
+                         x_colMin, x_colMax, x_workStart, xParts, numCols,
+                         t_val, t_cols, t_rowDelimiters, t_counts);
+        }
+        transposeTime = curr_second() - transposeTime;
+
+        double kernelTime = curr_second();
+        #pragma offload target(mic:micdev) in(numCols, iters) \
+            nocopy(t_val:length(nItems)              alloc_if(0) free_if(0)) \
+            nocopy(t_cols:length(nItems)             alloc_if(0) free_if(0)) \
+            nocopy(t_rowDelimiters:length(numCols+1) alloc_if(0) free_if(0)) \
+            nocopy(h_vec:length(numRows)             alloc_if(0) free_if(0)) \
+            nocopy(h_out:length(numCols)             alloc_if(0) free_if(0))
+        for (int i=0; i<iters; i++)
+        {
+            spmvMic(t_val, t_cols, t_rowDelimiters, h_vec, numCols, h_out);
+        }
+        kernelTime = curr_second() - kernelTime;
+
+        #pragma offload target(mic:micdev) \
+            out(h_out:length(numCols) alloc_if(0) free_if(0))
+        { }
+        if (!verifyResults(refOut, h_out, numCols, k))
+        {
+            continue;
+        }
+
+        double avgTime = kernelTime / (double)iters;
+        double totalTime = (transposeTime + kernelTime) / (double)iters;
+        resultDB.AddResult(name, atts, "Gflop/s", gflop/totalTime);
+        resultDB.AddResult(name + "_SpmvOnly", atts, "Gflop/s",
+                           gflop/avgTime);
+        resultDB.AddResult(name + "_Transpose", atts, "ms",
+                           transposeTime * 1e3);
+        for (int mode = TRANSPOSE_PRIVATE; mode <= TRANSPOSE_ATOMIC; mode++)
+        {
+            if (modeTime[mode][k] > 0)
+            {
+                sprintf(benchName, "CSRT_%s_MIC-%s_Speedup",
+                        mode == TRANSPOSE_ATOMIC ? "Atomic" : "Private",
+                        prec);
+                resultDB.AddResult(benchName, atts, "x",
+                                   totalTime / modeTime[mode][k]);
+            }
+        }
+        if (modeTime[autoMode][k] > 0)
+        {
+            sprintf(benchName, "CSRT_MIC-%s", prec);
+            resultDB.AddResult(benchName, atts, "Gflop/s",
+                               gflop/modeTime[autoMode][k]);
+            resultDB.AddResult(string(benchName) + "_Speedup", atts, "x",
+                               totalTime / modeTime[autoMode][k]);
+        }
+    }
+
+    #pragma offload target(mic:micdev) \
+        nocopy(h_val:length(nItems)              alloc_if(0) free_if(1)) \
+        nocopy(h_cols:length(nItems)             alloc_if(0) free_if(1)) \
+        nocopy(h_rowDelimiters:length(numRows+1) alloc_if(0) free_if(1)) \
+        nocopy(h_vec:length(numRows)             alloc_if(0) free_if(1)) \
+        nocopy(h_out:length(numCols)             alloc_if(0) free_if(1)) \
+        nocopy(t_rowStart:length(nParts+1)       alloc_if(0) free_if(1)) \
+        nocopy(t_colMin:length(nParts)           alloc_if(0) free_if(1)) \
+        nocopy(t_colMax:length(nParts)           alloc_if(0) free_if(1)) \
+        nocopy(t_workStart:length(nParts+1)      alloc_if(0) free_if(1)) \
+        nocopy(t_colOwner:length(numCols)        alloc_if(0) free_if(1)) \
+        nocopy(x_rowStart:length(xParts+1)       alloc_if(0) free_if(1)) \
+        nocopy(x_colMin:length(xParts)           alloc_if(0) free_if(1)) \
+        nocopy(x_colMax:length(xParts)           alloc_if(0) free_if(1)) \
+        nocopy(x_workStart:length(xParts+1)      alloc_if(0) free_if(1)) \
+        nocopy(t_work:length(workLen)            alloc_if(0) free_if(1)) \
+        nocopy(t_val:length(nItems)              alloc_if(0) free_if(1)) \
+        nocopy(t_cols:length(nItems)             alloc_if(0) free_if(1)) \
+        nocopy(t_rowDelimiters:length(numCols+1) alloc_if(0) free_if(1)) \
+        nocopy(t_counts:length(countLen)         alloc_if(0) free_if(1))
+    { }
+
+    delete[] modeTime[0];
+    delete[] modeTime[1];
+    FREE(h_val);
+    FREE(h_cols);
+    FREE(h_rowDelimiters);
+    FREE(h_vec);
+    FREE(h_out);
+    FREE(refOut);
+    FREE(t_rowStart);
+    FREE(t_colMin);
+    FREE(t_colMax);
+    FREE(t_workStart);
+    FREE(t_colOwner);
+    FREE(x_rowStart);
+    FREE(x_colMin);
+    FREE(x_colMax);
+    FREE(x_workStart);
+    FREE(t_work);
+    FREE(t_val);
+    FREE(t_cols);
+    FREE(t_rowDelimiters);
+    FREE(t_counts);
+}
+
+// ****************************************************************************
+// Function: RunNumaTest
+//
+// Purpose:
+//   Runs the host SpMV on the flat CSR arrays, first touched by the master
+//   thread, and on the NUMA layout, with the rows split over the nodes by
+//   nonzero count and every node's block first touched on the node.  The
+//   bandwidth of every node counts its matrix block, its part of the
+//   result, one read of the input vector, and the copy into the node's
+//   replica when the vector is replicated.
+//
+// Arguments:
+//   resultDB: stores results from the benchmark
+//   op: the options parser / parameter database
+//   nRows: number of rows in generated matrix
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void RunNumaTest(ResultDatabase &resultDB, OptionParser &op, int nRows=0)
+{
+    floatType *h_val, *h_vec, *h_out, *refOut;
+    int *h_cols, *h_rowDelimiters;
+    int nItems, numRows;
+
+    initMatrix(op, nRows, &h_val, &h_cols, &h_rowDelimiters, &nItems,
+               &numRows);
+    h_vec = ALLOC(floatType, numRows);
+    h_out = ALLOC(floatType, numRows);
+    refOut = ALLOC(floatType, numRows);
+    fill(h_vec, numRows, op.getOptionFloat("maxval"));
+    spmvCpu(h_val, h_cols, h_rowDelimiters, h_vec, numRows, refOut);
+
+    std::vector< std::vector<int> > nodeCpus;
+    numaTopology(op.getOptionInt("numa_nodes"), nodeCpus);
+    NumaCSR<floatType> m;
+    numaBuild(m, h_val, h_cols, h_rowDelimiters, numRows, nodeCpus,
+              omp_get_max_threads(), op.getOptionInt("numa_replicate") != 0,
+              op.getOptionInt("numa_pin") != 0);
+
+    int passes = op.getOptionInt("passes");
+    int iters  = op.getOptionInt("iterations");
+    bool dpTest = (sizeof(floatType) == sizeof(double));
+    const char *prec = dpTest ? "DP" : "SP";
+    char atts[TEMP_BUFFER_SIZE];
+    char benchName[TEMP_BUFFER_SIZE];
+    sprintf(atts, "%d_elements_%d_rows_%d_nodes", nItems, numRows,
+            m.nNodes);
+    double gflop = 2 * (double) nItems / 1e9;
+    cout << "NUMA SpMV: " << m.nNodes << " nodes, " << m.nThreads
+         << " threads\n";
+
+    string flatName = string("CSR_FLAT_CPU-") + prec;
+    string numaName = string("CSR_NUMA_CPU-") + prec;
+    cout << numaName << " Test\n";
+    for (int k = 0; k < passes; k++)
+    {
+        double flatTime = curr_second();
+        for (int i=0; i<iters; i++)
+        {
+            spmvMic(h_val, h_cols, h_rowDelimiters, h_vec, numRows, h_out);
+        }
+        flatTime = (curr_second() - flatTime) / (double)iters;
+        bool flatOk = verifyResults(refOut, h_out, numRows, k);
+
+        numaResetTime(m);
+        double numaTime = curr_second();
+        spmvNuma(m, h_vec, iters);
+        numaTime = (curr_second() - numaTime) / (double)iters;
+        if (!verifyResults(refOut, m.out, numRows, k))
+        {
+            continue;
+        }
+
+        if (flatOk)
+        {
+            resultDB.AddResult(flatName, atts, "Gflop/s", gflop/flatTime);
+            resultDB.AddResult(numaName + "_Speedup", atts, "x",
+                               flatTime / numaTime);
+        }
+        resultDB.AddResult(numaName, atts, "Gflop/s", gflop/numaTime);
+        for (int n = 0; n < m.nNodes; n++)
+        {
+            // a node is as slow as its slowest thread
+            double nodeTime = 0;
+            for (int t = 0; t < m.nThreads; t++)
+            {
+                if (m.threadNode[t] == n &&
+                    m.threadTime[t].seconds > nodeTime)
+                {
+                    nodeTime = m.threadTime[t].seconds;
+                }
+            }
+            if (nodeTime == 0)
+            {
+                continue;
+            }
+            const NumaPart<floatType> &p = m.part[n];
+            long nnz = h_rowDelimiters[p.row1] - h_rowDelimiters[p.row0];
+            double bytes = nnz * (sizeof(floatType) + sizeof(int)) +
+                           (p.row1 - p.row0) * (sizeof(floatType) +
+                           sizeof(int)) + numRows * sizeof(floatType);
+            if (m.replicate)
+            {
+                bytes += 2 * numRows * sizeof(floatType);
+            }
+            sprintf(benchName, "%s_Node%d", numaName.c_str(), n);
+            resultDB.AddResult(benchName, atts, "GB/s",
+                               bytes * iters / nodeTime / 1e9);
+        }
+    }
+
+    numaFree(m);
+    FREE(h_val);
+    FREE(h_cols);
+    FREE(h_rowDelimiters);
+    FREE(h_vec);
+    FREE(h_out);
+    FREE(refOut);
+}
+
 // ****************************************************************************
 // Function: RunBenchmark
 //
@@ -486,8 +1560,18 @@ RunBenchmark( OptionParser &op, ResultDatabase &resultDB)
 
     RunTest<float> (resultDB, op, use_mkl, probSizes[sizeClass]);
     RunTest<float> (resultDB, op, use_mkl_mic, probSizes[sizeClass]);
+    RunCompressedTest<float> (resultDB, op, probSizes[sizeClass]);
+    RunBlockedTest<float> (resultDB, op, probSizes[sizeClass]);
+    RunSymmetricTest<float> (resultDB, op, probSizes[sizeClass]);
+    RunTransposeTest<float> (resultDB, op, probSizes[sizeClass]);
+    RunNumaTest<float> (resultDB, op, probSizes[sizeClass]);
 
     cout << "Double precision tests:\n"; 
     RunTest<double> (resultDB, op, use_mkl, probSizes[sizeClass]);
     RunTest<double> (resultDB, op, use_mkl_mic, probSizes[sizeClass]);
+    RunCompressedTest<double> (resultDB, op, probSizes[sizeClass]);
+    RunBlockedTest<double> (resultDB, op, probSizes[sizeClass]);
+    RunSymmetricTest<double> (resultDB, op, probSizes[sizeClass]);
+    RunTransposeTest<double> (resultDB, op, probSizes[sizeClass]);
+    RunNumaTest<double> (resultDB, op, probSizes[sizeClass]);
 }
@@ -0,0 +1,181 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_KERNEL_H_
+#define SPMV_KERNEL_H_
+
+// ****************************************************************************
+// File:  SpmvKernel.h
+//
+// Purpose:
+//   CSR sparse matrix vector kernels shared by the Spmv and CG benchmarks.
+//   The MIC kernels work on plain and padded (convertToPadded) CSR alike.
+//
+// ****************************************************************************
+
+// ****************************************************************************
+// Function: partitionRows
+//
+// Purpose:
+//   Splits the rows of a CSR matrix into nParts contiguous blocks of about
+//   equal nonzero count.
+//
+// Arguments:
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   nParts: number of blocks
+//   rowStart: output - array of size nParts+1 with the first row of every
+//             block
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+__declspec(target(mic)) inline void partitionRows(const int *rowDelimiters,
+        int dim, int nParts, int *rowStart)
+{
+    long nnz = rowDelimiters[dim];
+    rowStart[0] = 0;
+    int r = 0;
+    for (int p=1; p<nParts; p++)
+    {
+        long target = nnz * p / nParts;
+        while (r < dim && rowDelimiters[r] < target)
+        {
+            r++;
+        }
+        rowStart[p] = r;
+    }
+    rowStart[nParts] = dim;
+}
+
+// ****************************************************************************
+// Function: spmvCpu
+//
+// Purpose: 
+//   Runs sparse matrix vector multiplication on the CPU 
+//
+// Arguements: 
+//   val: array holding the non-zero values for the matrix
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A; 
+//                  last element is the index one past the last
+//                  element of A
+//   vec: dense vector of size dim to be used for multiplication
+//   dim: number of rows/columns in the matrix
+//   out: input - buffer of size dim
+//        output - result from the spmv calculation 
+// 
+// Programmer: Lukasz Wesolowski
+// Creation: June 23, 2010
+// Returns:
+//   nothing directly
+//   out indirectly through a pointer
+// ****************************************************************************
+template <typename floatType>
+void spmvCpu(const floatType *val, const int *cols, const int *rowDelimiters, 
+         const floatType *vec, int dim, floatType *out) 
+{
+
+    for (int i=0; i<dim; i++) 
+    {
+        floatType t = 0; 
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++) 
+        {
+            int col = cols[j]; 
+            t += val[j] * vec[col];
+        }    
+        out[i] = t; 
+    }
+
+}
+
+// *******************************************************************
+// Function: spmvMic
+//
+// Purpose:
+//   Runs sparse matrix vector multiplication on the MIC accelerator
+// *******************************************************************
+
+template <typename floatType>
+__declspec(target(mic)) void spmvMic(const floatType *val, const int *cols,
+        const int *rowDelimiters, const floatType *vec, int dim, 
+        floatType *out) 
+{
+    #pragma omp parallel for
+    #pragma ivdep
+    for (int i=0; i<dim; i++) 
+    {
+        floatType t = 0; 
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++) 
+        {
+            int col = cols[j]; 
+            t += val[j] * vec[col];
+        }    
+        out[i] = t; 
+    }
+
+}
+// *******************************************************************
+// Function: spmvDotMic
+//
+// Purpose:
+//   Runs sparse matrix vector multiplication on the MIC accelerator and
+//   returns the dot product of vec and the result in the same sweep, so
+//   the result does not have to be read back from memory (the p'Ap term
+//   of conjugate gradient)
+// *******************************************************************
+
+template <typename floatType>
+__declspec(target(mic)) floatType spmvDotMic(const floatType *val,
+        const int *cols, const int *rowDelimiters, const floatType *vec,
+        int dim, floatType *out)
+{
+    floatType dot = 0;
+
+    #pragma omp parallel for reduction(+:dot)
+    for (int i=0; i<dim; i++)
+    {
+        floatType t = 0;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            int col = cols[j];
+            t += val[j] * vec[col];
+        }
+        out[i] = t;
+        dot += t * vec[i];
+    }
+    return dot;
+}
+
+#endif // SPMV_KERNEL_H_
@@ -0,0 +1,362 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_SYMMETRIC_CSR_H_
+#define SPMV_SYMMETRIC_CSR_H_
+
+// ****************************************************************************
+// File:  SymmetricCSR.h
+//
+// Purpose:
+//   Symmetric storage for the Spmv benchmark.  Only the upper triangle
+//   (diagonal included) of a symmetric matrix is kept in CSR form, so the
+//   matrix stream is roughly halved.  Each stored off-diagonal a(i,j)
+//   contributes to y(i) directly and to y(j) through the transpose.
+//
+//   Rows are split into contiguous per-thread blocks balanced by nonzero
+//   count.  Transpose contributions that land inside a thread's own row
+//   block are added in place; those that land in later blocks go to a
+//   per-thread partial result vector covering only the columns the thread
+//   actually touches, and are reduced by the owner of the rows after a
+//   barrier.  No atomics are needed.
+//
+// ****************************************************************************
+
+#pragma offload_attribute(push,target(mic))
+
+#include <omp.h>
+
+// ****************************************************************************
+// Function: convertToUpper
+//
+// Purpose:
+//   Extracts the upper triangle (col >= row) of a CSR matrix.
+//
+// Arguments:
+//   A: array holding the non-zero values for the matrix
+//   cols: array of column indices for each element of A
+//   rowDelimiters: array of size dim+1 holding indices to rows of A
+//   dim: number of rows in the matrix
+//   newA_ptr, newcols_ptr: output - pointers to the upper triangle arrays
+//   newIndices: input - buffer of size dim+1
+//               output - row delimiters of the upper triangle
+//   newSize: output - number of stored elements
+//
+// Returns:  nothing directly
+//           allocates and returns *newA_ptr and *newcols_ptr
+// ****************************************************************************
+template <typename floatType>
+void convertToUpper(const floatType *A, const int *cols,
+                    const int *rowDelimiters, int dim, floatType **newA_ptr,
+                    int **newcols_ptr, int *newIndices, int *newSize)
+{
+    int nUpper = 0;
+    for (int i=0; i<dim; i++)
+    {
+        newIndices[i] = nUpper;
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] >= i)
+            {
+                nUpper++;
+            }
+        }
+    }
+    newIndices[dim] = nUpper;
+    *newSize = nUpper;
+
+    *newA_ptr = ALLOC(floatType, nUpper);
+    *newcols_ptr = ALLOC(int, nUpper);
+    floatType *newA = *newA_ptr;
+    int *newcols = *newcols_ptr;
+
+    #pragma omp parallel for
+    for (int i=0; i<dim; i++)
+    {
+        int k = newIndices[i];
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] >= i)
+            {
+                newA[k] = A[j];
+                newcols[k] = cols[j];
+                k++;
+            }
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: convertUpperToFull
+//
+// Purpose:
+//   Expands an upper triangle back into the full symmetric CSR matrix,
+//   with sorted column indices in every row.
+//
+// Arguments:
+//   A, cols, rowDelimiters: the upper triangle in CSR format
+//   dim: number of rows in the matrix
+//   newA_ptr, newcols_ptr: output - pointers to the full matrix arrays
+//   newIndices: input - buffer of size dim+1
+//               output - row delimiters of the full matrix
+//   newSize: output - number of non-zero elements of the full matrix
+//
+// Returns:  nothing directly
+//           allocates and returns *newA_ptr and *newcols_ptr
+// ****************************************************************************
+template <typename floatType>
+void convertUpperToFull(const floatType *A, const int *cols,
+                        const int *rowDelimiters, int dim,
+                        floatType **newA_ptr, int **newcols_ptr,
+                        int *newIndices, int *newSize)
+{
+    // lower[j] counts the mirrored entries that land in row j
+    int *lower = new int[dim];
+    for (int i=0; i<dim; i++)
+    {
+        lower[i] = 0;
+    }
+    for (int i=0; i<dim; i++)
+    {
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            if (cols[j] != i)
+            {
+                lower[cols[j]]++;
+            }
+        }
+    }
+
+    newIndices[0] = 0;
+    for (int i=0; i<dim; i++)
+    {
+        newIndices[i+1] = newIndices[i] + lower[i] +
+                          rowDelimiters[i+1] - rowDelimiters[i];
+    }
+    *newSize = newIndices[dim];
+    *newA_ptr = ALLOC(floatType, *newSize);
+    *newcols_ptr = ALLOC(int, *newSize);
+    floatType *newA = *newA_ptr;
+    int *newcols = *newcols_ptr;
+
+    // Mirrored entries come first in each row, in increasing column order
+    // because the rows are walked in order.  lower[] becomes the fill
+    // position of the mirrored part.
+    for (int i=0; i<dim; i++)
+    {
+        lower[i] = newIndices[i];
+    }
+    for (int i=0; i<dim; i++)
+    {
+        int k = newIndices[i+1] - (rowDelimiters[i+1] - rowDelimiters[i]);
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++, k++)
+        {
+            newA[k] = A[j];
+            newcols[k] = cols[j];
+            if (cols[j] != i)
+            {
+                int p = lower[cols[j]]++;
+                newA[p] = A[j];
+                newcols[p] = i;
+            }
+        }
+    }
+    delete[] lower;
+}
+
+// ****************************************************************************
+// Function: symmetricPartition
+//
+// Purpose:
+//   Splits the rows of an upper triangle into nParts contiguous blocks of
+//   about equal nonzero count and records, for each block, one past the
+//   largest column it touches (the extent of its partial result vector)
+//   and where that partial vector starts in the work array.
+//
+// Arguments:
+//   cols: column indices of the upper triangle
+//   rowDelimiters: row delimiters of the upper triangle
+//   dim: number of rows in the matrix
+//   nParts: number of blocks
+//   rowStart: output - array of size nParts+1 with the first row of every
+//             block
+//   colEnd: output - array of size nParts, one past the largest column of
+//           every block (at least rowStart[p+1])
+//   workStart: output - array of size nParts+1, offset of every block's
+//              partial vector, columns [rowStart[p+1], colEnd[p]), in the
+//              work array; workStart[nParts] is the size of the work array
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+inline void symmetricPartition(const int *cols, const int *rowDelimiters,
+                               int dim, int nParts, int *rowStart,
+                               int *colEnd, long *workStart)
+{
+    partitionRows(rowDelimiters, dim, nParts, rowStart);
+
+    #pragma omp parallel for
+    for (int p=0; p<nParts; p++)
+    {
+        int end = rowStart[p+1];
+        for (int i=rowStart[p]; i<rowStart[p+1]; i++)
+        {
+            // columns are sorted, the last one of the row is the largest
+            if (rowDelimiters[i+1] > rowDelimiters[i] &&
+                cols[rowDelimiters[i+1]-1] + 1 > end)
+            {
+                end = cols[rowDelimiters[i+1]-1] + 1;
+            }
+        }
+        colEnd[p] = end;
+    }
+
+    workStart[0] = 0;
+    for (int p=0; p<nParts; p++)
+    {
+        workStart[p+1] = workStart[p] + colEnd[p] - rowStart[p+1];
+    }
+}
+
+// ****************************************************************************
+// Function: spmvSymmetric
+//
+// Purpose:
+//   Symmetric sparse matrix vector multiplication from the upper triangle.
+//
+// Arguments:
+//   val, cols, rowDelimiters: the upper triangle in CSR format, with
+//                             sorted columns
+//   rowStart, colEnd, workStart: the partition from symmetricPartition
+//   nParts: number of blocks in the partition
+//   vec: dense vector to be used for multiplication
+//   out: output - result from the spmv calculation
+//   work: scratch of size workStart[nParts] for the partial result
+//         vectors
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void spmvSymmetric(const floatType *val, const int *cols,
+                   const int *rowDelimiters, const int *rowStart,
+                   const int *colEnd, const long *workStart, int nParts,
+                   const floatType *vec, floatType *out, floatType *work)
+{
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nThreads = omp_get_num_threads();
+
+        for (int p=tid; p<nParts; p+=nThreads)
+        {
+            int r0 = rowStart[p], r1 = rowStart[p+1];
+            // w[c - r1] holds column c
+            floatType *w = work + workStart[p];
+
+            #pragma simd
+            for (int i=0; i<colEnd[p]-r1; i++)
+            {
+                w[i] = 0;
+            }
+            #pragma simd
+            for (int i=r0; i<r1; i++)
+            {
+                out[i] = 0;
+            }
+
+            for (int i=r0; i<r1; i++)
+            {
+                int j = rowDelimiters[i];
+                int end = rowDelimiters[i+1];
+                floatType xi = vec[i];
+                floatType t = 0;
+
+                // diagonal, if stored, is the first entry of the row
+                if (j < end && cols[j] == i)
+                {
+                    t = val[j] * xi;
+                    j++;
+                }
+
+                // split point between columns inside and after the block
+                int split = j;
+                while (split < end && cols[split] < r1)
+                {
+                    split++;
+                }
+
+                // columns within a row are distinct, so the transposed
+                // updates of one row never conflict
+                #pragma simd reduction(+:t)
+                for (int k=j; k<split; k++)
+                {
+                    t += val[k] * vec[cols[k]];
+                    out[cols[k]] += val[k] * xi;
+                }
+                #pragma simd reduction(+:t)
+                for (int k=split; k<end; k++)
+                {
+                    t += val[k] * vec[cols[k]];
+                    w[cols[k] - r1] += val[k] * xi;
+                }
+                out[i] += t;
+            }
+        }
+
+        #pragma omp barrier
+
+        // every block collects what the blocks before it left in their
+        // partial vectors for its rows
+        for (int p=tid; p<nParts; p+=nThreads)
+        {
+            int r0 = rowStart[p], r1 = rowStart[p+1];
+            for (int q=0; q<p; q++)
+            {
+                const floatType *w = work + workStart[q];
+                int lo = rowStart[q+1];
+                int end = (colEnd[q] < r1) ? colEnd[q] : r1;
+                #pragma simd
+                for (int i=r0; i<end; i++)
+                {
+                    out[i] += w[i - lo];
+                }
+            }
+        }
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SPMV_SYMMETRIC_CSR_H_
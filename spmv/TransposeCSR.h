@@ -0,0 +1,459 @@
+// This example from an alpha release of the Scalable HeterOgeneous Computing
+// (SHOC) Benchmark Suite Alpha v1.1.4a-mic for Intel MIC architecture
+// Contact: Kyle Spafford <kys@ornl.gov>
+//          Rezaur Rahman <rezaur.rahman@intel.com>
+//
+// Copyright (c) 2011, UT-Battelle, LLC
+// Copyright (c) 2013, Intel Corporation
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of Oak Ridge National Laboratory, nor UT-Battelle, LLC, 
+//    nor the names of its contributors may be used to endorse or promote 
+//    products derived from this software without specific prior written 
+//    permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SPMV_TRANSPOSE_CSR_H_
+#define SPMV_TRANSPOSE_CSR_H_
+
+// ****************************************************************************
+// File:  TransposeCSR.h
+//
+// Purpose:
+//   Transposed sparse matrix vector multiplication y = A'x from the CSR
+//   form of A, without building A'.  Row i of A scatters x(i) times its
+//   entries into y at their columns, so threads working on different rows
+//   may update the same element of y.  Rows are split into blocks of
+//   equal nonzero count and two ways of resolving the conflicts are
+//   provided:
+//
+//   - private: every block accumulates into a private partial vector over
+//     the range of columns it touches, and the partial vectors are summed
+//     after a barrier.  Costs about three passes over the column extents.
+//   - atomic: blocks add straight into y.  Columns touched by one block
+//     only are updated with plain adds, columns shared between blocks with
+//     atomic adds.  Costs one atomic per nonzero in a shared column.
+//
+//   chooseTransposeMode picks the cheaper from the shape of the matrix:
+//   narrow banded matrices have small shared column sets, matrices with
+//   scattered columns have every block touching most of y.
+//
+//   transposeCSR builds A' explicitly for comparison, from a partition
+//   of its own that transposeRanges sizes to the count scratch.
+//
+// ****************************************************************************
+
+#pragma offload_attribute(push,target(mic))
+
+#include <omp.h>
+
+#define TRANSPOSE_PRIVATE   0
+#define TRANSPOSE_ATOMIC    1
+
+// Cost of an atomic add relative to streaming one vector element through
+// memory
+#define TRANSPOSE_ATOMIC_COST 8
+
+// colOwner value of columns touched by more than one block
+#define TRANSPOSE_SHARED    -2
+
+// ****************************************************************************
+// Function: spmvTransposedCpu
+//
+// Purpose:
+//   Reference y = A'x on the CPU
+//
+// Arguments:
+//   val, cols, rowDelimiters: the matrix A in CSR format
+//   vec: dense vector of size numRows
+//   numRows, numCols: dimensions of A
+//   out: output - result vector of size numCols
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void spmvTransposedCpu(const floatType *val, const int *cols,
+                       const int *rowDelimiters, const floatType *vec,
+                       int numRows, int numCols, floatType *out)
+{
+    for (int c=0; c<numCols; c++)
+    {
+        out[c] = 0;
+    }
+    for (int i=0; i<numRows; i++)
+    {
+        for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+        {
+            out[cols[j]] += val[j] * vec[i];
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: transposeRanges
+//
+// Purpose:
+//   Splits the rows of A into nParts blocks of about equal nonzero count
+//   and records the range of columns each block touches.
+//
+// Arguments:
+//   cols, rowDelimiters: the matrix A in CSR format
+//   numRows, numCols: dimensions of A
+//   nParts: number of blocks
+//   rowStart: output - array of size nParts+1, first row of every block
+//   colMin, colMax: output - arrays of size nParts, the range of columns
+//                   [colMin, colMax) of every block
+//   workStart: output - array of size nParts+1, offset of every block's
+//              range in a scratch array laid out by column range;
+//              workStart[nParts] is the size of the scratch array
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+inline void transposeRanges(const int *cols, const int *rowDelimiters,
+                            int numRows, int numCols, int nParts,
+                            int *rowStart, int *colMin, int *colMax,
+                            long *workStart)
+{
+    partitionRows(rowDelimiters, numRows, nParts, rowStart);
+
+    workStart[0] = 0;
+    for (int p=0; p<nParts; p++)
+    {
+        int lo = numCols, hi = 0;
+        for (int j=rowDelimiters[rowStart[p]];
+             j<rowDelimiters[rowStart[p+1]]; j++)
+        {
+            int c = cols[j];
+            lo = (c < lo) ? c : lo;
+            hi = (c + 1 > hi) ? c + 1 : hi;
+        }
+        if (lo > hi)
+        {
+            lo = hi = 0;
+        }
+        colMin[p] = lo;
+        colMax[p] = hi;
+        workStart[p+1] = workStart[p] + hi - lo;
+    }
+}
+
+// ****************************************************************************
+// Function: transposePartition
+//
+// Purpose:
+//   Splits the rows of A into nParts blocks with transposeRanges and
+//   records which columns are touched by more than one block.
+//
+// Arguments:
+//   cols, rowDelimiters: the matrix A in CSR format
+//   numRows, numCols: dimensions of A
+//   nParts: number of blocks
+//   rowStart, colMin, colMax, workStart: output - as for transposeRanges,
+//              workStart giving the offsets of the partial vectors
+//   colOwner: output - array of size numCols, the block touching a column,
+//             -1 for untouched and TRANSPOSE_SHARED for shared columns
+//
+// Returns:  the number of nonzeros in shared columns
+//
+// ****************************************************************************
+inline long transposePartition(const int *cols, const int *rowDelimiters,
+                               int numRows, int numCols, int nParts,
+                               int *rowStart, int *colMin, int *colMax,
+                               long *workStart, int *colOwner)
+{
+    transposeRanges(cols, rowDelimiters, numRows, numCols, nParts,
+                    rowStart, colMin, colMax, workStart);
+
+    for (int c=0; c<numCols; c++)
+    {
+        colOwner[c] = -1;
+    }
+    for (int p=0; p<nParts; p++)
+    {
+        for (int j=rowDelimiters[rowStart[p]];
+             j<rowDelimiters[rowStart[p+1]]; j++)
+        {
+            int c = cols[j];
+            if (colOwner[c] == -1)
+            {
+                colOwner[c] = p;
+            }
+            else if (colOwner[c] != p)
+            {
+                colOwner[c] = TRANSPOSE_SHARED;
+            }
+        }
+    }
+
+    long shared = 0;
+    for (int j=0; j<rowDelimiters[numRows]; j++)
+    {
+        shared += colOwner[cols[j]] == TRANSPOSE_SHARED;
+    }
+    return shared;
+}
+
+// ****************************************************************************
+// Function: chooseTransposeMode
+//
+// Purpose:
+//   Picks the conflict resolution of spmvTransposed: private partial
+//   vectors cost zeroing, accumulating into and summing workElements
+//   elements; atomics cost sharedNnz atomic adds.
+//
+// ****************************************************************************
+inline int chooseTransposeMode(long workElements, long sharedNnz)
+{
+    return (3 * workElements <= TRANSPOSE_ATOMIC_COST * sharedNnz) ?
+           TRANSPOSE_PRIVATE : TRANSPOSE_ATOMIC;
+}
+
+// ****************************************************************************
+// Function: spmvTransposed
+//
+// Purpose:
+//   y = A'x from the CSR form of A.
+//
+// Arguments:
+//   val, cols, rowDelimiters: the matrix A in CSR format
+//   rowStart, colMin, colMax, workStart, colOwner: the partition from
+//                                                  transposePartition
+//   nParts: number of blocks in the partition
+//   mode: TRANSPOSE_PRIVATE or TRANSPOSE_ATOMIC
+//   vec: dense vector of size numRows
+//   numCols: number of columns of A
+//   out: output - result vector of size numCols
+//   work: scratch of size workStart[nParts] for the private partial
+//         vectors
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void spmvTransposed(const floatType *val, const int *cols,
+                    const int *rowDelimiters, const int *rowStart,
+                    const int *colMin, const int *colMax,
+                    const long *workStart, const int *colOwner, int nParts,
+                    int mode, const floatType *vec, int numCols,
+                    floatType *out, floatType *work)
+{
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nThreads = omp_get_num_threads();
+
+        if (mode == TRANSPOSE_ATOMIC)
+        {
+            #pragma omp for
+            for (int c=0; c<numCols; c++)
+            {
+                out[c] = 0;
+            }
+
+            for (int p=tid; p<nParts; p+=nThreads)
+            {
+                for (int i=rowStart[p]; i<rowStart[p+1]; i++)
+                {
+                    floatType xi = vec[i];
+                    for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+                    {
+                        int c = cols[j];
+                        floatType v = val[j] * xi;
+                        if (colOwner[c] == p)
+                        {
+                            out[c] += v;
+                        }
+                        else
+                        {
+                            #pragma omp atomic
+                            out[c] += v;
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (int p=tid; p<nParts; p+=nThreads)
+            {
+                // w[c - lo] holds column c
+                floatType *w = work + workStart[p];
+                int lo = colMin[p];
+                #pragma simd
+                for (int c=0; c<colMax[p]-lo; c++)
+                {
+                    w[c] = 0;
+                }
+
+                for (int i=rowStart[p]; i<rowStart[p+1]; i++)
+                {
+                    floatType xi = vec[i];
+                    // columns within a row are distinct, so the updates of
+                    // one row never conflict
+                    #pragma simd
+                    for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+                    {
+                        w[cols[j] - lo] += val[j] * xi;
+                    }
+                }
+            }
+
+            #pragma omp barrier
+
+            // Columns are split in nThreads chunks; every chunk sums the
+            // parts of the partial vectors that overlap it
+            int chunk = (numCols + nThreads - 1) / nThreads;
+            int c0 = tid * chunk;
+            int c1 = (c0 + chunk < numCols) ? c0 + chunk : numCols;
+            #pragma simd
+            for (int c=c0; c<c1; c++)
+            {
+                out[c] = 0;
+            }
+            for (int p=0; p<nParts; p++)
+            {
+                const floatType *w = work + workStart[p];
+                int lo = (colMin[p] > c0) ? colMin[p] : c0;
+                int hi = (colMax[p] < c1) ? colMax[p] : c1;
+                #pragma simd
+                for (int c=lo; c<hi; c++)
+                {
+                    out[c] += w[c - colMin[p]];
+                }
+            }
+        }
+    }
+}
+
+// ****************************************************************************
+// Function: transposeCSR
+//
+// Purpose:
+//   Builds the CSR form of A' from that of A in parallel.  Every block of
+//   rows counts its entries per column, the counts give every block its
+//   own range of positions in each column of A', and the blocks then
+//   fill their ranges, so the rows within a column of A' stay sorted.
+//   A block only counts the columns [colMin, colMax) it touches, and the
+//   offsets are summed over column chunks that visit only the blocks
+//   overlapping them.
+//
+// Arguments:
+//   val, cols, rowDelimiters: the matrix A in CSR format
+//   rowStart, colMin, colMax, workStart: the partition from
+//                                        transposeRanges
+//   nParts: number of row blocks
+//   numCols: number of columns of A
+//   tVal, tCols: output - arrays of size nnz for A'
+//   tRowDelimiters: output - array of size numCols+1 for A'
+//   counts: scratch of size workStart[nParts], a count per column of the
+//           range of every block
+//
+// Returns:  nothing
+//
+// ****************************************************************************
+template <typename floatType>
+void transposeCSR(const floatType *val, const int *cols,
+                  const int *rowDelimiters, const int *rowStart,
+                  const int *colMin, const int *colMax, const long *workStart,
+                  int nParts, int numCols, floatType *tVal, int *tCols,
+                  int *tRowDelimiters, int *counts)
+{
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nThreads = omp_get_num_threads();
+
+        // count[c - lo] holds column c
+        #pragma omp for
+        for (int p=0; p<nParts; p++)
+        {
+            int *count = counts + workStart[p];
+            int lo = colMin[p];
+            for (int c=0; c<colMax[p]-lo; c++)
+            {
+                count[c] = 0;
+            }
+            for (int j=rowDelimiters[rowStart[p]];
+                 j<rowDelimiters[rowStart[p+1]]; j++)
+            {
+                count[cols[j] - lo]++;
+            }
+        }
+
+        // counts become each block's offset within the column, and
+        // tRowDelimiters[c+1] the length of the column.  Blocks are visited
+        // in order within every chunk of columns
+        int chunk = (numCols + nThreads - 1) / nThreads;
+        int c0 = tid * chunk;
+        int c1 = (c0 + chunk < numCols) ? c0 + chunk : numCols;
+        for (int c=c0; c<c1; c++)
+        {
+            tRowDelimiters[c+1] = 0;
+        }
+        for (int p=0; p<nParts; p++)
+        {
+            int *count = counts + workStart[p];
+            int lo = (colMin[p] > c0) ? colMin[p] : c0;
+            int hi = (colMax[p] < c1) ? colMax[p] : c1;
+            for (int c=lo; c<hi; c++)
+            {
+                int n = count[c - colMin[p]];
+                count[c - colMin[p]] = tRowDelimiters[c+1];
+                tRowDelimiters[c+1] += n;
+            }
+        }
+
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            tRowDelimiters[0] = 0;
+            for (int c=0; c<numCols; c++)
+            {
+                tRowDelimiters[c+1] += tRowDelimiters[c];
+            }
+        }
+
+        #pragma omp for
+        for (int p=0; p<nParts; p++)
+        {
+            int *count = counts + workStart[p];
+            int lo = colMin[p];
+            for (int i=rowStart[p]; i<rowStart[p+1]; i++)
+            {
+                for (int j=rowDelimiters[i]; j<rowDelimiters[i+1]; j++)
+                {
+                    int c = cols[j];
+                    int k = tRowDelimiters[c] + count[c - lo]++;
+                    tVal[k] = val[j];
+                    tCols[k] = i;
+                }
+            }
+        }
+    }
+}
+
+#pragma offload_attribute(pop)
+
+#endif // SPMV_TRANSPOSE_CSR_H_